@@ -320,6 +320,15 @@ private:
 	///
 	void handleNotImplemented();
 
+	///
+	/// Apply the optional compositing (alpha, leds) of a color, image or effect message to its priority.
+	/// It is called between the registration and the first frame of the priority.
+	///
+	/// @param message the incoming message
+	/// @param priority the registered priority of the message
+	///
+	void applyInputBlend(const QJsonObject & message, const int priority);
+
 	///
 	/// Send a standard reply indicating success
 	///
@@ -1,6 +1,9 @@
 //#include <iostream>
 #pragma once
 
+// STL includes
+#include <vector>
+
 // Utils includes
 #include <utils/Image.h>
 
@@ -20,6 +23,9 @@ namespace hyperion
 		/// The size of the detected vertical border
 		int verticalSize;
 
+		/// How clearly the border is separated from the content [0 .. 1], not part of the comparison
+		double confidence;
+
 		///
 		/// Compares this BlackBorder to the given other BlackBorder
 		///
@@ -115,6 +121,7 @@ namespace hyperion
 			detectedBorder.unknown = firstNonBlackXPixelIndex == -1 || firstNonBlackYPixelIndex == -1;
 			detectedBorder.horizontalSize = firstNonBlackYPixelIndex;
 			detectedBorder.verticalSize = firstNonBlackXPixelIndex;
+			detectedBorder.confidence = 1.0;
 			return detectedBorder;
 		}
 
@@ -172,6 +179,7 @@ namespace hyperion
 			detectedBorder.unknown = firstNonBlackXPixelIndex == -1 || firstNonBlackYPixelIndex == -1;
 			detectedBorder.horizontalSize = firstNonBlackYPixelIndex;
 			detectedBorder.verticalSize = firstNonBlackXPixelIndex;
+			detectedBorder.confidence = 1.0;
 			return detectedBorder;
 		}
 
@@ -230,11 +238,17 @@ namespace hyperion
 			detectedBorder.unknown = firstNonBlackXPixelIndex == -1 || firstNonBlackYPixelIndex == -1;
 			detectedBorder.horizontalSize = firstNonBlackYPixelIndex;
 			detectedBorder.verticalSize = firstNonBlackXPixelIndex;
+			detectedBorder.confidence = 1.0;
 			return detectedBorder;
 		}
 
 
 
+		///
+		/// statistic detection mode (counts the non-black pixels of every line of the border bands
+		/// and reports how clearly the border is separated from the content)
+		BlackBorder process_statistic(const Image<ColorRgb> & image);
+
 	private:
 
 		///
@@ -255,5 +269,8 @@ namespace hyperion
 		/// Threshold for the blackborder detector [0 .. 255]
 		const uint8_t _blackborderThreshold;
 
+		/// Non-black pixels per column of the left and right border band (statistic mode)
+		std::vector<uint16_t> _columnCounts;
+
 	};
 } // end namespace hyperion
@@ -74,12 +74,11 @@ namespace hyperion
 				return true;
 			}
 
-			if (_detectionMode == "default") {
-				imageBorder = _detector->process(image);
-			} else if (_detectionMode == "classic") {
-				imageBorder = _detector->process_classic(image);
-			} else if (_detectionMode == "osd") {
-				imageBorder = _detector->process_osd(image);
+			imageBorder = detectBorder(image);
+			// a border that can't be told apart from dark content counts for no border at all
+			if (imageBorder.confidence < MIN_CONFIDENCE)
+			{
+				return false;
 			}
 			// add blur to the border
 			if (imageBorder.horizontalSize > 0)
@@ -108,9 +107,40 @@ namespace hyperion
 		void componentStateChanged(const hyperion::Components component, bool enable);
 
 	private:
+		/// Detections below this confidence are ignored (only the statistic mode reports less than 1)
+		static constexpr double MIN_CONFIDENCE = 0.5;
+
 		/// Hyperion instance
 		Hyperion* _hyperion;
 
+		///
+		/// Runs the detector of the configured mode on the given image
+		///
+		/// @param image The image to process
+		///
+		/// @return The border of this single image
+		///
+		template <typename Pixel_T>
+		BlackBorder detectBorder(const Image<Pixel_T> & image)
+		{
+			BlackBorder imageBorder({true, -1, -1, 1.0});
+			if (_detectionMode == "default") {
+				imageBorder = _detector->process(image);
+			} else if (_detectionMode == "classic") {
+				imageBorder = _detector->process_classic(image);
+			} else if (_detectionMode == "osd") {
+				imageBorder = _detector->process_osd(image);
+			}
+			return imageBorder;
+		}
+
+		///
+		/// Same as above for the captured frames, which also supports the statistic mode. The result
+		/// is shared through a small process wide cache keyed by the frame fingerprint, so instances
+		/// that receive the same frame with the same detector settings run the detection only once.
+		///
+		BlackBorder detectBorder(const Image<ColorRgb> & image);
+
 		///
 		/// Updates the current border based on the newly detected border. Returns true if the
 		/// current border has changed.
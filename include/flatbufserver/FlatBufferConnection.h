@@ -5,14 +5,21 @@
 #include <QColor>
 #include <QImage>
 #include <QTcpSocket>
+#include <QLocalSocket>
+#include <QSharedMemory>
 #include <QTimer>
 #include <QMap>
+#include <QElapsedTimer>
+
+// STL includes
+#include <vector>
 
 // hyperion util
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/VideoMode.h>
 #include <utils/Logger.h>
+#include <utils/FramedReader.h>
 
 // flatbuffer FBS
 #include "hyperion_reply_generated.h"
@@ -20,6 +27,7 @@
 
 ///
 /// Connection class to setup an connection to the hyperion server and execute commands.
+/// A server on the same host is connected over its local socket, images are passed in shared memory then.
 ///
 class FlatBufferConnection : public QObject
 {
@@ -71,12 +79,25 @@ public:
 	///
 	/// @brief Send a command message and receive its reply
 	/// @param message The message to send
+	/// @return True if the message was written to the socket
+	///
+	bool sendMessage(const uint8_t* buffer, uint32_t size);
+
+	///
+	/// @brief Send an image request that was encoded once for several connections. While the previous
+	/// image still waits in the socket buffer the request is kept instead, replacing an older one, and
+	/// written once the socket drained
+	/// @param buffer  The finished request
+	/// @param size    The size of the request
+	/// @return True if the request was written to the socket
 	///
-	void sendMessage(const uint8_t* buffer, uint32_t size);
+	bool sendImageMessage(const uint8_t* buffer, uint32_t size);
 
 public slots:
 	///
-	/// @brief Set the leds according to the given image
+	/// @brief Set the leds according to the given image. The image is sent raw, zlib compressed or as
+	/// JPEG depending on the measured bandwidth, changed tiles only if most of the image is unchanged.
+	/// An image is dropped while the previous one still waits in the socket buffer.
 	/// @param image The image
 	///
 	void setImage(const Image<ColorRgb> &image);
@@ -92,6 +113,17 @@ private slots:
 	///
 	void readData();
 
+	///
+	/// @brief Slot called on errors of the local socket, falls back to TCP if there is no local server
+	/// @param error The error
+	///
+	void localSocketError(QLocalSocket::LocalSocketError error);
+
+	///
+	/// @brief Slot called when the socket wrote data, sends the pending image once the previous one left
+	///
+	void writePendingImage();
+
 signals:
 
 	///
@@ -100,6 +132,90 @@ signals:
 	void setVideoMode(const VideoMode videoMode);
 
 private:
+	/// Encodings of full images, ordered by the bandwidth they need
+	enum ImageEncoding
+	{
+		ENCODING_RAW,
+		ENCODING_COMPRESSED,
+		ENCODING_JPEG,
+		ENCODING_COUNT
+	};
+
+	///
+	/// @return The state of the active socket
+	///
+	QAbstractSocket::SocketState socketState() const;
+
+	///
+	/// @return The active socket
+	///
+	QIODevice* device();
+
+	///
+	/// @brief Flush the active socket
+	///
+	void flushSocket();
+
+	///
+	/// @brief Log state changes of the connection and register the priority once connected
+	/// @return True if messages can be sent
+	///
+	bool isReady();
+
+	///
+	/// @brief Pass the image in a free slot of the shared memory frame ring, the image is dropped
+	/// while all slots are in use
+	/// @param image The image
+	///
+	void setSharedImage(const Image<ColorRgb> &image);
+
+	///
+	/// @brief Create a new frame ring
+	/// @param imageSize  The size of the images in bytes
+	/// @return True on success
+	///
+	bool createFrameRing(size_t imageSize);
+
+	///
+	/// @param type  The image type
+	/// @return True if the server listed the type in its register reply, RawImage is always supported
+	///
+	bool supportsImageType(hyperionnet::ImageType type) const;
+
+	///
+	/// @brief Update the frame rate and the bandwidth estimate, called once per image
+	///
+	void updateBandwidth();
+
+	///
+	/// @brief Select the encoding a full image of the given size needs to fit into the bandwidth, out
+	/// of the encodings the server supports
+	/// @param rawSize  The size of the uncompressed image
+	/// @return The encoding
+	///
+	ImageEncoding selectEncoding(size_t rawSize) const;
+
+	///
+	/// @brief Build a full image request
+	/// @param image     The image
+	/// @param encoding  The encoding
+	/// @return The image as the server decodes it
+	///
+	Image<ColorRgb> buildImage(const Image<ColorRgb> &image, ImageEncoding encoding);
+
+	///
+	/// @brief Build a delta request with the tiles that differ from _referenceImage
+	/// @param image      The image
+	/// @param tolerance  Largest channel difference of an unchanged tile, 0 for lossless
+	/// @param result     Receives the image as the server decodes it
+	/// @return False if the sizes differ or too many tiles changed, no request is built then
+	///
+	bool buildDeltaImage(const Image<ColorRgb> &image, int tolerance, Image<ColorRgb> &result);
+
+	///
+	/// @brief Reset the image reference and the bandwidth measurement of a new connection
+	///
+	void resetImageState();
 
 	///
 	/// @brief Parse a reply message
@@ -112,6 +228,22 @@ private:
 	/// The TCP-Socket with the connection to the server
 	QTcpSocket _socket;
 
+	/// The local socket with the connection to a server on the same host
+	QLocalSocket _localSocket;
+	/// True while the local socket is used
+	bool _local;
+
+	/// The shared memory frame ring of the local connection
+	QSharedMemory _frames;
+	/// False if the server can't use the frame ring, images are sent over the socket then
+	bool _sharedFrames;
+	/// Size of one slot of the frame ring
+	size_t _slotSize;
+	/// Number of created frame rings, part of their key
+	int _frameRings;
+	/// Time since the server holds all slots
+	QElapsedTimer _slotStall;
+
 	QString _origin;
 	int _priority;
 
@@ -121,8 +253,8 @@ private:
 	/// Host port
 	uint16_t _port;
 
-	/// buffer for reply
-	QByteArray _receiveBuffer;
+	/// Reads the size prefixed replies
+	FramedReader _reader;
 
 	QTimer _timer;
 	QAbstractSocket::SocketState  _prevSocketState;
@@ -131,4 +263,31 @@ private:
 	flatbuffers::FlatBufferBuilder _builder;
 
 	bool _registered;
+	/// The image types of the register reply, bit (1 << ImageType) per type
+	uint32_t _imageTypes;
+
+	/// The last image as decoded by the server, reference of delta images
+	Image<ColorRgb> _referenceImage;
+	/// Indices and pixels of the changed tiles of a delta image
+	std::vector<uint32_t> _changedTiles;
+	std::vector<uint8_t> _tilePixels;
+
+	/// Time since the last image
+	QElapsedTimer _frameTimer;
+	/// Bytes written to the socket since the connection was established
+	qint64 _bytesWritten;
+	/// Bytes the socket had sent at the last image
+	qint64 _lastDrained;
+	/// Bytes waiting in the socket at the last image
+	qint64 _lastPending;
+	/// Size of the last image message
+	qint64 _lastImageSize;
+	/// The newest image request of sendImageMessage() waiting for the socket, empty if none
+	QByteArray _pendingImage;
+	/// Bandwidth of the link in bytes per second, 0 until the socket was busy once
+	double _bandwidth;
+	/// Images per second
+	double _frameRate;
+	/// Size of a full image relative to the raw image, per encoding
+	double _sizeRatio[ENCODING_COUNT];
 };
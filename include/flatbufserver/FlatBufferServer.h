@@ -6,8 +6,13 @@
 
 // qt
 #include <QVector>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QByteArray>
 
 class QTcpServer;
+class QLocalServer;
+class QUdpSocket;
 class FlatBufferClient;
 class NetOrigin;
 
@@ -15,6 +20,8 @@ class NetOrigin;
 ///
 /// @brief A TcpServer to receive images of different formats with Google Flatbuffer
 /// Images will be forwarded to all Hyperion instances
+/// Local clients may connect to a local socket named after the port instead and pass images in shared memory
+/// Requests are also accepted as UDP datagrams on the same port if enabled, optionally of a multicast group
 ///
 class FlatBufferServer : public QObject
 {
@@ -39,6 +46,16 @@ private slots:
 	///
 	void newConnection();
 
+	///
+	/// @brief Is called whenever a new local socket wants to connect
+	///
+	void newLocalConnection();
+
+	///
+	/// @brief Is called whenever datagrams arrived
+	///
+	void readDatagrams();
+
 	///
 	/// @brief is called whenever a client disconnected
 	///
@@ -55,12 +72,32 @@ private:
 	///
 	void stopServer();
 
+	///
+	/// @brief Connect the signals of a new client
+	/// @param client  The client
+	///
+	void addClient(FlatBufferClient* client);
 
 private:
 	QTcpServer* _server;
+	QLocalServer* _localServer;
+	QUdpSocket* _udpSocket;
+	/// True if datagrams are received
+	bool _udp;
+	/// The multicast group joined by the UDP socket, empty for none
+	QString _multicastGroup;
+	/// One client per datagram sender, by address and port
+	QHash<QString, FlatBufferClient*> _datagramClients;
+	/// Senders rejected by the NetOrigin check with the time of the check, checked again once expired
+	QHash<QString, qint64> _rejectedSenders;
+	/// Time base of the rejected senders
+	QElapsedTimer _uptime;
+	QByteArray _datagram;
 	NetOrigin* _netOrigin;
 	Logger* _log;
 	int _timeout;
+	/// The largest accepted message of a client in bytes
+	quint32 _maxMessageSize;
 	quint16 _port;
 	const QJsonDocument _config;
 
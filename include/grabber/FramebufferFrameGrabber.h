@@ -1,7 +1,14 @@
 #pragma once
 
+// STL includes
+#include <vector>
+
+// Qt includes
+#include <QElapsedTimer>
+
 // Utils includes
 #include <utils/ColorRgb.h>
+#include <utils/PixelFormat.h>
 #include <hyperion/Grabber.h>
 
 ///
@@ -27,15 +34,46 @@ public:
 	///
 	/// @param[out] image  The snapped screenshot (should be initialized with correct width and
 	/// height)
+	/// @return 0 on success, FRAME_UNCHANGED if change detection is enabled and the screen didn't change
+	/// (image is untouched) or -1 on errors
 	///
 	int grabFrame(Image<ColorRgb> & image);
 
+	///
+	/// @brief Enable the change detection. Unchanged screens are not resampled and reported as
+	/// FRAME_UNCHANGED, except for a periodic keep-alive frame
+	/// @param enable  The new state
+	///
+	void setChangeDetectionEnabled(bool enable);
+
 	///
 	/// @brief Overwrite Grabber.h implememtation
 	///
 	virtual void setDevicePath(const QString& path);
 
 private:
+	///
+	/// @brief Open the device if not open yet
+	/// @return True if the device is open
+	///
+	bool openDevice();
+
+	///
+	/// @brief Unmap the screen and close the device
+	///
+	void closeDevice();
+
+	///
+	/// @brief (Re)map the screen for the given geometry
+	/// @return True on success
+	///
+	bool mapScreen(unsigned xres, unsigned yres, unsigned bitsPerPixel);
+
+	///
+	/// @brief Hash of the screen pixels read by the resampler
+	///
+	uint64_t screenHash(int horizontalDecimation, int verticalDecimation);
+
 	/// Framebuffer file descriptor
 	int _fbfd;
 
@@ -44,4 +82,19 @@ private:
 
 	/// Framebuffer device e.g. /dev/fb0
 	QString _fbDevice;
+
+	/// Geometry of the current mapping
+	unsigned _screenWidth;
+	unsigned _screenHeight;
+	unsigned _bitsPerPixel;
+	size_t _mapSize;
+	PixelFormat _pixelFormat;
+
+	/// Change detection
+	bool _changeDetection;
+	uint64_t _lastHash;
+	/// The sampled pixels of one row, the input of the hash
+	std::vector<uint8_t> _hashRow;
+	Image<ColorRgb> _lastImage;
+	QElapsedTimer _lastFrameTimer;
 };
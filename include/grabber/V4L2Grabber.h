@@ -3,27 +3,32 @@
 // stl includes
 #include <vector>
 #include <map>
+#include <atomic>
 
 // Qt includes
 #include <QObject>
-#include <QSocketNotifier>
 #include <QRectF>
+#include <QMutex>
 
 // util includes
 #include <utils/PixelFormat.h>
+#include <utils/FrameHandoff.h>
 #include <hyperion/Grabber.h>
 #include <grabber/VideoStandard.h>
 #include <utils/Components.h>
 
+class QThread;
+
 #ifdef HAVE_JPEG
-	#include <QImage>
-	#include <QColor>
-	#include <jpeglib.h>
-	#include <csetjmp>
+class MjpegDecoder;
 #endif
 
 /// Capture class for V4L2 devices
 ///
+/// Buffers are dequeued on a capture thread and handed over to a decode thread which converts them
+/// and emits newFrame. The handoff keeps only the latest frame, so a slow decode drops frames
+/// instead of delaying the following ones.
+///
 /// @see http://linuxtv.org/downloads/v4l-dvb-apis/capture-example.html
 class V4L2Grabber : public Grabber
 {
@@ -39,10 +44,15 @@ public:
 
 	QRectF getSignalDetectionOffset()
 	{
+		QMutexLocker lock(&_settingsMutex);
 		return QRectF(_x_frac_min, _y_frac_min, _x_frac_max, _y_frac_max);
 	}
 
-	bool getSignalDetectionEnabled() { return _signalDetectionEnabled; }
+	bool getSignalDetectionEnabled()
+	{
+		QMutexLocker lock(&_settingsMutex);
+		return _signalDetectionEnabled;
+	}
 
 	int grabFrame(Image<ColorRgb> &);
 
@@ -57,6 +67,16 @@ public:
 	///
 	virtual void setPixelDecimation(int pixelDecimation);
 
+	///
+	/// @brief  overwrite Grabber.h implementation, the values are guarded for the decode thread
+	///
+	virtual void setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom);
+
+	///
+	/// @brief  overwrite Grabber.h implementation, the video mode is guarded for the decode thread
+	///
+	virtual void setVideoMode(VideoMode mode);
+
 	///
 	/// @brief  overwrite Grabber.h implementation
 	///
@@ -94,12 +114,33 @@ public slots:
 
 signals:
 	void newFrame(const Image<ColorRgb> & image);
-	void readError(const char* err);
+	void readError(const QString & err);
+
+private:
+	///
+	/// @brief Capture thread: waits for the device and publishes the dequeued buffers to the decode thread
+	///
+	void captureLoop();
+
+	///
+	/// @brief Decode thread: converts the latest published buffer and gives it back to the device
+	///
+	void decodeLoop();
+
+	///
+	/// @brief Dequeue a filled buffer (mmap and user pointer i/o)
+	/// @return The buffer index, -1 if no buffer is ready or -2 on errors
+	///
+	int dequeue_buffer();
+
+	///
+	/// @brief Give a buffer back to the device (mmap and user pointer i/o)
+	/// @param index  The buffer index
+	///
+	void queue_buffer(int index);
 
-private slots:
 	int read_frame();
 
-private:
 	void getV4Ldevices();
 
 	bool init();
@@ -151,28 +192,13 @@ private:
 	{
 			void   *start;
 			size_t  length;
+			size_t  bytesused;
+			qint64  dequeuedAt;
 	};
 
 #ifdef HAVE_JPEG
-	struct errorManager
-	{
-		jpeg_error_mgr pub;
-		jmp_buf setjmp_buffer;
-	};
-
-	static void errorHandler(j_common_ptr cInfo)
-	{
-		errorManager* mgr = reinterpret_cast<errorManager*>(cInfo->err);
-		longjmp(mgr->setjmp_buffer, 1);
-	}
-
-	static void outputHandler(j_common_ptr cInfo)
-	{
-		// Suppress fprintf warnings.
-	}
-
-	jpeg_decompress_struct* _decompress;
-	errorManager* _error;
+	/// persistent decoder for MJPEG frames
+	MjpegDecoder* _mjpegDecoder;
 #endif
 
 private:
@@ -189,7 +215,7 @@ private:
 	int         _lineLength;
 	int         _frameByteSize;
 
-	// signal detection
+	// signal detection, the settings are guarded by _settingsMutex, counter and state belong to the decode thread
 	int      _noSignalCounterThreshold;
 	ColorRgb _noSignalThresholdColor;
 	bool     _signalDetectionEnabled;
@@ -200,7 +226,27 @@ private:
 	double   _x_frac_max;
 	double   _y_frac_max;
 
-	QSocketNotifier *_streamNotifier;
+	// capture pipeline
+	QThread *           _captureThread;
+	QThread *           _decodeThread;
+	std::atomic<bool>   _capturing;
+	FrameHandoff        _handoff;
+	std::atomic<int>    _buffersInUse;
+	std::atomic<quint64> _capturedFrames;
+	std::atomic<quint64> _droppedFrames;
+	std::atomic<quint64> _requeueCount;
+	std::atomic<quint64> _requeueLatencySum;
+	std::atomic<qint64>  _requeueLatencyMax;
+
+	/// guards the crop, decimation, video mode and signal detection settings, the decode thread takes a copy per frame
+	QMutex              _settingsMutex;
+	/// copy of the resampler settings for the frame in progress, only used by the decode thread
+	ImageResampler      _frameResampler;
+
+	/// ring of output images, the decode thread converts into their buffers as long as no consumer holds
+	/// them and into recycled pool buffers otherwise
+	std::vector<Image<ColorRgb>> _outputImages;
+	size_t                       _nextOutputImage;
 
 	bool _initialized;
 	bool _deviceAutoDiscoverEnabled;
@@ -31,7 +31,7 @@ signals:
 
 private slots:
 	void newFrame(const Image<ColorRgb> & image);
-	void readError(const char* err);
+	void readError(const QString& err);
 
 	virtual void action();
 
@@ -20,6 +20,9 @@ class Grabber : public QObject
 	Q_OBJECT
 
 public:
+	/// Result of grabFrame() when the frame didn't change since the last grab, it isn't forwarded
+	static const int FRAME_UNCHANGED = 1;
+
 	Grabber(QString grabberName, int width=0, int height=0, int cropLeft=0, int cropRight=0, int cropTop=0, int cropBottom=0);
 	virtual ~Grabber();
 
@@ -46,12 +46,15 @@ public:
 	{
 		unsigned w = grabber.getImageWidth();
 		unsigned h = grabber.getImageHeight();
-		if ( _image.width() != w || _image.height() != h)
+		// still shared with the last emitted frame? resize() hands out a fresh buffer instead of a copy
+		_image.resize(w, h);
+
+		int ret = grabber.grabFrame(_image);
+		if (ret == Grabber_T::FRAME_UNCHANGED)
 		{
-			_image.resize(w, h);
+			return false;
 		}
 
-		int ret = grabber.grabFrame(_image);
 		if (ret >= 0)
 		{
 			emit systemImage(_grabberName, _image);
@@ -12,6 +12,7 @@
 #include <QJsonValue>
 #include <QJsonArray>
 #include <QMutex>
+#include <QElapsedTimer>
 
 // hyperion-utils includes
 #include <utils/Image.h>
@@ -283,6 +284,16 @@ public slots:
 	///
 	bool setInputInactive(const quint8& priority);
 
+	///
+	/// @brief Composite a priority over the lower priorities instead of covering them. The blend takes
+	/// effect with the next frame of the priority, set it before the frame to avoid an extra update.
+	/// @param priority  The priority (prev registered with registerInput())
+	/// @param alpha     The opacity (0-255), 255 with all leds is the default opaque input
+	/// @param leds      The indices of the leds that show the input, empty for all leds
+	/// @return True on success false if not found
+	///
+	bool setInputBlend(const int priority, const int alpha, const std::vector<int>& leds = std::vector<int>());
+
 	///
 	/// Returns the list with unique adjustment identifiers
 	/// @return The list with adjustment identifiers
@@ -477,6 +488,19 @@ private:
 	///
 	Hyperion(const quint8& instance);
 
+	///
+	/// @brief Check if repeated input may be skipped, because the keep-alive of static scenes didn't expire yet
+	/// @param  lastTime  Time of the last processing
+	/// @return True to skip
+	///
+	bool isKeepAliveSkip(const QElapsedTimer& lastTime) const;
+
+	///
+	/// @brief Blend the colors in _layerBuffer over _ledBuffer
+	/// @param  blend  The opacity and led subset of the layer
+	///
+	void blendLayer(const PriorityMuxer::InputBlend& blend);
+
 	/// instance index
 	const quint8 _instIndex;
 
@@ -531,6 +555,17 @@ private:
 	/// buffer for leds (with adjustment)
 	std::vector<ColorRgb> _ledBuffer;
 
+	/// buffer for the colors of a translucent priority and the per byte opacity to blend it into _ledBuffer
+	std::vector<ColorRgb> _layerBuffer;
+	std::vector<uint8_t> _blendWeights;
+
+	/// static scenes: repeated images are processed and unchanged led data is written again at least in this interval [ms], 0 disables the skipping
+	int _keepAliveTime;
+	QElapsedTimer _lastUpdate;
+	QElapsedTimer _lastLedDeviceWrite;
+	/// led data of the last ledDeviceData emission
+	std::vector<ColorRgb> _lastLedDeviceData;
+
 	VideoMode _currVideoMode = VIDEO_2D;
 
 	/// Boblight instance
@@ -163,6 +163,35 @@ public:
 		}
 	}
 
+	///
+	/// Processes an image below the top image layer. The black border detection follows the top
+	/// layer only, so this image is mapped without border and the current mapping is kept.
+	///
+	/// @param[in] image  The image to translate to led values
+	///
+	/// @return The color value per led
+	///
+	template <typename Pixel_T>
+	std::vector<ColorRgb> processLowerLayer(const Image<Pixel_T>& image)
+	{
+		std::vector<ColorRgb> colors;
+		if (image.width()>0 && image.height()>0)
+		{
+			const hyperion::ImageToLedsMap* mapping = findMapping(image.width(), image.height(), 0, 0);
+			switch (_mappingType)
+			{
+				case 1: colors = mapping->getUniLedColor(image); break;
+				default: colors = mapping->getMeanLedColor(image);
+			}
+		}
+		else
+		{
+			Warning(_log, "Called with image size 0");
+		}
+
+		return colors;
+	}
+
 	///
 	/// Get the hscan and vscan parameters for a single led
 	///
@@ -187,26 +216,22 @@ private:
 		{
 			Debug(_log, "Reset border");
 			_borderProcessor->process(image);
-			delete _imageToLeds;
-			_imageToLeds = new hyperion::ImageToLedsMap(image.width(), image.height(), 0, 0, _ledString.leds());
+			selectMapping(image.width(), image.height(), 0, 0);
 		}
 
 		if(_borderProcessor->enabled() && _borderProcessor->process(image))
 		{
 			const hyperion::BlackBorder border = _borderProcessor->getCurrentBorder();
 
-			// Clean up the old mapping
-			delete _imageToLeds;
-
 			if (border.unknown)
 			{
-				// Construct a new buffer and mapping
-				_imageToLeds = new hyperion::ImageToLedsMap(image.width(), image.height(), 0, 0, _ledString.leds());
+				// Switch to the mapping without border
+				selectMapping(image.width(), image.height(), 0, 0);
 			}
 			else
 			{
-				// Construct a new buffer and mapping
-				_imageToLeds = new hyperion::ImageToLedsMap(image.width(), image.height(), border.horizontalSize, border.verticalSize, _ledString.leds());
+				// Switch to the mapping of the detected border
+				selectMapping(image.width(), image.height(), border.horizontalSize, border.verticalSize);
 			}
 
 			//Debug(Logger::getInstance("BLACKBORDER"),  "CURRENT BORDER TYPE: unknown=%d hor.size=%d vert.size=%d",
@@ -214,6 +239,30 @@ private:
 		}
 	}
 
+	///
+	/// Makes the mapping for the given size and border the current one. The recently used mappings
+	/// are kept, so a flickering border switches between them without building a new mapping.
+	///
+	/// @param[in] width             The width of the image
+	/// @param[in] height            The height of the image
+	/// @param[in] horizontalBorder  The size of the horizontal border
+	/// @param[in] verticalBorder    The size of the vertical border
+	///
+	void selectMapping(const unsigned width, const unsigned height, const unsigned horizontalBorder, const unsigned verticalBorder);
+
+	///
+	/// Returns the mapping for the given size and border from the recently used mappings, a missing
+	/// one is created. The current mapping is not changed.
+	///
+	/// @return The mapping
+	///
+	hyperion::ImageToLedsMap* findMapping(const unsigned width, const unsigned height, const unsigned horizontalBorder, const unsigned verticalBorder);
+
+	///
+	/// Deletes all mappings (eg when the led layout changes)
+	///
+	void clearMappings();
+
 private slots:
 	void handleSettingsUpdate(const settings::type& type, const QJsonDocument& config);
 
@@ -228,6 +277,9 @@ private:
 	/// The mapping of image-pixels to leds
 	hyperion::ImageToLedsMap* _imageToLeds;
 
+	/// The recently used mappings (owned), most recent first
+	std::vector<hyperion::ImageToLedsMap*> _mappingCache;
+
 	/// Type of image 2 led mapping
 	int _mappingType;
 	/// Type of last requested user type
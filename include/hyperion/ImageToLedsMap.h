@@ -5,9 +5,13 @@
 #include <cassert>
 #include <sstream>
 
+// QT includes
+#include <QMutex>
+
 // hyperion-utils includes
 #include <utils/Image.h>
 #include <utils/Logger.h>
+#include <utils/PixelKernels.h>
 
 // hyperion includes
 #include <hyperion/LedString.h>
@@ -16,17 +20,32 @@ namespace hyperion
 {
 
 	///
-	/// The ImageToLedsMap holds a mapping of indices into an image to leds. It can be used to
+	/// The ImageToLedsMap holds a mapping of image regions to leds. It can be used to
 	/// calculate the average (or mean) color per led for a specific region.
+	/// Each led region is stored as a list of row spans, so the colors can be accumulated with
+	/// contiguous row loops. Alternatively the mean colors are derived from a summed-area table
+	/// (integral image) which makes the cost per led independent of the region size.
 	///
 	class ImageToLedsMap
 	{
 	public:
+		///
+		/// Strategy used to accumulate the colors of the led regions
+		///
+		enum SamplingMode
+		{
+			/// Accumulate the pixels of each row span (cost grows with the region size)
+			SAMPLE_SPANS,
+			/// Build a summed-area table once per image (constant cost per led)
+			SAMPLE_INTEGRAL,
+			/// Use the summed-area table when the led regions cover more pixels than the image itself
+			SAMPLE_AUTO
+		};
 
 		///
-		/// Constructs an mapping from the absolute indices in an image to each led based on the border
-		/// definition given in the list of leds. The map holds absolute indices to any given image,
-		/// provided that it is row-oriented.
+		/// Constructs a mapping from the row spans in an image to each led based on the border
+		/// definition given in the list of leds. The map holds absolute row/column positions for any
+		/// given image, provided that it is row-oriented.
 		/// The mapping is created purely on size (width and height). The given borders are excluded
 		/// from indexing.
 		///
@@ -35,13 +54,15 @@ namespace hyperion
 		/// @param[in] horizontalBorder The size of the horizontal border (0=no border)
 		/// @param[in] verticalBorder   The size of the vertical border (0=no border)
 		/// @param[in] leds             The list with led specifications
+		/// @param[in] samplingMode     The strategy used to accumulate the led regions
 		///
 		ImageToLedsMap(
 				const unsigned width,
 				const unsigned height,
 				const unsigned horizontalBorder,
 				const unsigned verticalBorder,
-				const std::vector<Led> & leds);
+				const std::vector<Led> & leds,
+				const SamplingMode samplingMode = SAMPLE_AUTO);
 
 		///
 		/// Returns the width of the indexed image
@@ -60,6 +81,13 @@ namespace hyperion
 		unsigned horizontalBorder() { return _horizontalBorder; };
 		unsigned verticalBorder() { return _verticalBorder; };
 
+		///
+		/// Returns the sampling strategy resolved at construction (never SAMPLE_AUTO)
+		///
+		/// @return The applied sampling mode
+		///
+		SamplingMode samplingMode() const { return _samplingMode; };
+
 		///
 		/// Determines the mean color for each led using the mapping the image given
 		/// at construction.
@@ -71,7 +99,7 @@ namespace hyperion
 		template <typename Pixel_T>
 		std::vector<ColorRgb> getMeanLedColor(const Image<Pixel_T> & image) const
 		{
-			std::vector<ColorRgb> colors(_colorsMap.size(), ColorRgb{0,0,0});
+			std::vector<ColorRgb> colors(_ledAreas.size(), ColorRgb{0,0,0});
 			getMeanLedColor(image, colors);
 			return colors;
 		}
@@ -87,19 +115,33 @@ namespace hyperion
 		void getMeanLedColor(const Image<Pixel_T> & image, std::vector<ColorRgb> & ledColors) const
 		{
 			// Sanity check for the number of leds
-			//assert(_colorsMap.size() == ledColors.size());
-			if(_colorsMap.size() != ledColors.size())
+			//assert(_ledAreas.size() == ledColors.size());
+			if(_ledAreas.size() != ledColors.size())
 			{
-				Debug(Logger::getInstance("HYPERION"), "ImageToLedsMap: colorsMap.size != ledColors.size -> %d != %d", _colorsMap.size(), ledColors.size());
+				Debug(Logger::getInstance("HYPERION"), "ImageToLedsMap: ledAreas.size != ledColors.size -> %d != %d", _ledAreas.size(), ledColors.size());
 				return;
 			}
 
 			// Iterate each led and compute the mean
 			auto led = ledColors.begin();
-			for (auto colors = _colorsMap.begin(); colors != _colorsMap.end(); ++colors, ++led)
+			if (_samplingMode == SAMPLE_INTEGRAL)
 			{
-				const ColorRgb color = calcMeanColor(image, *colors);
-				*led = color;
+				QMutexLocker lock(&_integralMutex);
+				if (!updateIntegralImage(image))
+				{
+					Debug(Logger::getInstance("HYPERION"), "ImageToLedsMap: image size != map size -> %dx%d != %dx%d", image.width(), image.height(), _width, _height);
+					return;
+				}
+				for (auto area = _ledAreas.begin(); area != _ledAreas.end(); ++area, ++led)
+				{
+					*led = calcIntegralMeanColor(*area);
+				}
+				return;
+			}
+
+			for (auto area = _ledAreas.begin(); area != _ledAreas.end(); ++area, ++led)
+			{
+				*led = calcMeanColor(image, *area);
 			}
 		}
 
@@ -114,7 +156,7 @@ namespace hyperion
 		template <typename Pixel_T>
 		std::vector<ColorRgb> getUniLedColor(const Image<Pixel_T> & image) const
 		{
-			std::vector<ColorRgb> colors(_colorsMap.size(), ColorRgb{0,0,0});
+			std::vector<ColorRgb> colors(_ledAreas.size(), ColorRgb{0,0,0});
 			getUniLedColor(image, colors);
 			return colors;
 		}
@@ -130,10 +172,10 @@ namespace hyperion
 		void getUniLedColor(const Image<Pixel_T> & image, std::vector<ColorRgb> & ledColors) const
 		{
 			// Sanity check for the number of leds
-			// assert(_colorsMap.size() == ledColors.size());
-			if(_colorsMap.size() != ledColors.size())
+			// assert(_ledAreas.size() == ledColors.size());
+			if(_ledAreas.size() != ledColors.size())
 			{
-				Debug(Logger::getInstance("HYPERION"), "ImageToLedsMap: colorsMap.size != ledColors.size -> %d != %d", _colorsMap.size(), ledColors.size());
+				Debug(Logger::getInstance("HYPERION"), "ImageToLedsMap: ledAreas.size != ledColors.size -> %d != %d", _ledAreas.size(), ledColors.size());
 				return;
 			}
 
@@ -144,6 +186,37 @@ namespace hyperion
 		}
 
 	private:
+		///
+		/// A contiguous run of pixels within a single image row
+		///
+		struct ColorSpan
+		{
+			/// The image row
+			unsigned y;
+			/// The first column of the run
+			unsigned xStart;
+			/// The column after the last column of the run
+			unsigned xEnd;
+		};
+
+		///
+		/// The image region of a single led. The spans are stored in _colorSpans, the bounding
+		/// rectangle (end exclusive) is used for summed-area lookups.
+		///
+		struct LedArea
+		{
+			/// Index of the first span in _colorSpans
+			unsigned firstSpan;
+			/// Number of spans of this led
+			unsigned spanCount;
+			/// Number of pixels covered by the spans
+			unsigned pixelCount;
+			unsigned minX;
+			unsigned maxX;
+			unsigned minY;
+			unsigned maxY;
+		};
+
 		/// The width of the indexed image
 		const unsigned _width;
 		/// The height of the indexed image
@@ -153,51 +226,149 @@ namespace hyperion
 
 		const unsigned _verticalBorder;
 
-		/// The absolute indices into the image for each led
-		std::vector<std::vector<unsigned>> _colorsMap;
+		/// The applied sampling strategy
+		SamplingMode _samplingMode;
+
+		/// The region of each led
+		std::vector<LedArea> _ledAreas;
+
+		/// The row spans of all leds, referenced by _ledAreas
+		std::vector<ColorSpan> _colorSpans;
+
+		/// Guards the summed-area table, a map is shared and may be used by several threads at once
+		mutable QMutex _integralMutex;
+
+		/// The summed-area table of the last image (SAMPLE_INTEGRAL only), allocated on first use
+		mutable std::vector<uint32_t> _integral;
 
 		///
-		/// Calculates the 'mean color' of the given list. This is the mean over each color-channel
+		/// Calculates the 'mean color' of the given led region. This is the mean over each color-channel
 		/// (red, green, blue)
 		///
 		/// @param[in] image The image a section from which an average color must be computed
-		/// @param[in] colors  The list with colors
+		/// @param[in] area  The led region
 		///
-		/// @return The mean of the given list of colors (or black when empty)
+		/// @return The mean of the given region (or black when empty)
 		///
 		template <typename Pixel_T>
-		ColorRgb calcMeanColor(const Image<Pixel_T> & image, const std::vector<unsigned> & colors) const
+		ColorRgb calcMeanColor(const Image<Pixel_T> & image, const LedArea & area) const
 		{
-			const auto colorVecSize = colors.size();
-
-			if (colorVecSize == 0)
+			if (area.pixelCount == 0)
 			{
 				return ColorRgb::BLACK;
 			}
 
 			// Accumulate the sum of each seperate color channel
-			uint_fast16_t cummRed   = 0;
-			uint_fast16_t cummGreen = 0;
-			uint_fast16_t cummBlue  = 0;
+			uint64_t cumm[3] = { 0, 0, 0 };
 			const auto& imgData = image.memptr();
 
-			for (const unsigned colorOffset : colors)
+			const ColorSpan* span = _colorSpans.data() + area.firstSpan;
+			const ColorSpan* spanEnd = span + area.spanCount;
+			for (; span != spanEnd; ++span)
 			{
-				const auto& pixel = imgData[colorOffset];
-				cummRed   += pixel.red;
-				cummGreen += pixel.green;
-				cummBlue  += pixel.blue;
+				sumRow(imgData + span->y * _width + span->xStart, span->xEnd - span->xStart, cumm);
 			}
 
 			// Compute the average of each color channel
-			const uint8_t avgRed   = uint8_t(cummRed/colorVecSize);
-			const uint8_t avgGreen = uint8_t(cummGreen/colorVecSize);
-			const uint8_t avgBlue  = uint8_t(cummBlue/colorVecSize);
+			const uint8_t avgRed   = uint8_t(cumm[0]/area.pixelCount);
+			const uint8_t avgGreen = uint8_t(cumm[1]/area.pixelCount);
+			const uint8_t avgBlue  = uint8_t(cumm[2]/area.pixelCount);
 
 			// Return the computed color
 			return {avgRed, avgGreen, avgBlue};
 		}
 
+		///
+		/// Adds the channel sums of a row of pixels to the given accumulators
+		///
+		/// @param[in]     pixel The first pixel of the row
+		/// @param[in]     count The number of pixels in the row
+		/// @param[in/out] cumm  The red, green and blue accumulators
+		///
+		template <typename Pixel_T>
+		static void sumRow(const Pixel_T* pixel, const unsigned count, uint64_t cumm[3])
+		{
+			uint32_t rowRed = 0, rowGreen = 0, rowBlue = 0;
+			for (const Pixel_T* rowEnd = pixel + count; pixel != rowEnd; ++pixel)
+			{
+				rowRed   += pixel->red;
+				rowGreen += pixel->green;
+				rowBlue  += pixel->blue;
+			}
+			cumm[0] += rowRed;
+			cumm[1] += rowGreen;
+			cumm[2] += rowBlue;
+		}
+
+		///
+		/// Packed RGB rows are summed with the vectorized kernel
+		///
+		static void sumRow(const ColorRgb* pixel, const unsigned count, uint64_t cumm[3])
+		{
+			uint32_t rowSums[3] = { 0, 0, 0 };
+			PixelKernels::sumRgb24(reinterpret_cast<const uint8_t*>(pixel), count, rowSums);
+			cumm[0] += rowSums[0];
+			cumm[1] += rowSums[1];
+			cumm[2] += rowSums[2];
+		}
+
+		///
+		/// Builds the summed-area table of the given image into _integral (the caller holds
+		/// _integralMutex). The table holds interleaved red/green/blue sums, (width+1)*(height+1)
+		/// entries per channel. Sums wrap modulo 2^32, differences stay exact as long as a single led
+		/// region is below 16.8M pixels.
+		///
+		/// @param[in] image  The image to integrate
+		///
+		/// @return False if the image size doesn't match the map (the table is left unchanged)
+		///
+		template <typename Pixel_T>
+		bool updateIntegralImage(const Image<Pixel_T> & image) const
+		{
+			if (image.width() != _width || image.height() != _height)
+			{
+				return false;
+			}
+
+			const unsigned stride = 3 * (_width + 1);
+			_integral.resize(size_t(stride) * (_height + 1));
+
+			// first row and column stay zero
+			std::fill(_integral.begin(), _integral.begin() + stride, 0);
+
+			const Pixel_T* pixel = image.memptr();
+			for (unsigned y = 0; y < _height; ++y)
+			{
+				const uint32_t* above = _integral.data() + size_t(y) * stride;
+				uint32_t* current = _integral.data() + size_t(y + 1) * stride;
+				current[0] = current[1] = current[2] = 0;
+
+				uint32_t rowRed = 0, rowGreen = 0, rowBlue = 0;
+				for (unsigned x = 0; x < _width; ++x, ++pixel)
+				{
+					rowRed   += pixel->red;
+					rowGreen += pixel->green;
+					rowBlue  += pixel->blue;
+
+					const unsigned idx = 3 * (x + 1);
+					current[idx]     = above[idx]     + rowRed;
+					current[idx + 1] = above[idx + 1] + rowGreen;
+					current[idx + 2] = above[idx + 2] + rowBlue;
+				}
+			}
+
+			return true;
+		}
+
+		///
+		/// Calculates the 'mean color' of the given led region from the summed-area table in _integral
+		///
+		/// @param[in] area  The led region
+		///
+		/// @return The mean of the given region (or black when empty)
+		///
+		ColorRgb calcIntegralMeanColor(const LedArea & area) const;
+
 		///
 		/// Calculates the 'mean color' over the given image. This is the mean over each color-channel
 		/// (red, green, blue)
@@ -210,25 +381,20 @@ namespace hyperion
 		ColorRgb calcMeanColor(const Image<Pixel_T> & image) const
 		{
 			// Accumulate the sum of each seperate color channel
-			uint_fast16_t cummRed   = 0;
-			uint_fast16_t cummGreen = 0;
-			uint_fast16_t cummBlue  = 0;
+			uint64_t cumm[3] = { 0, 0, 0 };
 			const unsigned imageSize = image.width() * image.height();
 
 			const auto& imgData = image.memptr();
 
-			for (unsigned idx=0; idx<imageSize; idx++)
+			for (unsigned y=0; y<image.height(); y++)
 			{
-				const auto& pixel = imgData[idx];
-				cummRed   += pixel.red;
-				cummGreen += pixel.green;
-				cummBlue  += pixel.blue;
+				sumRow(imgData + y * image.width(), image.width(), cumm);
 			}
 
 			// Compute the average of each color channel
-			const uint8_t avgRed   = uint8_t(cummRed/imageSize);
-			const uint8_t avgGreen = uint8_t(cummGreen/imageSize);
-			const uint8_t avgBlue  = uint8_t(cummBlue/imageSize);
+			const uint8_t avgRed   = uint8_t(cumm[0]/imageSize);
+			const uint8_t avgGreen = uint8_t(cumm[1]/imageSize);
+			const uint8_t avgBlue  = uint8_t(cumm[2]/imageSize);
 
 			// Return the computed color
 			return {avgRed, avgGreen, avgBlue};
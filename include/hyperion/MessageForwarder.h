@@ -13,6 +13,9 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QByteArray>
+#include <QPair>
+#include <QElapsedTimer>
 
 // Utils includes
 #include <utils/ColorRgb.h>
@@ -24,11 +27,23 @@
 // Hyperion includes
 #include <hyperion/PriorityMuxer.h>
 
+// flatbuffer includes
+#include <flatbuffers/flatbuffers.h>
+
 // Forward declaration
 class Hyperion;
 class QTcpSocket;
+class QUdpSocket;
 class FlatBufferConnection;
 
+///
+/// Forwards json messages and images to other Hyperion servers. All targets keep a persistent
+/// connection and are written without blocking, each image is encoded once for all TCP targets
+/// and once more for the datagrams if the raw image doesn't fit.
+/// A target that can't keep up drops the oldest messages, a single slow or unreachable target
+/// doesn't delay the others. Images can also be sent as UDP datagrams to a broadcast address
+/// or a multicast group, which reaches any number of servers in the LAN with a single send.
+///
 class MessageForwarder : public QObject
 {
 	Q_OBJECT
@@ -38,6 +53,7 @@ public:
 
 	void addJsonSlave(QString slave);
 	void addFlatbufferSlave(QString slave);
+	void addUdpSlave(QString slave);
 
 private slots:
 	///
@@ -72,14 +88,42 @@ private slots:
 	///
 	void forwardFlatbufferMessage(const QString& name, const Image<ColorRgb> &image);
 
+private:
+	/// A json target with its connection
+	struct JsonTarget
+	{
+		QTcpSocket* socket;
+		QString host;
+		quint16 port;
+		/// Messages waiting for the connection or for the socket to drain, the oldest are dropped
+		QList<QByteArray> queue;
+	};
+
 	///
-	/// @brief Forward message to a single json slave
-	/// @param message The JSON message to send
-	/// @param socket The TCP-Socket with the connection to the slave
+	/// @brief Write the queued messages of a json target or connect it
+	/// @param target The target
 	///
-	void sendJsonMessage(const QJsonObject &message, QTcpSocket *socket);
+	void sendJsonMessages(JsonTarget* target);
+
+	///
+	/// @brief Close and delete all forwarding connections
+	///
+	void clearTargets();
+
+	///
+	/// @brief Encode an image request into _builder
+	/// @param image       The image
+	/// @param compressed  Encode a CompressedImage instead of a RawImage, for datagrams only as
+	///                    the TCP targets may not know it
+	///
+	void encodeImage(const Image<ColorRgb> &image, bool compressed);
+
+	///
+	/// @brief Send the register request to the UDP targets, repeated as datagrams may get lost
+	///
+	void registerUdpTargets();
+
 
-private:
 	/// Hyperion instance
 	Hyperion *_hyperion;
 
@@ -91,11 +135,24 @@ private:
 
 	// JSON connection for forwarding
 	QStringList   _jsonSlaves;
+	QList<JsonTarget*> _jsonTargets;
 
 	/// Proto connection for forwarding
 	QStringList _flatSlaves;
 	QList<FlatBufferConnection*> _forwardClients;
 
+	/// UDP targets for forwarding
+	QStringList _udpSlaves;
+	QList<QPair<QHostAddress, quint16>> _udpTargets;
+	QUdpSocket* _udpSocket;
+	/// Time since the last register request to the UDP targets
+	QElapsedTimer _udpRegistered;
+	/// Images too large for a datagram were reported
+	bool _udpOversizeLogged;
+
+	/// Builds the image request shared by all targets
+	flatbuffers::FlatBufferBuilder _builder;
+
 	/// Flag if forwarder is enabled
 	bool _forwarder_enabled = true;
 
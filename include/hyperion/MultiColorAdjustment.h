@@ -47,6 +47,12 @@ public:
 	///
 	ColorAdjustment* getAdjustment(const QString& id);
 
+	///
+	/// Marks the adjustment tables as outdated, they are rebuilt with the next applyAdjustment().
+	/// Has to be called after a ColorAdjustment was modified.
+	///
+	void invalidateTables();
+
 	///
 	/// Performs the color adjustment from raw-color to led-color
 	///
@@ -55,6 +61,24 @@ public:
 	void applyAdjustment(std::vector<ColorRgb>& ledColors);
 
 private:
+	///
+	/// A ColorAdjustment compiled into lookup tables. The eight channel adjustments are mixed with
+	/// weights that are multilinear in red, green and blue, so the mix is exact with one table per
+	/// corner of the color cube.
+	///
+	struct AdjustmentTable
+	{
+		/// The adjustment, used for the gamma and backlight transform
+		ColorAdjustment* adjustment;
+		/// Output per corner (black, red, green, blue, cyan, magenta, yellow, white), channel and weight including the brightness
+		uint8_t corners[8][3][256];
+	};
+
+	///
+	/// Compiles the tables of all adjustments and assigns them to the leds
+	///
+	void buildTables();
+
 	/// List with transform ids
 	QStringList _adjustmentIds;
 
@@ -64,6 +88,15 @@ private:
 	/// List with a pointer to the ColorAdjustment for each individual led
 	std::vector<ColorAdjustment*> _ledAdjustments;
 
+	/// The compiled tables of the unique ColorAdjustments
+	std::vector<AdjustmentTable> _tables;
+
+	/// The compiled table for each individual led (nullptr without adjustment)
+	std::vector<const AdjustmentTable*> _ledTables;
+
+	/// False when the tables have to be rebuilt
+	bool _tablesValid;
+
 	// logger instance
 	Logger * _log;
 };
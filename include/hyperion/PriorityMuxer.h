@@ -3,11 +3,12 @@
 // STL includes
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include <atomic>
 
 // QT includes
 #include <QMap>
 #include <QObject>
-#include <QMap>
 #include <QVector>
 
 // Utils includes
@@ -27,10 +28,54 @@ class Logger;
 /// and the muxer keeps track of all active priorities. The current priority can be queried and per
 /// priority the led colors. Handles also manual/auto selection mode, provides a lot of signals to hook into priority related events
 ///
+/// The data of each priority lives in a fixed slot with an atomically swapped frame pointer. Producers
+/// publish frames from any thread without a lock and the consumer reads the visible frame without
+/// copying it. Registration, removal and the priority selection run on the thread of the muxer.
+///
+/// An input may be translucent or limited to a subset of the leds (InputBlend). The visible result
+/// is then composited from the visible priority down to the first opaque input (getVisibleLayers()).
+///
 class PriorityMuxer : public QObject
 {
 	Q_OBJECT
 public:
+	///
+	/// The data of a priority channel, immutable once published
+	///
+	struct InputFrame
+	{
+		/// The colors for each led of the channel
+		std::vector<ColorRgb> ledColors;
+		/// The raw Image (size should be preprocessed!)
+		Image<ColorRgb> image;
+		/// Fingerprint (hash) of the image, 0 without image
+		uint64_t imageFingerprint;
+	};
+	typedef std::shared_ptr<const InputFrame> InputFramePtr;
+
+	///
+	/// The compositing of a priority channel over the lower priorities
+	///
+	struct InputBlend
+	{
+		/// Opacity of the input, 255 covers the lower priorities
+		uint8_t alpha;
+		/// The input is only shown on leds with a non zero entry, empty for all leds
+		std::vector<uint8_t> ledMask;
+	};
+	typedef std::shared_ptr<const InputBlend> InputBlendPtr;
+
+	///
+	/// A priority of the visible stack
+	///
+	struct InputLayer
+	{
+		int priority;
+		InputFramePtr frame;
+		/// The compositing, nullptr for an opaque input
+		InputBlendPtr blend;
+	};
+
 	///
 	/// The information structure for a single priority channel
 	///
@@ -40,10 +85,8 @@ public:
 		int priority;
 		/// The absolute timeout of the channel
 		int64_t timeoutTime_ms;
-		/// The colors for each led of the channel
-		std::vector<ColorRgb> ledColors;
-		/// The raw Image (size should be preprocessed!)
-		Image<ColorRgb> image;
+		/// The current data of the channel, never null
+		InputFramePtr frame;
 		/// The component
 		hyperion::Components componentId;
 		/// Who set it
@@ -71,7 +114,7 @@ public:
 	~PriorityMuxer();
 
 	///
-	/// @brief Start/Stop the PriorityMuxer update timer; On disabled no priority and timeout updates will be performend
+	/// @brief Start/Stop the PriorityMuxer timeout handling; On disabled no timeout updates will be performend
 	/// @param  enable  The new state
 	///
 	void setEnable(const bool& enable);
@@ -107,7 +150,7 @@ public:
 	///
 	/// @return The current priority
 	///
-	int getCurrentPriority() const { return _currentPriority; }
+	int getCurrentPriority() const { return _currentPriority.load(); }
 
 	///
 	/// Returns the state (enabled/disabled) of a specific priority channel
@@ -125,7 +168,8 @@ public:
 
 	///
 	/// Returns the information of a specified priority channel.
-	/// If a priority is no longer available the _lowestPriorityInfo (255) is returned
+	/// If a priority is no longer available the _lowestPriorityInfo (255) is returned. The frame is
+	/// never null, a channel closed concurrently has an empty frame.
 	///
 	/// @param priority The priority channel
 	///
@@ -133,6 +177,48 @@ public:
 	///
 	const InputInfo getInputInfo(const int priority) const;
 
+	///
+	/// Returns the current data of a priority channel without copying it, safe to call from any thread.
+	/// If a priority is not registered the data of the lowest priority is returned
+	///
+	/// @param priority The priority channel
+	///
+	/// @return The frame, never null
+	///
+	InputFramePtr getInputFrame(const int priority) const;
+
+	///
+	/// Returns the smoothing cfg of a priority channel, safe to call from any thread
+	///
+	/// @param priority The priority channel
+	///
+	/// @return The smooth id or SMOOTHING_MODE_DEFAULT if not registered
+	///
+	unsigned getSmoothingConfig(const int priority) const;
+
+	///
+	/// Returns the inputs that contribute to the visible result, safe to call from any thread
+	///
+	/// @return The layers from the visible priority (first) down to the first opaque input (last)
+	///
+	std::vector<InputLayer> getVisibleLayers() const;
+
+	///
+	/// Returns true when the priority contributes to the visible result
+	///
+	/// @param priority The priority channel
+	///
+	bool isVisible(const int priority) const;
+
+	///
+	/// @brief Set the compositing of a registered priority, the setting is reset when the priority is removed
+	/// @param  priority  The priority
+	/// @param  alpha     The opacity (0-255)
+	/// @param  ledMask   Per led flag where the input is shown, empty for all leds
+	/// @return           True on success, false when priority is not found
+	///
+	bool setInputBlend(const int priority, const uint8_t alpha, const std::vector<uint8_t>& ledMask = std::vector<uint8_t>());
+
 	///
 	/// @brief  Register a new input by priority, the priority is not active (timeout -100 isn't muxer recognized) until you start to update the data with setInput()
 	/// 		A repeated call to update the base data of a known priority won't overwrite their current timeout
@@ -158,9 +244,10 @@ public:
 	/// @param  priority    The priority to update
 	/// @param  image       The new image
 	/// @param  timeout_ms  The new timeout (defaults to -1 endless)
+	/// @param  unchanged   Optional output, set to true when the image equals the previous image of this priority
 	/// @return             True on success, false when priority is not found
 	///
-	bool setInputImage(const int priority, const Image<ColorRgb>& image, int64_t timeout_ms = -1);
+	bool setInputImage(const int priority, const Image<ColorRgb>& image, int64_t timeout_ms = -1, bool* unchanged = nullptr);
 
 	///
 	/// @brief Set the given priority to inactive
@@ -225,45 +312,106 @@ signals:
 	///
 	void prioritiesChanged(void);
 
+private slots:
 	///
-	/// internal used signal to resolve treading issues with timer
+	/// Selects the visible priority from the active inputs and the manual selection
 	///
-	void signalTimeTrigger();
+	void setCurrentTime(void);
 
-private slots:
 	///
-	/// Slot which is called to adapt to 1s interval for signal timeRunner() / prioritiesChanged()
+	/// @brief Add the timeout of a priority to the timeout queue if it expires before its queued entry
+	/// @param priority  The priority
 	///
-	void timeTrigger();
+	void scheduleTimeout(const int priority);
 
 	///
-	/// Updates the current time. Channels with a configured time out will be checked and cleared if
-	/// required.
+	/// Clears the priorities whose timeout expired and arms the timer for the next timeout
 	///
-	void setCurrentTime(void);
+	void handleTimeouts();
 
 private:
+	///
+	/// The published state of a priority channel
+	///
+	struct InputSlot
+	{
+		InputSlot() : frame(), blend(), timeoutTime_ms(-100), scheduledTimeout_ms(0), smooth_cfg(SMOOTHING_MODE_DEFAULT), registered(false) {}
+
+		/// The current data, only accessed with std::atomic_load/store/exchange
+		InputFramePtr frame;
+		/// The compositing, nullptr when opaque, accessed like frame
+		InputBlendPtr blend;
+		/// The absolute timeout, -100 while inactive
+		std::atomic<int64_t> timeoutTime_ms;
+		/// The time of the valid entry in the timeout queue, 0 without entry
+		std::atomic<int64_t> scheduledTimeout_ms;
+		/// id of smoothing config
+		std::atomic<unsigned> smooth_cfg;
+		/// True between registerInput() and the removal of the priority
+		std::atomic<bool> registered;
+	};
+
+	///
+	/// @brief Get the slot of a priority
+	/// @param priority  The priority
+	/// @return The slot or nullptr when the priority is out of range
+	///
+	InputSlot* slot(const int priority);
+	const InputSlot* slot(const int priority) const;
+
+	///
+	/// @brief Publish new data of a registered priority and handle active state changes
+	/// @param  priority    The priority
+	/// @param  frame       The new data
+	/// @param  timeout_ms  The absolute timeout or -100 (inactive)
+	/// @return The previous data
+	///
+	InputFramePtr publish(const int priority, const InputFramePtr& frame, int64_t timeout_ms);
+
+	///
+	/// @brief Register a slot with the given data and state
+	///
+	void openSlot(const int priority, const InputFramePtr& frame, int64_t timeout_ms, unsigned smooth_cfg);
+
+	/// @brief Unregister a slot and drop its data
+	void closeSlot(const int priority);
+
+	/// @brief Start the timeout timer for the earliest queued timeout and the 1s timeRunner() while a timed COLOR/EFFECT/IMAGE runs
+	void armTimers();
+
 	/// Logger instance
 	Logger* _log;
 
 	/// The current priority (lowest value in _activeInputs)
-	int _currentPriority;
+	std::atomic<int> _currentPriority;
 
 	/// The manual select priority set with setPriority
 	int _manualSelectedPriority;
 
-	/// The mapping from priority channel to led-information
+	/// The mapping from priority channel to the descriptive information, frame and timeout are kept in _slots
 	QMap<int, InputInfo> _activeInputs;
 
+	/// The published data of every priority
+	InputSlot _slots[256];
+
+	/// The data of a registered priority without input yet
+	InputFramePtr _emptyFrame;
+
 	/// The information of the lowest priority channel
 	InputInfo _lowestPriorityInfo;
 
 	// Reflect the state of auto select
 	bool _sourceAutoSelectEnabled;
 
-	// Timer to update Muxer times independent
-	QTimer* _updateTimer;
+	/// False while the timeouts are suspended with setEnable()
+	bool _enabled;
+
+	/// Min-heap of (timeout, priority), entries of a priority other than its scheduledTimeout_ms are outdated
+	std::vector<std::pair<int64_t, int>> _timeouts;
+
+	/// Fires at the earliest timeout of _timeouts
+	QTimer* _timeoutTimer;
 
-	QTimer* _timer;
-	QTimer* _blockTimer;
+	/// Emits timeRunner() once per second while a COLOR/EFFECT/IMAGE with timeout runs
+	QTimer* _timeRunnerTimer;
 };
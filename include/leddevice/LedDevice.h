@@ -7,6 +7,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QTimer>
+#include <QMutex>
 
 // STL includes
 #include <vector>
@@ -20,6 +21,7 @@
 #include <utils/Logger.h>
 #include <functional>
 #include <utils/Components.h>
+#include <leddevice/LedPacker.h>
 
 class LedDevice;
 
@@ -62,12 +64,32 @@ public:
 
 	inline bool componentState() { return enabled(); };
 
+	///
+	/// @brief Queue led values for the device thread, may be called from any thread. When the queue
+	/// is full, the oldest queued frame is dropped so the output never lags behind the input
+	/// @param ledValues  The RGB-color per led
+	///
+	void enqueue(const std::vector<ColorRgb>& ledValues);
+
 public slots:
 	///
 	/// Is called on thread start, all construction tasks and init should run here
 	///
 	virtual void start() { _deviceReady = open(); };
 
+	///
+	/// @brief Set the color order of each led of the led string
+	/// @param orders  The color order per led
+	///
+	void setColorOrders(const std::vector<ColorOrder>& orders);
+
+	///
+	/// @brief Writes the RGB-Color values in the color order of the led string to the leds
+	/// @param ledValues  The RGB-color per led
+	/// @return Zero on success else negative
+	///
+	int updateLeds(const std::vector<ColorRgb>& ledValues);
+
 	///
 	/// Writes the RGB-Color values to the leds.
 	///
@@ -111,6 +133,12 @@ protected:
 	/// The buffer containing the packed RGB values
 	std::vector<uint8_t> _ledBuffer;
 
+	/// Packs the led values into _ledBuffer, configured by the device in init()
+	LedPacker _packer;
+
+	/// Set by devices that apply the color order with _packer, the others get reordered ledValues
+	bool _packedColorOrder;
+
 	bool _deviceReady;
 
 	QString _activeDevice;
@@ -123,14 +151,48 @@ protected:
 	/// e.g. Adalight device will switch off when it does not receive data at least every 15 seconds
 	QTimer       _refresh_timer;
 	unsigned int _refresh_timer_interval;
+	/// Monotonic time of the last write [us]
 	qint64       _last_write_time;
 	unsigned int _latchTime_ms;
 protected slots:
 	/// Write the last data to the leds again
 	int rewriteLeds();
 
+private slots:
+	/// Write the queued frames in the device thread
+	void processQueue();
+
 private:
+	///
+	/// @brief Log the write statistics and start a new period
+	/// @param now  The current monotonic time [us]
+	///
+	void logWriteStatistics(int64_t now);
+
+	/// Number of write duration histogram buckets, each twice as wide as the previous one
+	static const int WRITE_HISTOGRAM_SIZE = 8;
+
+	/// Frames waiting for the device thread, a ring buffer of the configured queue length
+	QMutex _queueMutex;
+	std::vector<std::vector<ColorRgb>> _queue;
+	size_t _queueHead;
+	size_t _queueCount;
+	/// True while a processQueue() call is posted to the device thread
+	bool _queueScheduled;
+	/// The frame currently written, swapped with the queue slot
+	std::vector<ColorRgb> _queuedValues;
+
+	/// Write statistics since the last report
+	int64_t  _statisticsTime;
+	uint32_t _framesDropped;
+	uint32_t _framesWritten;
+	int64_t  _writeTimeSum_us;
+	int64_t  _writeTimeMax_us;
+	uint32_t _writeHistogram[WRITE_HISTOGRAM_SIZE];
+
 	std::vector<ColorRgb> _ledValues;
+	/// ledValues in the color order of the led string, reused between writes
+	std::vector<ColorRgb> _orderedValues;
 	bool   _componentRegistered;
 	bool   _enabled;
 	QString _colorOrder;
@@ -5,6 +5,9 @@
 #include <utils/ColorRgb.h>
 #include <utils/Components.h>
 
+// hyperion
+#include <hyperion/LedString.h>
+
 class LedDevice;
 class Hyperion;
 
@@ -64,6 +67,12 @@ public:
 	///
 	const QString & getColorOrder();
 
+	///
+	/// @brief Set the color order of each led, applied by the current and all later devices
+	/// @param orders  The color order per led
+	///
+	void setColorOrders(const std::vector<ColorOrder>& orders);
+
 public slots:
 	///
 	/// @brief Handle new component state request
@@ -72,15 +81,19 @@ public slots:
 	///
 	void handleComponentState(const hyperion::Components component, const bool state);
 
+	///
+	/// @brief Queue the led values for the device thread, stale frames of a slow device are dropped
+	/// @param ledValues  The RGB-color per led
+	///
+	void write(const std::vector<ColorRgb>& ledValues);
+
 signals:
 	///
 	/// PIPER signal for Hyperion -> LedDevice
 	///
-	/// @param[in] ledValues  The RGB-color per led
-	///
-	/// @return Zero on success else negative
+	/// @param[in] orders  The color order per led
 	///
-	int write(const std::vector<ColorRgb>& ledValues);
+	void colorOrdersChanged(const std::vector<ColorOrder>& orders);
 
 private slots:
 	///
@@ -108,4 +121,6 @@ private:
 	LedDevice* _ledDevice;
 	// the enable state
 	bool _enabled;
+	// the color order per led
+	std::vector<ColorOrder> _colorOrders;
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+// STL includes
+#include <vector>
+#include <cstdint>
+
+// Utils includes
+#include <utils/ColorRgb.h>
+#include <utils/RgbToRgbw.h>
+#include <hyperion/LedString.h>
+
+///
+/// Output packing stage of the led devices. The color order of the led string, the optional RGBW
+/// conversion, a constant frame byte per led and the bit encoding of one-wire leds driven over SPI
+/// are configured once and applied in a single pass that writes the wire format straight into the
+/// buffer preallocated by the device.
+///
+class LedPacker
+{
+public:
+	LedPacker();
+
+	///
+	/// @brief Set the color order of each led. Leds beyond the given list (the black hardware leds)
+	/// share the order of a uniform list, otherwise they keep RGB
+	/// @param orders  The color order per led
+	///
+	void setColorOrders(const std::vector<ColorOrder>& orders);
+
+	///
+	/// @brief Output four channels per led, converted with the given white algorithm
+	/// @param algorithm  The white algorithm or INVALID to output RGB
+	///
+	void setWhiteAlgorithm(RGBW::WhiteAlgorithm algorithm);
+
+	///
+	/// @brief Write a constant byte in front of each led (e.g. the global brightness of APA102)
+	/// @param prefix  The byte value or -1 for none
+	///
+	void setLedPrefix(int prefix);
+
+	///
+	/// @brief Expand each channel into four bytes, one per bit pair starting with the MSB
+	/// @param patterns  The byte sent for the bit pairs 00, 01, 10 and 11
+	///
+	void setBitPairEncoding(const uint8_t patterns[4]);
+
+	///
+	/// @return True if at least one led has a color order other than RGB
+	///
+	bool isOrdered() const { return _ordered; }
+
+	///
+	/// @return The size of one packed led in bytes
+	///
+	size_t ledSize() const;
+
+	///
+	/// @brief Pack the leds into the wire format
+	/// @param colors  The RGB colors, the first one belongs to the first led of the led string
+	/// @param count   The number of leds to pack
+	/// @param dest    The destination, at least count * ledSize() bytes
+	/// @return The end of the written data
+	///
+	uint8_t* pack(const ColorRgb* colors, size_t count, uint8_t* dest) const;
+
+	///
+	/// @brief Apply the color order only, used for devices that don't pack with the LedPacker
+	/// @param colors   The RGB colors
+	/// @param ordered  Receives the reordered colors, reused between calls
+	///
+	void reorder(const std::vector<ColorRgb>& colors, std::vector<ColorRgb>& ordered) const;
+
+private:
+	/// Source channel of the three output channels, indexed by ColorOrder
+	static const uint8_t CHANNEL_ORDER[6][3];
+
+	/// The color order per led, empty if all leds share _order
+	std::vector<uint8_t> _orders;
+	/// The common color order of all leds
+	ColorOrder _order;
+	bool _ordered;
+
+	RGBW::WhiteAlgorithm _whiteAlgorithm;
+	int _prefix;
+
+	/// Four encoded bytes for each byte value, empty without bit encoding
+	std::vector<uint8_t> _encoding;
+};
@@ -62,6 +62,8 @@ private:
 	NetOrigin* _netOrigin;
 	Logger* _log;
 	int _timeout;
+	/// The largest accepted message of a client in bytes
+	quint32 _maxMessageSize;
 	quint16 _port;
 	const QJsonDocument _config;
 
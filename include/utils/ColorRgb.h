@@ -49,6 +49,18 @@ inline std::ostream& operator<<(std::ostream& os, const ColorRgb& color)
 	return os;
 }
 
+/// Compare operator to check if a color is 'equal' to another color
+inline bool operator==(const ColorRgb & lhs, const ColorRgb & rhs)
+{
+	return (lhs.red == rhs.red) && (lhs.green == rhs.green) && (lhs.blue == rhs.blue);
+}
+
+/// Compare operator to check if a color is 'not equal' to another color
+inline bool operator!=(const ColorRgb & lhs, const ColorRgb & rhs)
+{
+	return !(lhs == rhs);
+}
+
 /// Compare operator to check if a color is 'smaller' than another color
 inline bool operator<(const ColorRgb & lhs, const ColorRgb & rhs)
 {
@@ -0,0 +1,76 @@
+#pragma once
+
+// STL includes
+#include <atomic>
+
+// Qt includes
+#include <QSemaphore>
+
+///
+/// Single slot handoff of frame indices between one producer and one consumer thread with a
+/// "latest frame wins" policy. Publishing never blocks: a frame the consumer did not pick up yet
+/// is replaced and handed back to the producer as dropped. The slot itself is a lock-free atomic,
+/// the semaphore only wakes up the waiting consumer.
+///
+class FrameHandoff
+{
+public:
+	/// Value of an empty slot
+	static const int NO_FRAME = -1;
+
+	FrameHandoff()
+		: _slot(NO_FRAME)
+		, _ready()
+	{
+	}
+
+	///
+	/// @brief Publish a frame (producer side)
+	/// @param index  The frame index, must not be NO_FRAME
+	/// @return The replaced frame that was not consumed in time or NO_FRAME
+	///
+	int publish(const int index)
+	{
+		const int replaced = _slot.exchange(index, std::memory_order_acq_rel);
+		if (replaced == NO_FRAME)
+		{
+			_ready.release();
+		}
+		return replaced;
+	}
+
+	///
+	/// @brief Take the latest frame (consumer side)
+	/// @param timeout_ms  Maximum time to wait for a frame
+	/// @return The frame index or NO_FRAME on timeout
+	///
+	int take(const int timeout_ms)
+	{
+		if (!_ready.tryAcquire(1, timeout_ms))
+		{
+			return NO_FRAME;
+		}
+		return _slot.exchange(NO_FRAME, std::memory_order_acq_rel);
+	}
+
+	///
+	/// @brief True when a published frame waits for the consumer
+	///
+	bool pending() const
+	{
+		return _slot.load(std::memory_order_acquire) != NO_FRAME;
+	}
+
+	///
+	/// @brief Empty the slot, only allowed while both threads are stopped
+	///
+	void reset()
+	{
+		_slot.store(NO_FRAME);
+		_ready.tryAcquire(_ready.available());
+	}
+
+private:
+	std::atomic<int> _slot;
+	QSemaphore _ready;
+};
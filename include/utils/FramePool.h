@@ -0,0 +1,66 @@
+#pragma once
+
+// STL includes
+#include <cstddef>
+
+// Qt includes
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+
+///
+/// The FramePool hands out aligned pixel buffers and keeps released buffers for reuse. A steady
+/// stream of equally sized frames (grabbers, network clients) is served from the pool instead
+/// of allocating and freeing several megabytes per frame.
+///
+class FramePool
+{
+public:
+	/// Alignment of all buffers (cache line and widest SIMD register)
+	static const size_t ALIGNMENT = 64;
+	/// Maximum number of cached buffers per buffer size
+	static const int MAX_BUFFERS_PER_SIZE = 4;
+	/// Upper limit for the memory held by cached buffers
+	static const size_t MAX_CACHED_BYTES = 32 * 1024 * 1024;
+
+	///
+	/// @brief Get the process wide pool
+	/// @return The pool instance
+	///
+	static FramePool* getInstance();
+
+	///
+	/// @brief Get a buffer of the given size, either from the pool or freshly allocated. The content is undefined
+	/// @param bytes  The requested size
+	/// @return       The aligned buffer
+	///
+	void* acquire(size_t bytes);
+
+	///
+	/// @brief Return a buffer obtained with acquire()
+	/// @param buffer  The buffer
+	/// @param bytes   The size the buffer was acquired with
+	///
+	void release(void* buffer, size_t bytes);
+
+	///
+	/// @brief Free all cached buffers
+	///
+	void clear();
+
+	///
+	/// @brief Get the memory currently held by cached buffers
+	/// @return The cached bytes
+	///
+	size_t cachedBytes();
+
+private:
+	FramePool();
+
+	/// Guards the free lists, buffers are released from any thread
+	QMutex _mutex;
+	/// Released buffers by size
+	QHash<size_t, QVector<void*>> _freeBuffers;
+	/// Sum of all cached buffer sizes
+	size_t _cachedBytes;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+// STL includes
+#include <cstdint>
+
+///
+/// Frame scheduler on a monotonic clock with microsecond resolution. Frames are scheduled on
+/// absolute deadlines (start + n * interval), so neither the millisecond granularity of the
+/// timers nor the latency of the event loop accumulates into drift. The lateness of each frame
+/// against its deadline is collected as output jitter.
+///
+class FrameScheduler
+{
+public:
+	/// Output jitter since the last takeJitter()
+	struct Jitter
+	{
+		/// Number of frames
+		uint64_t frames;
+		/// Number of deadlines that passed without a frame
+		uint64_t skipped;
+		/// Average and maximum deviation of a frame from its deadline [us]
+		int64_t average_us;
+		int64_t max_us;
+	};
+
+	///
+	/// @brief Get the monotonic time, not affected by wall clock changes (NTP, user)
+	/// @return The time [us]
+	///
+	static int64_t now();
+
+	FrameScheduler();
+
+	///
+	/// @brief Start scheduling, the first deadline is one interval from now
+	/// @param interval_us  The frame interval [us]
+	///
+	void start(int64_t interval_us);
+
+	/// Stop scheduling
+	void stop();
+
+	bool isActive() const { return _interval > 0; };
+	int64_t interval() const { return _interval; };
+
+	///
+	/// @brief Record a frame and advance to the next deadline. Deadlines which already passed are skipped
+	/// @param now  The time of the frame [us]
+	///
+	void frameDone(int64_t now);
+
+	///
+	/// @brief Get the timer delay until the next deadline, rounded up so a timer never fires early
+	/// @param now  The current time [us]
+	/// @return The delay [ms]
+	///
+	int timerDelay(int64_t now) const;
+
+	///
+	/// @brief Get and reset the collected jitter
+	/// @return The jitter since the last call
+	///
+	Jitter takeJitter();
+
+private:
+	/// The frame interval [us], 0 when stopped
+	int64_t _interval;
+	/// The deadline of the next frame [us]
+	int64_t _deadline;
+
+	/// The jitter accumulators
+	uint64_t _frames;
+	uint64_t _skipped;
+	int64_t  _deviationSum;
+	int64_t  _deviationMax;
+};
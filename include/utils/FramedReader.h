@@ -0,0 +1,88 @@
+#pragma once
+
+// STL includes
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class QIODevice;
+
+///
+/// Reader for a stream of messages with a 4 byte big endian size prefix, as used by the flatbuffer
+/// and protobuf servers. The socket data is read straight into one growable buffer and the messages
+/// are handed out in place. Consumed messages only advance the read position, the incomplete rest
+/// is moved to the front only when the received data doesn't fit behind it. The buffer grows with
+/// the data actually received, doubling its size, so a large image takes a few reallocations and a
+/// peer that only declares a large message doesn't allocate anything. A grown buffer is released
+/// when it drains after a run of small messages, a steady image stream keeps it.
+///
+class FramedReader
+{
+public:
+	/// Default upper limit of a single message
+	static const uint32_t DEFAULT_MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+	/// Result of next()
+	enum Status
+	{
+		/// No complete message in the buffer
+		INCOMPLETE,
+		/// A message was returned
+		MESSAGE,
+		/// The size of the next message exceeds the limit, the stream can't be continued
+		OVERSIZED
+	};
+
+	///
+	/// @brief Constructor
+	/// @param maxMessageSize  The largest accepted message size in bytes
+	///
+	explicit FramedReader(uint32_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE);
+
+	///
+	/// @brief Set the largest accepted message size
+	/// @param maxMessageSize  The size in bytes
+	///
+	void setMaxMessageSize(uint32_t maxMessageSize) { _maxMessageSize = maxMessageSize; }
+
+	///
+	/// @brief Read all available data of the device into the buffer
+	/// @param device  The socket
+	///
+	void readFrom(QIODevice* device);
+
+	///
+	/// @brief Take the next complete message out of the buffer
+	/// @param[out] data  The message without size prefix, valid until the next call of readFrom() or next()
+	/// @param[out] size  The size of the message
+	/// @return The status
+	///
+	Status next(const uint8_t*& data, uint32_t& size);
+
+	///
+	/// @brief Drop all buffered data and release the buffer
+	///
+	void clear();
+
+private:
+	///
+	/// @brief Make room for the given number of bytes behind the buffered data
+	/// @param bytes  The required free space
+	///
+	void reserve(size_t bytes);
+
+	///
+	/// @return The size of the next message or 0 if its prefix is incomplete
+	///
+	uint32_t pendingMessageSize() const;
+
+	/// The buffer, the data between _head and _tail is unread
+	std::vector<uint8_t> _buffer;
+	size_t _head;
+	size_t _tail;
+
+	/// The largest message (with prefix) handed out since the buffer was drained last, 0 if none
+	size_t _largestFrame;
+
+	uint32_t _maxMessageSize;
+};
@@ -2,12 +2,67 @@
 
 // STL includes
 #include <vector>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
 #include <cassert>
 #include <utils/ColorRgb.h>
+#include <utils/FramePool.h>
+#include <utils/PixelKernels.h>
+
+// Qt includes
+#include <QSharedData>
+#include <QSharedDataPointer>
+
+///
+/// The pixel buffer of an Image. It is shared between copies of an image and only duplicated when
+/// one of the copies is modified (copy-on-write). The memory comes aligned from the FramePool.
+/// The fingerprint of the pixels is computed once and then shared by all copies of the frame.
+///
+template <typename Pixel_T>
+class ImageData : public QSharedData
+{
+public:
+	ImageData(const unsigned width, const unsigned height)
+		: _width(width)
+		, _height(height)
+		, _capacity(size_t(width) * height + 1)
+		, _pixels(static_cast<Pixel_T*>(FramePool::getInstance()->acquire(_capacity * sizeof(Pixel_T))))
+		, _fingerprint(0)
+	{
+	}
+
+	ImageData(const ImageData & other)
+		: QSharedData(other)
+		, _width(other._width)
+		, _height(other._height)
+		, _capacity(other._capacity)
+		, _pixels(static_cast<Pixel_T*>(FramePool::getInstance()->acquire(_capacity * sizeof(Pixel_T))))
+		, _fingerprint(0)
+	{
+		memcpy(_pixels, other._pixels, _capacity * sizeof(Pixel_T));
+	}
+
+	~ImageData()
+	{
+		FramePool::getInstance()->release(_pixels, _capacity * sizeof(Pixel_T));
+	}
+
+	/// The width of the image
+	unsigned _width;
+	/// The height of the image
+	unsigned _height;
+	/// The number of allocated pixels (including the extra pixel)
+	size_t _capacity;
+	/// The pixels of the image
+	Pixel_T* _pixels;
+	/// The cached fingerprint of the pixels, 0 when not computed yet
+	mutable std::atomic<uint64_t> _fingerprint;
 
+private:
+	ImageData& operator=(const ImageData&) = delete;
+};
 
 template <typename Pixel_T>
 class Image
@@ -20,12 +75,9 @@ public:
 	/// Default constructor for an image
 	///
 	Image() :
-		_width(1),
-		_height(1),
-		_pixels(new Pixel_T[2]),
-		_endOfPixels(_pixels + 1)
+		_d(new ImageData<Pixel_T>(1, 1))
 	{
-		memset(_pixels, 0, 2*sizeof(Pixel_T));
+		memset(_d->_pixels, 0, 2*sizeof(Pixel_T));
 	}
 
 	///
@@ -35,12 +87,9 @@ public:
 	/// @param height The height of the image
 	///
 	Image(const unsigned width, const unsigned height) :
-		_width(width),
-		_height(height),
-		_pixels(new Pixel_T[width * height + 1]),
-		_endOfPixels(_pixels + width * height)
+		_d(new ImageData<Pixel_T>(width, height))
 	{
-		memset(_pixels, 0, (_width*_height+1)*sizeof(Pixel_T));
+		memset(_d->_pixels, 0, _d->_capacity*sizeof(Pixel_T));
 	}
 
 	///
@@ -51,51 +100,35 @@ public:
 	/// @param background The color of the image
 	///
 	Image(const unsigned width, const unsigned height, const Pixel_T background) :
-		_width(width),
-		_height(height),
-		_pixels(new Pixel_T[width * height + 1]),
-		_endOfPixels(_pixels + width * height)
+		_d(new ImageData<Pixel_T>(width, height))
 	{
-		std::fill(_pixels, _endOfPixels, background);
+		std::fill(_d->_pixels, _d->_pixels + _d->_capacity, background);
 	}
 
 	///
-	/// Copy constructor for an image
+	/// Copy constructor for an image, the pixels are shared until one of the images is modified
 	///
 	Image(const Image & other) :
-		_width(other._width),
-		_height(other._height),
-		_pixels(new Pixel_T[other._width * other._height + 1]),
-		_endOfPixels(_pixels + other._width * other._height)
+		_d(other._d)
 	{
-		memcpy(_pixels, other._pixels, (long) other._width * other._height * sizeof(Pixel_T));
 	}
 
-	// Define assignment operator in terms of the copy constructor
-	// More to read: https://stackoverflow.com/questions/255612/dynamically-allocating-an-array-of-objects?answertab=active#tab-top
-	Image& operator=(Image rhs)
+	Image& operator=(const Image & rhs)
 	{
-		rhs.swap(*this);
+		_d = rhs._d;
 		return *this;
 	}
 
 	void swap(Image& s) noexcept
 	{
-		using std::swap;
-		swap(this->_width, s._width);
-		swap(this->_height, s._height);
-		swap(this->_pixels, s._pixels);
-		swap(this->_endOfPixels, s._endOfPixels);
+		_d.swap(s._d);
 	}
 
 	// C++11
 	Image(Image&& src) noexcept
-		: _width(0)
-		, _height(0)
-		, _pixels(NULL)
-		, _endOfPixels(NULL)
+		: _d()
 	{
-		src.swap(*this);
+		_d.swap(src._d);
 	}
 	Image& operator=(Image&& src) noexcept
 	{
@@ -108,7 +141,6 @@ public:
 	///
 	~Image()
 	{
-		delete[] _pixels;
 	}
 
 	///
@@ -118,7 +150,7 @@ public:
 	///
 	inline unsigned width() const
 	{
-		return _width;
+		return _d->_width;
 	}
 
 	///
@@ -128,22 +160,22 @@ public:
 	///
 	inline unsigned height() const
 	{
-		return _height;
+		return _d->_height;
 	}
 
 	uint8_t red(const unsigned pixel) const
 	{
-		return (_pixels + pixel)->red;
+		return (_d->_pixels + pixel)->red;
 	}
 
 	uint8_t green(const unsigned pixel) const
 	{
-		return (_pixels + pixel)->green;
+		return (_d->_pixels + pixel)->green;
 	}
 
 	uint8_t blue(const unsigned pixel) const
 	{
-		return (_pixels + pixel)->blue;
+		return (_d->_pixels + pixel)->blue;
 	}
 
 	///
@@ -156,11 +188,12 @@ public:
 	///
 	const Pixel_T& operator()(const unsigned x, const unsigned y) const
 	{
-		return _pixels[toIndex(x,y)];
+		return _d->_pixels[toIndex(x,y)];
 	}
 
 	///
-	/// Returns a reference to a specified pixel in the image
+	/// Returns a reference to a specified pixel in the image. A shared buffer is detached first, loops
+	/// over many pixels read through a const image or write through memptr().
 	///
 	/// @param x The x index
 	/// @param y The y index
@@ -169,23 +202,26 @@ public:
 	///
 	Pixel_T& operator()(const unsigned x, const unsigned y)
 	{
-		return _pixels[toIndex(x,y)];
+		return modify()->_pixels[toIndex(x,y)];
 	}
 
-	/// Resize the image
+	/// Resize the image for a producer that writes all pixels. A buffer that is too small or still
+	/// shared with other copies is replaced by a fresh one from the FramePool without copying the
+	/// pixels, their content is undefined then. Otherwise the buffer is kept as it is.
 	/// @param width The width of the image
 	/// @param height The height of the image
 	void resize(const unsigned width, const unsigned height)
 	{
-		if ((width*height) > unsigned((_endOfPixels-_pixels)))
+		const ImageData<Pixel_T>* current = _d.constData();
+		if (current->ref.load() > 1 || (size_t(width)*height + 1) > current->_capacity)
 		{
-			delete[] _pixels;
-			_pixels = new Pixel_T[width*height + 1];
-			_endOfPixels = _pixels + width*height;
+			_d = new ImageData<Pixel_T>(width, height);
+			return;
 		}
 
-		_width = width;
-		_height = height;
+		ImageData<Pixel_T>* d = modify();
+		d->_width = width;
+		d->_height = height;
 	}
 
 	///
@@ -195,19 +231,20 @@ public:
 	///
 	void copy(const Image<Pixel_T>& other)
 	{
-		assert(other._width == _width);
-		assert(other._height == _height);
+		assert(other.width() == width());
+		assert(other.height() == height());
 
-		memcpy(_pixels, other._pixels, _width*_height*sizeof(Pixel_T));
+		// sharing the buffer replaces the memcpy
+		_d = other._d;
 	}
 
 	///
-	/// Returns a memory pointer to the first pixel in the image
+	/// Returns a memory pointer to the first pixel in the image. A shared buffer is detached first.
 	/// @return The memory pointer to the first pixel
 	///
 	Pixel_T* memptr()
 	{
-		return _pixels;
+		return modify()->_pixels;
 	}
 
 	///
@@ -216,24 +253,57 @@ public:
 	///
 	const Pixel_T* memptr() const
 	{
-		return _pixels;
+		return _d->_pixels;
+	}
+
+	///
+	/// Returns true when the pixel buffer is referenced by more than this image
+	///
+	bool isShared() const
+	{
+		return _d.constData()->ref.load() > 1;
 	}
 
+	///
+	/// Returns a hash of the size and the pixels to recognize repeated frames. It is computed on the
+	/// first call and shared by all copies of the image, so every consumer of a broadcasted frame
+	/// gets it for free. An empty (1x1) image has the fingerprint 0.
+	///
+	uint64_t fingerprint() const
+	{
+		const ImageData<Pixel_T>* d = _d.constData();
+		if (size_t(d->_width) * d->_height <= 1)
+		{
+			return 0;
+		}
+
+		uint64_t hash = d->_fingerprint.load(std::memory_order_relaxed);
+		if (hash == 0)
+		{
+			const uint64_t seed = (uint64_t(d->_width) << 32) | d->_height;
+			hash = PixelKernels::hash64(d->_pixels, size_t(size()), seed);
+			hash = (hash != 0) ? hash : 1;
+			d->_fingerprint.store(hash, std::memory_order_relaxed);
+		}
+		return hash;
+	}
 
 	///
 	/// Convert image of any color order to a RGB image.
 	///
 	/// @param[out] image  The image that buffers the output
 	///
-	void toRgb(Image<ColorRgb>& image)
+	void toRgb(Image<ColorRgb>& image) const
 	{
-		image.resize(_width, _height);
-		const unsigned imageSize = _width * _height;
+		image.resize(width(), height());
+		const unsigned imageSize = width() * height();
 
+		const Pixel_T* source = memptr();
+		ColorRgb* target = image.memptr();
 		for (unsigned idx=0; idx<imageSize; idx++)
 		{
-			const Pixel_T color = memptr()[idx];
-			image.memptr()[idx] = ColorRgb{color.red, color.green, color.blue};
+			const Pixel_T color = source[idx];
+			target[idx] = ColorRgb{color.red, color.green, color.blue};
 		}
 	}
 
@@ -242,18 +312,15 @@ public:
 	//
 	ssize_t size() const
 	{
-		return  (ssize_t) _width * _height * sizeof(Pixel_T);
+		return  (ssize_t) width() * height() * sizeof(Pixel_T);
 	}
 
 	/// Clear the image
 	//
 	void clear()
 	{
-		_width = 1;
-		_height = 1;
-		_pixels = new Pixel_T[2];
-		_endOfPixels = _pixels + 1;
-		memset(_pixels, 0, _width * _height * sizeof(Pixel_T));
+		_d = new ImageData<Pixel_T>(1, 1);
+		memset(_d->_pixels, 0, 2*sizeof(Pixel_T));
 	}
 
 private:
@@ -268,18 +335,20 @@ private:
 	///
 	inline unsigned toIndex(const unsigned x, const unsigned y) const
 	{
-		return y*_width + x;
+		return y*_d->_width + x;
 	}
 
-private:
-	/// The width of the image
-	unsigned _width;
-	/// The height of the image
-	unsigned _height;
-
-	/// The pixels of the image
-	Pixel_T* _pixels;
+	///
+	/// Write access to the pixel buffer, a shared buffer is detached and the fingerprint is dropped
+	///
+	inline ImageData<Pixel_T>* modify()
+	{
+		ImageData<Pixel_T>* d = _d.data();
+		d->_fingerprint.store(0, std::memory_order_relaxed);
+		return d;
+	}
 
-	/// Pointer to the last(extra) pixel
-	Pixel_T* _endOfPixels;
+private:
+	/// The implicitly shared pixel buffer
+	QSharedDataPointer<ImageData<Pixel_T>> _d;
 };
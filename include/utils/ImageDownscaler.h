@@ -0,0 +1,99 @@
+#pragma once
+
+// STL includes
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Qt includes
+#include <QSize>
+
+// Utils includes
+#include <utils/Image.h>
+#include <utils/ColorRgb.h>
+
+///
+/// Ingest policy for images of network clients. The led layout of an instance only needs a few pixels
+/// per led, larger images just cost memory and the full scans of the black border detection and the
+/// led mapping. Oversized images are reduced by an integer factor per axis with a box filter, each
+/// output pixel is the rounded mean of its box, so the result never gets smaller than the target.
+/// The filter reads each source pixel once and is applied while the image is copied out of the
+/// receive buffer.
+///
+class ImageDownscaler
+{
+public:
+	/// Image pixels per cell of the led layout grid in each direction
+	static const int PIXELS_PER_GRID_CELL = 8;
+	/// Lower limit of the target size, keeps enough detail for the black border detection
+	static const int MIN_WIDTH = 160;
+	static const int MIN_HEIGHT = 90;
+
+	///
+	/// @brief Get the target size for a led layout
+	/// @param ledGridSize  The grid size of the led layout
+	/// @return The target size
+	///
+	static QSize targetSize(const QSize& ledGridSize);
+
+	///
+	/// @brief Set the target size of an instance, network clients reduce their images to the largest
+	/// target size of all instances
+	/// @param instance    The instance index
+	/// @param targetSize  The target size
+	///
+	static void setInstanceTargetSize(quint8 instance, const QSize& targetSize);
+
+	///
+	/// @brief Remove the target size of a stopped instance
+	/// @param instance  The instance index
+	///
+	static void removeInstance(quint8 instance);
+
+	///
+	/// @return The largest target size of all instances, invalid if there is no instance
+	///
+	static QSize ingestSize();
+
+	///
+	/// @brief Constructor
+	/// @param targetSize  The target size, images are only copied while it is invalid
+	///
+	explicit ImageDownscaler(const QSize& targetSize = QSize());
+
+	void setTargetSize(const QSize& targetSize) { _targetSize = targetSize; }
+	const QSize& targetSize() const { return _targetSize; }
+
+	///
+	/// @return True if an image of the given size is reduced
+	///
+	bool isOversized(int width, int height) const;
+
+	///
+	/// @brief Copy a packed RGB image and reduce it if it is oversized
+	/// @param data        The first pixel
+	/// @param width       The width of the image
+	/// @param height      The height of the image
+	/// @param lineLength  The bytes per row
+	/// @param dest        Receives the image
+	///
+	void scale(const uint8_t* data, int width, int height, size_t lineLength, Image<ColorRgb>& dest);
+
+	///
+	/// @brief Reduce an image, an image that isn't oversized is shared with dest
+	/// @param image  The image
+	/// @param dest   Receives the image
+	///
+	void scale(const Image<ColorRgb>& image, Image<ColorRgb>& dest);
+
+private:
+	///
+	/// @return The reduction factor of an axis
+	///
+	static int factor(int size, int target);
+
+	QSize _targetSize;
+
+	/// Channel sums of one output row
+	std::vector<uint32_t> _sums;
+};
@@ -22,12 +22,12 @@ public:
 
 	void setVideoMode(VideoMode mode);
 
+	///
+	/// @brief Crops, decimates and converts a raw frame to RGB. The row conversion is selected once per
+	///        frame, large frames are split into row bands which are converted in parallel
+	///
 	void processImage(const uint8_t * data, int width, int height, int lineLength, PixelFormat pixelFormat, Image<ColorRgb> & outputImage) const;
 
-private:
-	static inline uint8_t clamp(int x);
-	static void yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t & r, uint8_t & g, uint8_t & b);
-
 private:
 	int _horizontalDecimation;
 	int _verticalDecimation;
@@ -36,4 +36,6 @@ private:
 	int _cropTop;
 	int _cropBottom;
 	VideoMode _videoMode;
+	/// Upper limit of the row bands of a frame, the cpu count
+	int _maxThreads;
 };
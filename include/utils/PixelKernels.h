@@ -0,0 +1,138 @@
+#pragma once
+
+// STL includes
+#include <cstdint>
+#include <cstddef>
+
+///
+/// Vectorized pixel kernels. The implementation (SSE2/AVX2, NEON or scalar) is selected once at
+/// runtime based on the features of the executing cpu. All implementations produce bit-identical
+/// results.
+///
+namespace PixelKernels {
+
+	///
+	/// @brief Adds the channel sums of packed 24-bit pixels (three interleaved 8-bit channels) to the given accumulators
+	/// @param[in]     data   Pointer to the first pixel
+	/// @param[in]     count  Number of pixels
+	/// @param[in/out] sums   The per channel accumulators in memory order, count must not exceed 16843009 pixels per call
+	///
+	void sumRgb24(const uint8_t* data, size_t count, uint32_t sums[3]);
+
+	///
+	/// @brief Converts a single YUV sample to RGB (BT.601, video range)
+	/// @see http://en.wikipedia.org/wiki/YUV#Y.27UV444_to_RGB888_conversion
+	///
+	inline void yuvToRgb(const uint8_t y, const uint8_t u, const uint8_t v, uint8_t& r, uint8_t& g, uint8_t& b)
+	{
+		const int c = y - 16;
+		const int d = u - 128;
+		const int e = v - 128;
+
+		const int red   = (298 * c + 409 * e + 128) >> 8;
+		const int green = (298 * c - 100 * d - 208 * e + 128) >> 8;
+		const int blue  = (298 * c + 516 * d + 128) >> 8;
+
+		r = uint8_t(red   < 0 ? 0 : (red   > 255 ? 255 : red));
+		g = uint8_t(green < 0 ? 0 : (green > 255 ? 255 : green));
+		b = uint8_t(blue  < 0 ? 0 : (blue  > 255 ? 255 : blue));
+	}
+
+	///
+	/// @brief Converts a row of YUYV (YUV 4:2:2) pixels to packed RGB
+	/// @param[in]  source  The first byte of an even pixel
+	/// @param[in]  count   The number of output pixels
+	/// @param[out] dest    The packed RGB output (3*count bytes)
+	///
+	void yuyvToRgb24(const uint8_t* source, size_t count, uint8_t* dest);
+
+	///
+	/// @brief Converts a row of UYVY (YUV 4:2:2) pixels to packed RGB
+	/// @param[in]  source  The first byte of an even pixel
+	/// @param[in]  count   The number of output pixels
+	/// @param[out] dest    The packed RGB output (3*count bytes)
+	///
+	void uyvyToRgb24(const uint8_t* source, size_t count, uint8_t* dest);
+
+	///
+	/// @brief Converts a row of 32-bit pixels with memory order blue, green, red, unused to packed RGB
+	/// @param[in]  source  The first pixel
+	/// @param[in]  count   The number of pixels
+	/// @param[out] dest    The packed RGB output (3*count bytes)
+	///
+	void bgr32ToRgb24(const uint8_t* source, size_t count, uint8_t* dest);
+
+	///
+	/// @brief Converts a row of 32-bit pixels with memory order red, green, blue, unused to packed RGB
+	/// @param[in]  source  The first pixel
+	/// @param[in]  count   The number of pixels
+	/// @param[out] dest    The packed RGB output (3*count bytes)
+	///
+	void rgb32ToRgb24(const uint8_t* source, size_t count, uint8_t* dest);
+
+	///
+	/// @brief Counts the pixels of a packed 24-bit row that are not black. A pixel is black when all
+	///        of its channels are below the threshold
+	/// @param[in] data       Pointer to the first pixel
+	/// @param[in] count      Number of pixels
+	/// @param[in] threshold  The black threshold per channel
+	/// @return The number of non-black pixels
+	///
+	size_t countNonBlackRgb24(const uint8_t* data, size_t count, uint8_t threshold);
+
+	///
+	/// @brief Increments the counter of every non-black pixel of a packed 24-bit row (see countNonBlackRgb24).
+	///        Summed up over several rows this gives the non-black pixels per column
+	/// @param[in]     data       Pointer to the first pixel
+	/// @param[in]     count      Number of pixels
+	/// @param[in]     threshold  The black threshold per channel
+	/// @param[in/out] counts     One counter per pixel
+	///
+	void accumulateNonBlackRgb24(const uint8_t* data, size_t count, uint8_t threshold, uint16_t* counts);
+
+	///
+	/// @brief Moves 16-bit values towards their targets by a fraction of the distance. The step is
+	///        rounded up, so a value reaches its target within a finite number of calls
+	/// @param[in/out] values   The current values
+	/// @param[in]     targets  The target values
+	/// @param[in]     count    The number of values
+	/// @param[in]     factor   The fraction of the distance in 1/65536 units
+	///
+	void approach16(uint16_t* values, const uint16_t* targets, size_t count, uint16_t factor);
+
+	///
+	/// @brief Blend bytes over the destination: dest = (src * weight + dest * (255 - weight)) / 255, rounded
+	/// @param[in/out] dest     The lower layer and the result
+	/// @param[in]     src      The upper layer
+	/// @param[in]     weights  The opacity of each byte of the upper layer
+	/// @param[in]     count    The number of bytes
+	///
+	void blend8(uint8_t* dest, const uint8_t* src, const uint8_t* weights, size_t count);
+
+	///
+	/// @brief Adds the channel sums of consecutive boxes of packed 24-bit pixels to per box accumulators,
+	///        the horizontal pass of a box filter
+	/// @param[in]     data      Pointer to the first pixel
+	/// @param[in]     boxes     Number of boxes
+	/// @param[in]     boxWidth  Number of pixels per box
+	/// @param[in/out] sums      Three accumulators per box in memory order
+	///
+	void sumBoxesRgb24(const uint8_t* data, size_t boxes, unsigned boxWidth, uint32_t* sums);
+
+	///
+	/// @brief Fast non-cryptographic 64-bit hash of a memory block, used to detect unchanged frames.
+	///        The result depends only on the data, not on the selected kernel set
+	/// @param[in] data  The first byte
+	/// @param[in] size  The number of bytes
+	/// @param[in] seed  Start value, allows to chain several blocks (e.g. rows) into one hash
+	/// @return The hash value
+	///
+	uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+	///
+	/// @brief Get the name of the kernel set selected for this cpu
+	/// @return The kernel set name ("avx2", "sse2", "neon" or "scalar")
+	///
+	const char* kernelName();
+
+}
@@ -121,6 +121,12 @@ private:
 		, _backlightColored;
 	double    _backlightThreshold
 		, _sumBrightnessLow;
+	/// integer form of the backlight, rgb sums below _backlightSum are raised
+	int       _backlightSum;
+	/// level of the uncolored backlight
+	uint8_t   _backlightGray;
+	/// scale factor of the colored backlight per rgb sum
+	uint8_t   _backlightFactor[766];
 
 	/// gamma variables
 	double    _gammaR
@@ -24,6 +24,7 @@
 #include <utils/ColorSys.h>
 #include <utils/Process.h>
 #include <utils/JsonUtils.h>
+#include <utils/ImageDownscaler.h>
 
 // bonjour wrapper
 #include <bonjour/bonjourbrowserwrapper.h>
@@ -213,6 +214,12 @@ void JsonAPI::handleColorCommand(const QJsonObject& message, const QString& comm
 	const QJsonArray & jsonColor = message["color"].toArray();
 	const ColorRgb color = {uint8_t(jsonColor.at(0).toInt()),uint8_t(jsonColor.at(1).toInt()),uint8_t(jsonColor.at(2).toInt())};
 
+	// register the color input first, so the blend is in place before the color is published
+	if (_hyperion->getPriorityInfo(priority).componentId != hyperion::COMP_COLOR)
+		_hyperion->clear(priority);
+	_hyperion->registerInput(priority, hyperion::COMP_COLOR, origin);
+	applyInputBlend(message, priority);
+
 	// set color
 	_hyperion->setColor(priority, color, duration, origin);
 
@@ -302,11 +309,13 @@ void JsonAPI::handleImageCommand(const QJsonObject& message, const QString& comm
 		}
 	}
 
-	// copy image
-	Image<ColorRgb> image(width, height);
-	memcpy(image.memptr(), data.data(), data.size());
+	// copy image, reduced to the resolution the led layout of this instance needs
+	Image<ColorRgb> image;
+	ImageDownscaler downscaler(ImageDownscaler::targetSize(_hyperion->getLedGridSize()));
+	downscaler.scale(reinterpret_cast<const uint8_t*>(data.constData()), width, height, size_t(width) * 3, image);
 
 	_hyperion->registerInput(priority, hyperion::COMP_IMAGE, origin, imgName);
+	applyInputBlend(message, priority);
 	_hyperion->setInputImage(priority, image, duration);
 
 	// send reply
@@ -326,10 +335,11 @@ void JsonAPI::handleEffectCommand(const QJsonObject &message, const QString &com
 	const QString & effectName = effect["name"].toString();
 	const QString & data = message["imageData"].toString("").toUtf8();
 
-	// set output
+	// set output, the effect registers its priority right away and sends the first frame from its thread
 	 (effect.contains("args"))
 		? _hyperion->setEffect(effectName, effect["args"].toObject(), priority, duration, pythonScript, origin, data)
 		: _hyperion->setEffect(effectName, priority, duration, origin);
+	applyInputBlend(message, priority);
 
 	// send reply
 	sendSuccessReply(command, tan);
@@ -416,15 +426,15 @@ void JsonAPI::handleServerInfoCommand(const QJsonObject& message, const QString&
 		item["active"] = (priorityInfo.timeoutTime_ms >= -1);
 		item["visible"] = (priority == currentPriority);
 
-		if(priorityInfo.componentId == hyperion::COMP_COLOR && !priorityInfo.ledColors.empty())
+		if(priorityInfo.componentId == hyperion::COMP_COLOR && !priorityInfo.frame->ledColors.empty())
 		{
 			QJsonObject LEDcolor;
 
 			// add RGB Value to Array
 			QJsonArray RGBValue;
-			RGBValue.append(priorityInfo.ledColors.begin()->red);
-			RGBValue.append(priorityInfo.ledColors.begin()->green);
-			RGBValue.append(priorityInfo.ledColors.begin()->blue);
+			RGBValue.append(priorityInfo.frame->ledColors.begin()->red);
+			RGBValue.append(priorityInfo.frame->ledColors.begin()->green);
+			RGBValue.append(priorityInfo.frame->ledColors.begin()->blue);
 			LEDcolor.insert("RGB", RGBValue);
 
 			uint16_t Hue;
@@ -432,9 +442,9 @@ void JsonAPI::handleServerInfoCommand(const QJsonObject& message, const QString&
 
 			// add HSL Value to Array
 			QJsonArray HSLValue;
-			ColorSys::rgb2hsl(priorityInfo.ledColors.begin()->red,
-					priorityInfo.ledColors.begin()->green,
-					priorityInfo.ledColors.begin()->blue,
+			ColorSys::rgb2hsl(priorityInfo.frame->ledColors.begin()->red,
+					priorityInfo.frame->ledColors.begin()->green,
+					priorityInfo.frame->ledColors.begin()->blue,
 					Hue, Saturation, Luminace);
 
 			HSLValue.append(Hue);
@@ -665,21 +675,21 @@ void JsonAPI::handleServerInfoCommand(const QJsonObject& message, const QString&
 		// ACTIVE STATIC LED COLOR
 		QJsonArray activeLedColors;
 		const Hyperion::InputInfo & priorityInfo = _hyperion->getPriorityInfo(_hyperion->getCurrentPriority());
-		if(priorityInfo.componentId == hyperion::COMP_COLOR && !priorityInfo.ledColors.empty())
+		if(priorityInfo.componentId == hyperion::COMP_COLOR && !priorityInfo.frame->ledColors.empty())
 		{
 			QJsonObject LEDcolor;
 			// check if LED Color not Black (0,0,0)
-			if ((priorityInfo.ledColors.begin()->red +
-			priorityInfo.ledColors.begin()->green +
-			priorityInfo.ledColors.begin()->blue != 0))
+			if ((priorityInfo.frame->ledColors.begin()->red +
+			priorityInfo.frame->ledColors.begin()->green +
+			priorityInfo.frame->ledColors.begin()->blue != 0))
 			{
 				QJsonObject LEDcolor;
 
 				// add RGB Value to Array
 				QJsonArray RGBValue;
-				RGBValue.append(priorityInfo.ledColors.begin()->red);
-				RGBValue.append(priorityInfo.ledColors.begin()->green);
-				RGBValue.append(priorityInfo.ledColors.begin()->blue);
+				RGBValue.append(priorityInfo.frame->ledColors.begin()->red);
+				RGBValue.append(priorityInfo.frame->ledColors.begin()->green);
+				RGBValue.append(priorityInfo.frame->ledColors.begin()->blue);
 				LEDcolor.insert("RGB Value", RGBValue);
 
 				uint16_t Hue;
@@ -687,9 +697,9 @@ void JsonAPI::handleServerInfoCommand(const QJsonObject& message, const QString&
 
 				// add HSL Value to Array
 				QJsonArray HSLValue;
-				ColorSys::rgb2hsl(priorityInfo.ledColors.begin()->red,
-						priorityInfo.ledColors.begin()->green,
-						priorityInfo.ledColors.begin()->blue,
+				ColorSys::rgb2hsl(priorityInfo.frame->ledColors.begin()->red,
+						priorityInfo.frame->ledColors.begin()->green,
+						priorityInfo.frame->ledColors.begin()->blue,
 						Hue, Saturation, Luminace);
 
 				HSLValue.append(Hue);
@@ -1486,6 +1496,17 @@ void JsonAPI::handleInstanceCommand(const QJsonObject & message, const QString &
 	}
 }
 
+void JsonAPI::applyInputBlend(const QJsonObject& message, const int priority)
+{
+	// without alpha and leds the priority covers the lower priorities
+	std::vector<int> leds;
+	for (const QJsonValue& led : message["leds"].toArray())
+	{
+		leds.push_back(led.toInt());
+	}
+	_hyperion->setInputBlend(priority, message["alpha"].toInt(255), leds);
+}
+
 void JsonAPI::handleNotImplemented()
 {
 	sendErrorReply("Command not implemented");
@@ -225,15 +225,15 @@ void JsonCB::handlePriorityUpdate()
 		item["active"] = (priorityInfo.timeoutTime_ms >= -1);
 		item["visible"] = (priority == currentPriority);
 
-		if(priorityInfo.componentId == hyperion::COMP_COLOR && !priorityInfo.ledColors.empty())
+		if(priorityInfo.componentId == hyperion::COMP_COLOR && !priorityInfo.frame->ledColors.empty())
 		{
 			QJsonObject LEDcolor;
 
 			// add RGB Value to Array
 			QJsonArray RGBValue;
-			RGBValue.append(priorityInfo.ledColors.begin()->red);
-			RGBValue.append(priorityInfo.ledColors.begin()->green);
-			RGBValue.append(priorityInfo.ledColors.begin()->blue);
+			RGBValue.append(priorityInfo.frame->ledColors.begin()->red);
+			RGBValue.append(priorityInfo.frame->ledColors.begin()->green);
+			RGBValue.append(priorityInfo.frame->ledColors.begin()->blue);
 			LEDcolor.insert("RGB", RGBValue);
 
 			uint16_t Hue;
@@ -241,9 +241,9 @@ void JsonCB::handlePriorityUpdate()
 
 			// add HSL Value to Array
 			QJsonArray HSLValue;
-			ColorSys::rgb2hsl(priorityInfo.ledColors.begin()->red,
-					priorityInfo.ledColors.begin()->green,
-					priorityInfo.ledColors.begin()->blue,
+			ColorSys::rgb2hsl(priorityInfo.frame->ledColors.begin()->red,
+					priorityInfo.frame->ledColors.begin()->green,
+					priorityInfo.frame->ledColors.begin()->blue,
 					Hue, Saturation, Luminace);
 
 			HSLValue.append(Hue);
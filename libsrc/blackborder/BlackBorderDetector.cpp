@@ -1,14 +1,107 @@
 #include <iostream>
 #include <utils/Logger.h>
+#include <utils/PixelKernels.h>
 
 // BlackBorders includes
 #include <blackborder/BlackBorderDetector.h>
 #include <cmath>
+#include <algorithm>
 
 using namespace hyperion;
 
+namespace {
+
+/// A line belongs to the content when at least 1/CONTENT_RATIO of its pixels are not black
+const int CONTENT_RATIO = 8;
+
+/// Consecutive content lines that end a border, single noisy lines stay part of the border
+const int CONTENT_LINES = 3;
+
+/// Maximum number of rows that are sampled for the left and right border
+const int SAMPLE_ROWS = 64;
+
+///
+/// Border of one side of the image
+///
+struct Edge
+{
+	/// Lines until the content starts, -1 if there is no content in the scanned band
+	int size;
+	/// Contrast between the content and the brightest border line [0 .. 1]
+	double confidence;
+};
+
+///
+/// Scans the lines of one side from the image edge inwards. The border ends at the first run of
+/// CONTENT_LINES content lines, which has to start within the first 'limit' lines.
+///
+/// @param lines     The number of lines of this side that can be scanned
+/// @param limit     The number of lines that may belong to the border
+/// @param total     The number of pixels per line
+/// @param nonBlack  Returns the number of non-black pixels of line i (counted from the edge)
+///
+template <typename NonBlack_T>
+Edge findEdge(const int lines, const int limit, const int total, NonBlack_T nonBlack)
+{
+	int bandMax = 0;
+	int runStart = -1;
+	int runSum = 0;
+	int runMax = 0;
+
+	const int end = std::min(lines, limit + CONTENT_LINES - 1);
+	for (int i = 0; i < end; ++i)
+	{
+		const int count = nonBlack(i);
+		if (count * CONTENT_RATIO < total)
+		{
+			// an interrupted run is noise within the border
+			bandMax = std::max(bandMax, std::max(runMax, count));
+			runStart = -1;
+			runSum = runMax = 0;
+			if (i >= limit)
+			{
+				break;
+			}
+			continue;
+		}
+
+		if (runStart < 0)
+		{
+			if (i >= limit)
+			{
+				break;
+			}
+			runStart = i;
+		}
+		runSum += count;
+		runMax = std::max(runMax, count);
+
+		if (i - runStart + 1 == CONTENT_LINES)
+		{
+			const double contrast = 2.0 * (double(runSum) / CONTENT_LINES - bandMax) / total;
+			return { runStart, std::min(1.0, std::max(0.0, contrast)) };
+		}
+	}
+
+	return { -1, 0.0 };
+}
+
+///
+/// Combines both sides of an axis, a border that differs by more than a few lines is probably
+/// content (e.g. a dark sky) instead of a letterbox
+///
+Edge combineEdges(const Edge& first, const Edge& second, const int length)
+{
+	const int tolerance = std::max(2, length / 50);
+	const double symmetry = (std::abs(first.size - second.size) <= tolerance) ? 1.0 : 0.5;
+	return { std::min(first.size, second.size), std::min(first.confidence, second.confidence) * symmetry };
+}
+
+} // anonymous namespace
+
 BlackBorderDetector::BlackBorderDetector(double threshold)
 	: _blackborderThreshold(calculateThreshold(threshold))
+	, _columnCounts()
 {
 	// empty
 }
@@ -27,3 +120,51 @@ uint8_t BlackBorderDetector::calculateThreshold(double threshold)
 
 	return blackborderThreshold;
 }
+
+BlackBorder BlackBorderDetector::process_statistic(const Image<ColorRgb> & image)
+{
+	const int width = image.width();
+	const int height = image.height();
+	const uint8_t* pixels = reinterpret_cast<const uint8_t*>(image.memptr());
+	const size_t lineLength = size_t(width) * 3;
+
+	BlackBorder detectedBorder = { true, -1, -1, 1.0 };
+
+	// top and bottom border from the non-black pixels of whole rows
+	auto rowCount = [&](const int y) { return int(PixelKernels::countNonBlackRgb24(pixels + y * lineLength, width, _blackborderThreshold)); };
+	const Edge top    = findEdge(height, height / 3, width, [&](const int i) { return rowCount(i); });
+	const Edge bottom = findEdge(height, height / 3, width, [&](const int i) { return rowCount(height - 1 - i); });
+	if (top.size < 0 || bottom.size < 0)
+	{
+		return detectedBorder;
+	}
+	const Edge horizontal = combineEdges(top, bottom, height);
+
+	// left and right border from the non-black pixels per column of sampled content rows
+	const int band = std::min(width / 3 + CONTENT_LINES - 1, width / 2);
+	const int firstRow = horizontal.size;
+	const int rows = height - 2 * horizontal.size;
+	const int samples = std::min(SAMPLE_ROWS, rows);
+
+	_columnCounts.assign(2 * band, 0);
+	for (int k = 0; k < samples; ++k)
+	{
+		const uint8_t* row = pixels + (firstRow + (2 * k + 1) * rows / (2 * samples)) * lineLength;
+		PixelKernels::accumulateNonBlackRgb24(row, band, _blackborderThreshold, _columnCounts.data());
+		PixelKernels::accumulateNonBlackRgb24(row + (width - band) * 3, band, _blackborderThreshold, _columnCounts.data() + band);
+	}
+
+	const Edge left  = findEdge(band, width / 3, samples, [&](const int i) { return int(_columnCounts[i]); });
+	const Edge right = findEdge(band, width / 3, samples, [&](const int i) { return int(_columnCounts[2 * band - 1 - i]); });
+	if (left.size < 0 || right.size < 0)
+	{
+		return detectedBorder;
+	}
+	const Edge vertical = combineEdges(left, right, width);
+
+	detectedBorder.unknown = false;
+	detectedBorder.horizontalSize = horizontal.size;
+	detectedBorder.verticalSize = vertical.size;
+	detectedBorder.confidence = std::min(horizontal.confidence, vertical.confidence);
+	return detectedBorder;
+}
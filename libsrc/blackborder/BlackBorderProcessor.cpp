@@ -1,5 +1,8 @@
 #include <iostream>
 
+#include <QMutex>
+#include <QMutexLocker>
+
 #include <hyperion/Hyperion.h>
 
 // Blackborder includes
@@ -7,6 +10,56 @@
 
 using namespace hyperion;
 
+constexpr double BlackBorderProcessor::MIN_CONFIDENCE;
+
+namespace {
+
+///
+/// Detection results of the latest frames. All instances receive the same captured frame, so the
+/// entries only have to cover the frames that are processed at the same time.
+///
+struct DetectionCache
+{
+	struct Entry
+	{
+		uint64_t fingerprint;
+		QString mode;
+		double threshold;
+		BlackBorder border;
+	};
+
+	static const int SIZE = 8;
+
+	QMutex mutex;
+	Entry entries[SIZE];
+	int next = 0;
+
+	bool lookup(uint64_t fingerprint, const QString& mode, double threshold, BlackBorder& border)
+	{
+		QMutexLocker lock(&mutex);
+		for (const Entry& entry : entries)
+		{
+			if (entry.fingerprint == fingerprint && entry.threshold == threshold && entry.mode == mode)
+			{
+				border = entry.border;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void insert(uint64_t fingerprint, const QString& mode, double threshold, const BlackBorder& border)
+	{
+		QMutexLocker lock(&mutex);
+		entries[next] = { fingerprint, mode, threshold, border };
+		next = (next + 1) % SIZE;
+	}
+};
+
+DetectionCache detectionCache;
+
+} // anonymous namespace
+
 BlackBorderProcessor::BlackBorderProcessor(Hyperion* hyperion, QObject* parent)
 	: QObject(parent)
 	, _hyperion(hyperion)
@@ -104,6 +157,27 @@ void BlackBorderProcessor::setHardDisable(const bool& disable) {
 	_hardDisabled = disable;
 };
 
+BlackBorder BlackBorderProcessor::detectBorder(const Image<ColorRgb> & image)
+{
+	auto detect = [&]() {
+		return (_detectionMode == "statistic") ? _detector->process_statistic(image) : detectBorder<ColorRgb>(image);
+	};
+
+	const uint64_t fingerprint = image.fingerprint();
+	if (fingerprint == 0)
+	{
+		return detect();
+	}
+
+	BlackBorder imageBorder;
+	if (!detectionCache.lookup(fingerprint, _detectionMode, _oldThreshold, imageBorder))
+	{
+		imageBorder = detect();
+		detectionCache.insert(fingerprint, _detectionMode, _oldThreshold, imageBorder);
+	}
+	return imageBorder;
+}
+
 BlackBorder BlackBorderProcessor::getCurrentBorder() const
 {
 	return _currentBorder;
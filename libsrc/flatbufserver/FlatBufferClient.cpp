@@ -1,19 +1,65 @@
 #include "FlatBufferClient.h"
+#include "SharedFrames.h"
 
 // qt
 #include <QTcpSocket>
+#include <QLocalSocket>
 #include <QHostAddress>
 #include <QTimer>
 #include <QRgb>
+#include <QImage>
+#include <QImageReader>
+#include <QBuffer>
+
+namespace {
+
+/// Largest width and height of a decoded image
+const int MAX_IMAGE_SIZE = 4096;
+
+}
 
 FlatBufferClient::FlatBufferClient(QTcpSocket* socket, const int &timeout, QObject *parent)
 	: QObject(parent)
 	, _log(Logger::getInstance("FLATBUFSERVER"))
 	, _socket(socket)
+	, _local(false)
 	, _clientAddress("@"+socket->peerAddress().toString())
 	, _timeoutTimer(new QTimer(this))
 	, _timeout(timeout * 1000)
 	, _priority()
+{
+	init();
+	connect(socket, &QTcpSocket::disconnected, this, &FlatBufferClient::disconnected);
+}
+
+FlatBufferClient::FlatBufferClient(QLocalSocket* socket, const int &timeout, QObject *parent)
+	: QObject(parent)
+	, _log(Logger::getInstance("FLATBUFSERVER"))
+	, _socket(socket)
+	, _local(true)
+	, _clientAddress("@local")
+	, _timeoutTimer(new QTimer(this))
+	, _timeout(timeout * 1000)
+	, _priority()
+{
+	init();
+	connect(socket, &QLocalSocket::disconnected, this, &FlatBufferClient::disconnected);
+}
+
+FlatBufferClient::FlatBufferClient(const QString& address, const int &timeout, QObject *parent)
+	: QObject(parent)
+	, _log(Logger::getInstance("FLATBUFSERVER"))
+	, _socket(nullptr)
+	, _local(false)
+	, _clientAddress("@udp:"+address)
+	, _timeoutTimer(new QTimer(this))
+	, _timeout(timeout * 1000)
+	, _priority()
+{
+	init();
+}
+
+void FlatBufferClient::init()
 {
 	// timer setup
 	_timeoutTimer->setSingleShot(true);
@@ -21,54 +67,66 @@ FlatBufferClient::FlatBufferClient(QTcpSocket* socket, const int &timeout, QObje
 	connect(_timeoutTimer, &QTimer::timeout, this, &FlatBufferClient::forceClose);
 
 	// connect socket signals
-	connect(_socket, &QTcpSocket::readyRead, this, &FlatBufferClient::readyRead);
-	connect(_socket, &QTcpSocket::disconnected, this, &FlatBufferClient::disconnected);
+	if (_socket != nullptr)
+		connect(_socket, &QIODevice::readyRead, this, &FlatBufferClient::readyRead);
 }
 
-void FlatBufferClient::readyRead()
+void FlatBufferClient::handleDatagram(const uint8_t* data, uint32_t size)
 {
 	_timeoutTimer->start();
+	handleRequest(data, size);
+}
 
-	_receiveBuffer += _socket->readAll();
+void FlatBufferClient::handleRequest(const uint8_t* data, uint32_t size)
+{
+	flatbuffers::Verifier verifier(data, size);
 
-	// check if we can read a header
-	while(_receiveBuffer.size() >= 4)
+	if (hyperionnet::VerifyRequestBuffer(verifier))
 	{
-		uint32_t messageSize =
-			((_receiveBuffer[0]<<24) & 0xFF000000) |
-			((_receiveBuffer[1]<<16) & 0x00FF0000) |
-			((_receiveBuffer[2]<< 8) & 0x0000FF00) |
-			((_receiveBuffer[3]    ) & 0x000000FF);
+		auto message = hyperionnet::GetRequest(data);
+		handleMessage(message);
+		return;
+	}
+	sendErrorReply("Unable to parse message");
+}
 
-		// check if we can read a complete message
-		if((uint32_t) _receiveBuffer.size() < messageSize + 4) return;
+void FlatBufferClient::readyRead()
+{
+	_timeoutTimer->start();
 
-		// extract message only and remove header + msg from buffer :: QByteArray::remove() does not return the removed data
-		const QByteArray msg = _receiveBuffer.right(messageSize);
-		_receiveBuffer.remove(0, messageSize + 4);
+	_reader.readFrom(_socket);
 
-		const auto* msgData = reinterpret_cast<const uint8_t*>(msg.constData());
-		flatbuffers::Verifier verifier(msgData, messageSize);
+	// the messages are verified and parsed in place
+	const uint8_t* msgData;
+	uint32_t messageSize;
+	FramedReader::Status status;
+	while ((status = _reader.next(msgData, messageSize)) == FramedReader::MESSAGE)
+	{
+		handleRequest(msgData, messageSize);
+	}
 
-		if (hyperionnet::VerifyRequestBuffer(verifier))
-		{
-			auto message = hyperionnet::GetRequest(msgData);
-			handleMessage(message);
-			continue;
-		}
-		sendErrorReply("Unable to parse message");
+	if (status == FramedReader::OVERSIZED)
+	{
+		Error(_log, "Message of client %s exceeds the size limit, closing the connection", QSTRING_CSTR(_clientAddress));
+		sendErrorReply("Message exceeds the size limit");
+		_reader.clear();
+		forceClose();
 	}
 }
 
 void FlatBufferClient::forceClose()
 {
-	_socket->close();
+	if (_socket != nullptr)
+		_socket->close();
+	else
+		disconnected();
 }
 
 void FlatBufferClient::disconnected()
 {
 	Debug(_log, "Socket Closed");
-	_socket->deleteLater();
+	if (_socket != nullptr)
+		_socket->deleteLater();
 	if (_priority != 0 && _priority >= 100 && _priority < 200)
 		emit clearGlobalInput(_priority);
 
@@ -131,7 +189,15 @@ void FlatBufferClient::handleRegisterCommand(const hyperionnet::Register *regReq
 	_priority = regReq->priority();
 	emit registerGlobalInput(_priority, hyperion::COMP_FLATBUFSERVER, regReq->origin()->c_str()+_clientAddress);
 
-	auto reply = hyperionnet::CreateReplyDirect(_builder, nullptr, -1, (_priority ? _priority : -1));
+	// the client switches to other image types than RawImage only if they are listed
+	uint32_t imageTypes = (1u << hyperionnet::ImageType_RawImage) | (1u << hyperionnet::ImageType_CompressedImage)
+		| (1u << hyperionnet::ImageType_JpegImage) | (1u << hyperionnet::ImageType_DeltaImage);
+	if (_local)
+	{
+		imageTypes |= 1u << hyperionnet::ImageType_SharedImage;
+	}
+
+	auto reply = hyperionnet::CreateReplyDirect(_builder, nullptr, -1, (_priority ? _priority : -1), imageTypes);
 	_builder.Finish(reply);
 
 	// send reply
@@ -143,6 +209,10 @@ void FlatBufferClient::handleImageCommand(const hyperionnet::Image *image)
 	// extract parameters
 	int duration = image->duration();
 
+	// decoded into a pooled image buffer, the last image is the reference of delta images
+	Image<ColorRgb> imageDest;
+	_downscaler.setTargetSize(ImageDownscaler::ingestSize());
+
 	const void* reqPtr;
 	if ((reqPtr = image->data_as_RawImage()) != nullptr)
 	{
@@ -151,21 +221,240 @@ void FlatBufferClient::handleImageCommand(const hyperionnet::Image *image)
 		const int width = img->width();
 		const int height = img->height();
 
-		if ((int) imageData->size() != width*height*3)
+		if (imageData == nullptr || width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE
+			|| (int) imageData->size() != width*height*3)
 		{
-			sendErrorReply("Size of image data does not match with the width and height");
+			sendErrorReply("Size of image data does not match with the width and height", image->data_type());
 			return;
 		}
 
-		Image<ColorRgb> imageDest(width, height);
+		imageDest.resize(width, height);
 		memmove(imageDest.memptr(), imageData->data(), imageData->size());
-		emit setGlobalInputImage(_priority, imageDest, duration);
 	}
+	else if ((reqPtr = image->data_as_CompressedImage()) != nullptr)
+	{
+		const auto *img = static_cast<const hyperionnet::CompressedImage*>(reqPtr);
+		const int width = img->width();
+		const int height = img->height();
+
+		if (width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE)
+		{
+			sendErrorReply("Invalid width or height of the compressed image", image->data_type());
+			return;
+		}
+
+		imageDest.resize(width, height);
+		if (!uncompress(img->data(), reinterpret_cast<uint8_t*>(imageDest.memptr()), size_t(width) * height * 3))
+		{
+			sendErrorReply("Size of image data does not match with the width and height", image->data_type());
+			return;
+		}
+	}
+	else if ((reqPtr = image->data_as_JpegImage()) != nullptr)
+	{
+		const auto *img = static_cast<const hyperionnet::JpegImage*>(reqPtr);
+
+		if (img->data() == nullptr)
+		{
+			sendErrorReply("Unable to decode the jpeg image", image->data_type());
+			return;
+		}
+
+		// the size is read from the header, a large declared size is rejected before anything is decoded
+		QByteArray jpegData = QByteArray::fromRawData(reinterpret_cast<const char*>(img->data()->data()), int(img->data()->size()));
+		QBuffer jpegBuffer(&jpegData);
+		QImageReader reader(&jpegBuffer, "JPG");
+		const QSize size = reader.size();
+		if (!size.isValid() || size.width() > MAX_IMAGE_SIZE || size.height() > MAX_IMAGE_SIZE)
+		{
+			sendErrorReply("Invalid width or height of the jpeg image", image->data_type());
+			return;
+		}
+
+		QImage jpeg;
+		if (!reader.read(&jpeg) || jpeg.width() > MAX_IMAGE_SIZE || jpeg.height() > MAX_IMAGE_SIZE)
+		{
+			sendErrorReply("Unable to decode the jpeg image", image->data_type());
+			return;
+		}
+
+		jpeg = jpeg.convertToFormat(QImage::Format_RGB888);
+		imageDest.resize(jpeg.width(), jpeg.height());
+		ColorRgb* dest = imageDest.memptr();
+		for (int y = 0; y < jpeg.height(); ++y)
+		{
+			memcpy(dest + y * jpeg.width(), jpeg.constScanLine(y), size_t(jpeg.width()) * 3);
+		}
+	}
+	else if ((reqPtr = image->data_as_DeltaImage()) != nullptr)
+	{
+		const auto *img = static_cast<const hyperionnet::DeltaImage*>(reqPtr);
+		const int width = img->width();
+		const int height = img->height();
+		const int tileSize = img->tileSize();
+
+		if (width != int(_lastImage.width()) || height != int(_lastImage.height()) || width == 0 || height == 0)
+		{
+			sendErrorReply("Delta image without a matching previous image", image->data_type());
+			return;
+		}
+
+		if (tileSize <= 0 || tileSize > MAX_IMAGE_SIZE)
+		{
+			sendErrorReply("Invalid tile size of the delta image", image->data_type());
+			return;
+		}
+
+		const unsigned tilesX = (width + tileSize - 1) / tileSize;
+		const unsigned tilesY = (height + tileSize - 1) / tileSize;
+
+		// the pixel count of all listed tiles gives the expected size of the data
+		size_t pixels = 0;
+		const auto* tiles = img->tiles();
+		const unsigned tileCount = tiles != nullptr ? tiles->size() : 0;
+		for (unsigned i = 0; i < tileCount; ++i)
+		{
+			const unsigned tile = tiles->Get(i);
+			if (tile >= tilesX * tilesY)
+			{
+				sendErrorReply("Invalid tile index of the delta image", image->data_type());
+				return;
+			}
+			pixels += size_t(qMin(tileSize, width - int(tile % tilesX) * tileSize)) * qMin(tileSize, height - int(tile / tilesX) * tileSize);
+		}
+
+		// shares the buffer of the previous image, it is detached on the first write only
+		imageDest = _lastImage;
+		if (tileCount > 0)
+		{
+			_deltaBuffer.resize(pixels * 3);
+			if (!uncompress(img->data(), _deltaBuffer.data(), _deltaBuffer.size()))
+			{
+				sendErrorReply("Size of image data does not match with the tiles", image->data_type());
+				return;
+			}
+
+			ColorRgb* dest = imageDest.memptr();
+			const uint8_t* source = _deltaBuffer.data();
+			for (unsigned i = 0; i < tileCount; ++i)
+			{
+				const unsigned tile = tiles->Get(i);
+				const int x0 = int(tile % tilesX) * tileSize;
+				const int y0 = int(tile / tilesX) * tileSize;
+				const int tileWidth = qMin(tileSize, width - x0);
+				const int tileHeight = qMin(tileSize, height - y0);
+
+				for (int y = y0; y < y0 + tileHeight; ++y)
+				{
+					memcpy(dest + y * width + x0, source, size_t(tileWidth) * 3);
+					source += tileWidth * 3;
+				}
+			}
+		}
+	}
+	else if ((reqPtr = image->data_as_SharedImage()) != nullptr)
+	{
+		const std::string error = readSharedImage(static_cast<const hyperionnet::SharedImage*>(reqPtr), imageDest);
+		if (!error.empty())
+		{
+			sendErrorReply(error, image->data_type());
+			return;
+		}
+	}
+	else
+	{
+		sendErrorReply("Unknown image type", image->data_type());
+		return;
+	}
+
+	// the full size image stays the reference of delta images, the instances get the reduced one
+	_lastImage = imageDest;
+	Image<ColorRgb> scaled;
+	_downscaler.scale(imageDest, scaled);
+	emit setGlobalInputImage(_priority, scaled, duration);
 
 	// send reply
 	sendSuccessReply();
 }
 
+std::string FlatBufferClient::readSharedImage(const hyperionnet::SharedImage* image, Image<ColorRgb>& dest)
+{
+	if (!_local)
+	{
+		return "Shared images are only accepted on local connections";
+	}
+
+	// attach to the frame ring of the client, a new key replaces a grown ring
+	const QString key = QString::fromStdString(image->key()->str());
+	if (!_sharedFrames.isAttached() || _sharedFrames.nativeKey() != key)
+	{
+		_sharedFrames.detach();
+		_sharedFrames.setNativeKey(key);
+		if (!_sharedFrames.attach(QSharedMemory::ReadWrite))
+		{
+			return "Unable to attach to the shared memory: " + _sharedFrames.errorString().toStdString();
+		}
+	}
+
+	// the header is written by the client, check it against the size of the segment. The slot size is
+	// compared by division, a product could wrap around on 32-bit systems
+	auto* header = static_cast<SharedFrames::Header*>(_sharedFrames.data());
+	const size_t segmentSize = size_t(_sharedFrames.size());
+	const uint32_t slotCount = header->slotCount;
+	const size_t slotSize = header->slotSize;
+	if (segmentSize < SharedFrames::DATA_OFFSET || header->magic != SharedFrames::MAGIC || slotCount == 0 || slotCount > SharedFrames::SLOT_COUNT
+		|| slotSize > (segmentSize - SharedFrames::DATA_OFFSET) / slotCount)
+	{
+		return "Invalid shared memory frame ring";
+	}
+
+	const int slot = image->slot();
+	const int width = image->width();
+	const int height = image->height();
+	if (slot < 0 || uint32_t(slot) >= slotCount || width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE
+		|| size_t(width) * height * 3 > slotSize)
+	{
+		return "Invalid slot or size of the shared image";
+	}
+
+	if (header->state[slot].load(std::memory_order_acquire) != SharedFrames::SLOT_READY)
+	{
+		return "Shared image slot is not ready";
+	}
+
+	const uint8_t* pixels = static_cast<const uint8_t*>(_sharedFrames.constData()) + SharedFrames::DATA_OFFSET + slot * slotSize;
+	// no delta image refers to a shared image, it is reduced while copying it out of the slot
+	_downscaler.scale(pixels, width, height, size_t(width) * 3, dest);
+
+	header->state[slot].store(SharedFrames::SLOT_FREE, std::memory_order_release);
+	return std::string();
+}
+
+bool FlatBufferClient::uncompress(const flatbuffers::Vector<uint8_t>* data, uint8_t* dest, size_t size)
+{
+	if (data == nullptr || data->size() < 4)
+	{
+		return false;
+	}
+
+	// check the size header first, a wrong header must not allocate anything
+	const uint8_t* header = data->data();
+	const size_t expected = (size_t(header[0]) << 24) | (size_t(header[1]) << 16) | (size_t(header[2]) << 8) | header[3];
+	if (expected != size)
+	{
+		return false;
+	}
+
+	const QByteArray pixels = qUncompress(data->data(), int(data->size()));
+	if (size_t(pixels.size()) != size)
+	{
+		return false;
+	}
+
+	memcpy(dest, pixels.constData(), size);
+	return true;
+}
+
 
 void FlatBufferClient::handleClearCommand(const hyperionnet::Clear *clear)
 {
@@ -194,12 +483,24 @@ void FlatBufferClient::handleNotImplemented()
 
 void FlatBufferClient::sendMessage()
 {
+	// datagram senders get no replies
+	if (_socket == nullptr)
+	{
+		_builder.Clear();
+		return;
+	}
+
 	auto size = _builder.GetSize();
 	const uint8_t* buffer = _builder.GetBufferPointer();
 	uint8_t sizeData[] = {uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size)};
 	_socket->write((const char *) sizeData, sizeof(sizeData));
 	_socket->write((const char *)buffer, size);
-	_socket->flush();
+
+	// QIODevice has no flush(), both socket types provide one
+	if (_local)
+		static_cast<QLocalSocket*>(_socket)->flush();
+	else
+		static_cast<QTcpSocket*>(_socket)->flush();
 	_builder.Clear();
 }
 
@@ -212,10 +513,10 @@ void FlatBufferClient::sendSuccessReply()
 	sendMessage();
 }
 
-void FlatBufferClient::sendErrorReply(const std::string &error)
+void FlatBufferClient::sendErrorReply(const std::string &error, hyperionnet::ImageType imageType)
 {
 	// create reply
-	auto reply = hyperionnet::CreateReplyDirect(_builder, error.c_str());
+	auto reply = hyperionnet::CreateReplyDirect(_builder, error.c_str(), -1, -1, 0, uint8_t(imageType));
 	_builder.Finish(reply);
 
 	// send reply
@@ -5,12 +5,19 @@
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/Components.h>
+#include <utils/FramedReader.h>
+#include <utils/ImageDownscaler.h>
 
 // flatbuffer FBS
 #include "hyperion_reply_generated.h"
 #include "hyperion_request_generated.h"
 
+// qt
+#include <QSharedMemory>
+
+class QIODevice;
 class QTcpSocket;
+class QLocalSocket;
 class QTimer;
 
 namespace flatbuf {
@@ -32,6 +39,35 @@ public:
 	///
 	explicit FlatBufferClient(QTcpSocket* socket, const int &timeout, QObject *parent = nullptr);
 
+	///
+	/// @brief Construct the client of a local connection, which may send images in shared memory
+	/// @param socket   The local socket
+	/// @param timeout  The timeout when a client is automatically disconnected and the priority unregistered
+	/// @param parent   The parent
+	///
+	explicit FlatBufferClient(QLocalSocket* socket, const int &timeout, QObject *parent = nullptr);
+
+	///
+	/// @brief Construct the client of a datagram sender, it gets no replies
+	/// @param address  The address and port of the sender
+	/// @param timeout  The timeout when the priority of a sender is unregistered
+	/// @param parent   The parent
+	///
+	explicit FlatBufferClient(const QString& address, const int &timeout, QObject *parent = nullptr);
+
+	///
+	/// @brief Handle a datagram, which holds one request without size prefix
+	/// @param data  The datagram
+	/// @param size  The size of the datagram
+	///
+	void handleDatagram(const uint8_t* data, uint32_t size);
+
+	///
+	/// @brief Set the largest accepted message, the client is disconnected on a larger one
+	/// @param maxMessageSize  The size in bytes
+	///
+	void setMaxMessageSize(uint32_t maxMessageSize) { _reader.setMaxMessageSize(maxMessageSize); }
+
 signals:
 	///
 	/// @brief forward register data to HyperionDaemon
@@ -70,7 +106,7 @@ public slots:
 	void registationRequired(const int priority);
 
 	///
-	/// @brief close the socket and call disconnected()
+	/// @brief close the socket and call disconnected(), a datagram client is closed immediately
 	///
 	void forceClose();
 
@@ -108,6 +144,35 @@ private:
 	///
 	void handleImageCommand(const hyperionnet::Image *image);
 
+	///
+	/// @brief Decompress the data of a compressed or delta image
+	/// @param data  The compressed data with the qCompress size header
+	/// @param dest  The destination
+	/// @param size  The expected size of the decompressed data
+	/// @return True if the data decompressed to exactly size bytes
+	///
+	bool uncompress(const flatbuffers::Vector<uint8_t>* data, uint8_t* dest, size_t size);
+
+	///
+	/// @brief Copy an image out of the shared memory frame ring of the client and free its slot
+	/// @param image  The request
+	/// @param dest   Receives the image
+	/// @return An error message or an empty string on success
+	///
+	std::string readSharedImage(const hyperionnet::SharedImage* image, Image<ColorRgb>& dest);
+
+	///
+	/// @brief Setup the timeout and the socket, shared by all constructors
+	///
+	void init();
+
+	///
+	/// @brief Verify and handle one request
+	/// @param data  The request
+	/// @param size  The size of the request
+	///
+	void handleRequest(const uint8_t* data, uint32_t size);
+
 	///
 	/// @brief Handle clear command
 	///
@@ -134,18 +199,32 @@ private:
 	/// Send an error message back to the client
 	///
 	/// @param error String describing the error
+	/// @param imageType The type of the rejected image, lets the client fall back to another type
 	///
-	void sendErrorReply(const std::string & error);
+	void sendErrorReply(const std::string & error, hyperionnet::ImageType imageType = hyperionnet::ImageType_NONE);
 
 private:
 	Logger *_log;
-	QTcpSocket *_socket;
+	/// The socket, nullptr for a datagram sender
+	QIODevice *_socket;
+	/// True for a local socket
+	bool _local;
 	const QString _clientAddress;
 	QTimer *_timeoutTimer;
 	int _timeout;
 	int _priority;
 
-	QByteArray _receiveBuffer;
+	/// Reads the size prefixed messages of the socket
+	FramedReader _reader;
+
+	/// The last decoded image, reference of delta images
+	Image<ColorRgb> _lastImage;
+	/// Decompressed pixels of the tiles of a delta image
+	std::vector<uint8_t> _deltaBuffer;
+	/// The frame ring of a local client
+	QSharedMemory _sharedFrames;
+	/// Reduces oversized images to the resolution the led layouts of the instances need
+	ImageDownscaler _downscaler;
 
 	// Flatbuffers builder
 	flatbuffers::FlatBufferBuilder _builder;
@@ -1,19 +1,67 @@
 // stl includes
 #include <stdexcept>
+#include <new>
 
 // Qt includes
 #include <QRgb>
+#include <QBuffer>
+#include <QHostAddress>
+#include <QCoreApplication>
+
+namespace {
+
+/// Edge length of the tiles of a delta image
+const int TILE_SIZE = 16;
+
+/// A delta image is only sent if at most this share of the tiles changed
+const double MAX_CHANGED_TILES = 0.5;
+
+/// JPEG quality and the channel difference of a tile that counts as unchanged once JPEG is used
+const int JPEG_QUALITY = 75;
+const int JPEG_TOLERANCE = 12;
+
+/// Share of the measured bandwidth full images may use
+const double BANDWIDTH_HEADROOM = 0.8;
+
+/// Growth of the bandwidth estimate per image while the socket is idle, probes for a recovered link
+const double BANDWIDTH_PROBE = 1.01;
+
+/// Time all slots of the frame ring may stay in use before the images are sent over the socket
+const qint64 SLOT_STALL_TIMEOUT = 2000;
+
+}
 
 // flatbuffer includes
 #include <flatbufserver/FlatBufferConnection.h>
+#include "SharedFrames.h"
 
 FlatBufferConnection::FlatBufferConnection(const QString& origin, const QString & address, const int& priority, const bool& skipReply)
 	: _socket()
+	, _localSocket()
+	, _local(false)
+	, _frames()
+	, _sharedFrames(true)
+	, _slotSize(0)
+	, _frameRings(0)
+	, _slotStall()
 	, _origin(origin)
 	, _priority(priority)
 	, _prevSocketState(QAbstractSocket::UnconnectedState)
 	, _log(Logger::getInstance("FLATBUFCONNECTION"))
 	, _registered(false)
+	, _imageTypes(0)
+	, _referenceImage()
+	, _changedTiles()
+	, _tilePixels()
+	, _frameTimer()
+	, _bytesWritten(0)
+	, _lastDrained(0)
+	, _lastPending(0)
+	, _lastImageSize(0)
+	, _pendingImage()
+	, _bandwidth(0)
+	, _frameRate(0)
+	, _sizeRatio{ 1.0, 0.5, 0.1 }
 {
 	QStringList parts = address.split(":");
 	if (parts.size() != 2)
@@ -29,8 +77,13 @@ FlatBufferConnection::FlatBufferConnection(const QString& origin, const QString
 		throw std::runtime_error(QString("FLATBUFCONNECTION ERROR: Unable to parse the port (%1)").arg(parts[1]).toStdString());
 	}
 
-	if(!skipReply)
-		connect(&_socket, &QTcpSocket::readyRead, this, &FlatBufferConnection::readData, Qt::UniqueConnection);
+	// a server on the same host is tried on its local socket first
+	_local = (_host == "localhost" || QHostAddress(_host).isLoopback());
+	connect(&_localSocket, static_cast<void (QLocalSocket::*)(QLocalSocket::LocalSocketError)>(&QLocalSocket::error), this, &FlatBufferConnection::localSocketError);
+	connect(&_socket, &QTcpSocket::bytesWritten, this, &FlatBufferConnection::writePendingImage);
+	connect(&_localSocket, &QLocalSocket::bytesWritten, this, &FlatBufferConnection::writePendingImage);
+
+	setSkipReply(skipReply);
 
 	// init connect
 	Info(_log, "Connecting to Hyperion: %s:%d", _host.toStdString().c_str(), _port);
@@ -47,29 +100,17 @@ FlatBufferConnection::~FlatBufferConnection()
 {
 	_timer.stop();
 	_socket.close();
+	_localSocket.close();
 }
 
 void FlatBufferConnection::readData()
 {
-	_receiveBuffer += _socket.readAll();
+	_reader.readFrom(device());
 
-	// check if we can read a header
-	while(_receiveBuffer.size() >= 4)
+	const uint8_t* msgData;
+	uint32_t messageSize;
+	while (_reader.next(msgData, messageSize) == FramedReader::MESSAGE)
 	{
-		uint32_t messageSize =
-			((_receiveBuffer[0]<<24) & 0xFF000000) |
-			((_receiveBuffer[1]<<16) & 0x00FF0000) |
-			((_receiveBuffer[2]<< 8) & 0x0000FF00) |
-			((_receiveBuffer[3]    ) & 0x000000FF);
-
-		// check if we can read a complete message
-		if((uint32_t) _receiveBuffer.size() < messageSize + 4) return;
-
-		// extract message only and remove header + msg from buffer :: QByteArray::remove() does not return the removed data
-		const QByteArray msg = _receiveBuffer.right(messageSize);
-		_receiveBuffer.remove(0, messageSize + 4);
-
-		const uint8_t* msgData = reinterpret_cast<const uint8_t*>(msg.constData());
 		flatbuffers::Verifier verifier(msgData, messageSize);
 
 		if (hyperionnet::VerifyReplyBuffer(verifier))
@@ -84,9 +125,25 @@ void FlatBufferConnection::readData()
 void FlatBufferConnection::setSkipReply(const bool& skip)
 {
 	if(skip)
+	{
 		disconnect(&_socket, &QTcpSocket::readyRead, 0, 0);
+		disconnect(&_localSocket, &QLocalSocket::readyRead, 0, 0);
+	}
 	else
+	{
 		connect(&_socket, &QTcpSocket::readyRead, this, &FlatBufferConnection::readData, Qt::UniqueConnection);
+		connect(&_localSocket, &QLocalSocket::readyRead, this, &FlatBufferConnection::readData, Qt::UniqueConnection);
+	}
+}
+
+void FlatBufferConnection::localSocketError(QLocalSocket::LocalSocketError error)
+{
+	if (error == QLocalSocket::ServerNotFoundError || error == QLocalSocket::ConnectionRefusedError || error == QLocalSocket::SocketAccessError)
+	{
+		Info(_log, "No local socket of Hyperion (%s), connecting over TCP", QSTRING_CSTR(_localSocket.errorString()));
+		_local = false;
+		connectToHost();
+	}
 }
 
 void FlatBufferConnection::setRegister(const QString& origin, int priority)
@@ -104,10 +161,12 @@ void FlatBufferConnection::setRegister(const QString& origin, int priority)
 
 	// write message
 	int count = 0;
-	count += _socket.write(reinterpret_cast<const char *>(header), 4);
-	count += _socket.write(reinterpret_cast<const char *>(_builder.GetBufferPointer()), size);
-	_socket.flush();
+	count += device()->write(reinterpret_cast<const char *>(header), 4);
+	count += device()->write(reinterpret_cast<const char *>(_builder.GetBufferPointer()), size);
+	flushSocket();
 	_builder.Clear();
+
+	_bytesWritten += count;
 }
 
 void FlatBufferConnection::setColor(const ColorRgb & color, int priority, int duration)
@@ -121,13 +180,362 @@ void FlatBufferConnection::setColor(const ColorRgb & color, int priority, int du
 
 void FlatBufferConnection::setImage(const Image<ColorRgb> &image)
 {
-	auto imgData = _builder.CreateVector(reinterpret_cast<const uint8_t*>(image.memptr()), image.size());
-	auto rawImg = hyperionnet::CreateRawImage(_builder, imgData, image.width(), image.height());
-	auto imageReq = hyperionnet::CreateImage(_builder, hyperionnet::ImageType_RawImage, rawImg.Union(), -1);
-	auto req = hyperionnet::CreateRequest(_builder,hyperionnet::Command_Image,imageReq.Union());
+	if (_local && _sharedFrames && supportsImageType(hyperionnet::ImageType_SharedImage))
+	{
+		setSharedImage(image);
+		return;
+	}
+
+	updateBandwidth();
+
+	// latest image wins, the previous one is late already if it still waits in the socket
+	if (_lastImageSize > 0 && device()->bytesToWrite() >= _lastImageSize)
+	{
+		return;
+	}
+
+	const size_t rawSize = image.size();
+	const ImageEncoding encoding = selectEncoding(rawSize);
+
+	// a delta image is not worth the compression while the raw image fits
+	Image<ColorRgb> decoded;
+	const bool delta = encoding != ENCODING_RAW && supportsImageType(hyperionnet::ImageType_DeltaImage)
+		&& buildDeltaImage(image, encoding == ENCODING_JPEG ? JPEG_TOLERANCE : 0, decoded);
+	if (!delta)
+	{
+		decoded = buildImage(image, encoding);
+	}
+
+	const uint32_t size = _builder.GetSize();
+	if (sendMessage(_builder.GetBufferPointer(), size))
+	{
+		_referenceImage = decoded;
+		_lastImageSize = size;
+		if (!delta && rawSize > 0)
+		{
+			_sizeRatio[encoding] = 0.8 * _sizeRatio[encoding] + 0.2 * double(size) / rawSize;
+		}
+	}
+}
+
+void FlatBufferConnection::setSharedImage(const Image<ColorRgb> &image)
+{
+	const size_t size = image.size();
+	if (size == 0 || !isReady())
+	{
+		return;
+	}
+
+	// a larger image needs a new ring, the server attaches to it by its key
+	if ((!_frames.isAttached() || size > _slotSize) && !createFrameRing(size))
+	{
+		Warning(_log, "Unable to create the shared memory (%s), sending the images over the socket", QSTRING_CSTR(_frames.errorString()));
+		_sharedFrames = false;
+		return;
+	}
 
+	auto* header = static_cast<SharedFrames::Header*>(_frames.data());
+	int slot = -1;
+	for (uint32_t i = 0; i < SharedFrames::SLOT_COUNT && slot < 0; ++i)
+	{
+		uint32_t expected = SharedFrames::SLOT_FREE;
+		if (header->state[i].compare_exchange_strong(expected, SharedFrames::SLOT_WRITING, std::memory_order_acquire))
+		{
+			slot = int(i);
+		}
+	}
+
+	// latest image wins while the server is busy, a server that never frees the slots can't read the ring
+	if (slot < 0)
+	{
+		if (!_slotStall.isValid())
+		{
+			_slotStall.start();
+		}
+		else if (_slotStall.elapsed() > SLOT_STALL_TIMEOUT)
+		{
+			Warning(_log, "Hyperion doesn't release the shared images, sending them over the socket");
+			_sharedFrames = false;
+			_frames.detach();
+		}
+		return;
+	}
+	_slotStall.invalidate();
+
+	uint8_t* dest = static_cast<uint8_t*>(_frames.data()) + SharedFrames::DATA_OFFSET + slot * _slotSize;
+	memcpy(dest, image.memptr(), size);
+	header->state[slot].store(SharedFrames::SLOT_READY, std::memory_order_release);
+
+	auto sharedImg = hyperionnet::CreateSharedImage(_builder, _builder.CreateString(QSTRING_CSTR(_frames.nativeKey())), slot, image.width(), image.height());
+	auto imageReq = hyperionnet::CreateImage(_builder, hyperionnet::ImageType_SharedImage, sharedImg.Union(), -1);
+	auto req = hyperionnet::CreateRequest(_builder, hyperionnet::Command_Image, imageReq.Union());
 	_builder.Finish(req);
-	sendMessage(_builder.GetBufferPointer(), _builder.GetSize());
+
+	// a connection lost while writing already dropped the ring
+	if (!sendMessage(_builder.GetBufferPointer(), _builder.GetSize()) && _frames.isAttached())
+	{
+		header->state[slot].store(SharedFrames::SLOT_FREE, std::memory_order_release);
+	}
+}
+
+bool FlatBufferConnection::createFrameRing(size_t imageSize)
+{
+	_frames.detach();
+	_frames.setKey(QString("hyperion-frames-%1-%2").arg(QCoreApplication::applicationPid()).arg(++_frameRings));
+
+	// cache line aligned slots
+	const size_t slotSize = (imageSize + 63) & ~size_t(63);
+	if (!_frames.create(int(SharedFrames::DATA_OFFSET + SharedFrames::SLOT_COUNT * slotSize)))
+	{
+		return false;
+	}
+
+	auto* header = new (_frames.data()) SharedFrames::Header();
+	header->magic = SharedFrames::MAGIC;
+	header->slotCount = SharedFrames::SLOT_COUNT;
+	header->slotSize = uint32_t(slotSize);
+	for (auto& state : header->state)
+	{
+		state.store(SharedFrames::SLOT_FREE, std::memory_order_relaxed);
+	}
+
+	_slotSize = slotSize;
+	_slotStall.invalidate();
+	return true;
+}
+
+bool FlatBufferConnection::supportsImageType(hyperionnet::ImageType type) const
+{
+	return type == hyperionnet::ImageType_RawImage || (_imageTypes & (1u << type)) != 0;
+}
+
+void FlatBufferConnection::updateBandwidth()
+{
+	const qint64 elapsed_ms = _frameTimer.isValid() ? _frameTimer.restart() : 0;
+	if (!_frameTimer.isValid())
+	{
+		_frameTimer.start();
+	}
+
+	const qint64 pending = device()->bytesToWrite();
+	const qint64 drained = _bytesWritten - pending;
+
+	if (elapsed_ms > 0)
+	{
+		const double frameRate = 1000.0 / elapsed_ms;
+		_frameRate = _frameRate > 0 ? 0.9 * _frameRate + 0.1 * frameRate : frameRate;
+
+		const double rate = (drained - _lastDrained) * 1000.0 / elapsed_ms;
+		if (pending > 0 && _lastPending > 0)
+		{
+			// the socket was busy for the whole interval, the drained bytes measure the link
+			_bandwidth = _bandwidth > 0 ? 0.8 * _bandwidth + 0.2 * rate : rate;
+		}
+		else if (_bandwidth > 0)
+		{
+			_bandwidth = qMax(_bandwidth * BANDWIDTH_PROBE, rate);
+		}
+	}
+
+	_lastDrained = drained;
+	_lastPending = pending;
+}
+
+FlatBufferConnection::ImageEncoding FlatBufferConnection::selectEncoding(size_t rawSize) const
+{
+	// raw images until the link turns out to be the limit
+	if (_bandwidth <= 0 || _frameRate <= 0)
+	{
+		return ENCODING_RAW;
+	}
+
+	static const hyperionnet::ImageType imageTypes[ENCODING_COUNT] = {
+		hyperionnet::ImageType_RawImage, hyperionnet::ImageType_CompressedImage, hyperionnet::ImageType_JpegImage };
+
+	// the smallest supported encoding if none fits
+	const double budget = BANDWIDTH_HEADROOM * _bandwidth / _frameRate;
+	ImageEncoding selected = ENCODING_RAW;
+	for (int encoding = ENCODING_RAW; encoding < ENCODING_COUNT; ++encoding)
+	{
+		if (supportsImageType(imageTypes[encoding]))
+		{
+			selected = ImageEncoding(encoding);
+			if (rawSize * _sizeRatio[encoding] <= budget)
+			{
+				break;
+			}
+		}
+	}
+	return selected;
+}
+
+Image<ColorRgb> FlatBufferConnection::buildImage(const Image<ColorRgb> &image, ImageEncoding encoding)
+{
+	const uint8_t* pixels = reinterpret_cast<const uint8_t*>(image.memptr());
+	flatbuffers::Offset<void> imageData;
+	hyperionnet::ImageType imageType;
+	Image<ColorRgb> decoded = image;
+
+	switch (encoding)
+	{
+		case ENCODING_COMPRESSED:
+		{
+			const QByteArray compressed = qCompress(pixels, int(image.size()), 1);
+			auto data = _builder.CreateVector(reinterpret_cast<const uint8_t*>(compressed.constData()), compressed.size());
+			imageData = hyperionnet::CreateCompressedImage(_builder, data, image.width(), image.height()).Union();
+			imageType = hyperionnet::ImageType_CompressedImage;
+			break;
+		}
+		case ENCODING_JPEG:
+		{
+			QByteArray jpeg;
+			QBuffer buffer(&jpeg);
+			buffer.open(QIODevice::WriteOnly);
+			QImage(pixels, image.width(), image.height(), image.width() * 3, QImage::Format_RGB888).save(&buffer, "JPG", JPEG_QUALITY);
+
+			// the lossy image the server gets is the reference of the next delta image
+			QImage lossy = QImage::fromData(jpeg, "JPG").convertToFormat(QImage::Format_RGB888);
+			if (lossy.width() == int(image.width()) && lossy.height() == int(image.height()))
+			{
+				ColorRgb* dest = decoded.memptr();
+				for (int y = 0; y < lossy.height(); ++y)
+				{
+					memcpy(dest + y * lossy.width(), lossy.constScanLine(y), size_t(lossy.width()) * 3);
+				}
+			}
+
+			auto data = _builder.CreateVector(reinterpret_cast<const uint8_t*>(jpeg.constData()), jpeg.size());
+			imageData = hyperionnet::CreateJpegImage(_builder, data).Union();
+			imageType = hyperionnet::ImageType_JpegImage;
+			break;
+		}
+		default:
+		{
+			auto data = _builder.CreateVector(pixels, image.size());
+			imageData = hyperionnet::CreateRawImage(_builder, data, image.width(), image.height()).Union();
+			imageType = hyperionnet::ImageType_RawImage;
+			break;
+		}
+	}
+
+	auto imageReq = hyperionnet::CreateImage(_builder, imageType, imageData, -1);
+	auto req = hyperionnet::CreateRequest(_builder, hyperionnet::Command_Image, imageReq.Union());
+	_builder.Finish(req);
+
+	return decoded;
+}
+
+bool FlatBufferConnection::buildDeltaImage(const Image<ColorRgb> &image, int tolerance, Image<ColorRgb> &result)
+{
+	const int width = image.width();
+	const int height = image.height();
+	if (width == 0 || height == 0 || width != int(_referenceImage.width()) || height != int(_referenceImage.height()))
+	{
+		return false;
+	}
+
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	const size_t maxTiles = size_t(tilesX * tilesY * MAX_CHANGED_TILES);
+
+	const ColorRgb* source = image.memptr();
+	const ColorRgb* reference = _referenceImage.memptr();
+
+	_changedTiles.clear();
+	_tilePixels.clear();
+
+	for (int tile = 0; tile < tilesX * tilesY; ++tile)
+	{
+		const int x0 = (tile % tilesX) * TILE_SIZE;
+		const int y0 = (tile / tilesX) * TILE_SIZE;
+		const int tileWidth = qMin(TILE_SIZE, width - x0);
+		const int tileHeight = qMin(TILE_SIZE, height - y0);
+
+		bool changed = false;
+		for (int y = y0; y < y0 + tileHeight && !changed; ++y)
+		{
+			const uint8_t* a = reinterpret_cast<const uint8_t*>(source + y * width + x0);
+			const uint8_t* b = reinterpret_cast<const uint8_t*>(reference + y * width + x0);
+			if (tolerance == 0)
+			{
+				changed = memcmp(a, b, size_t(tileWidth) * 3) != 0;
+			}
+			else
+			{
+				for (int i = 0; i < tileWidth * 3 && !changed; ++i)
+				{
+					changed = qAbs(int(a[i]) - int(b[i])) > tolerance;
+				}
+			}
+		}
+
+		if (changed)
+		{
+			if (_changedTiles.size() == maxTiles)
+			{
+				return false;
+			}
+
+			_changedTiles.push_back(uint32_t(tile));
+			for (int y = y0; y < y0 + tileHeight; ++y)
+			{
+				const uint8_t* row = reinterpret_cast<const uint8_t*>(source + y * width + x0);
+				_tilePixels.insert(_tilePixels.end(), row, row + tileWidth * 3);
+			}
+		}
+	}
+
+	// lossless: the server gets the image itself, otherwise the reference with the changed tiles
+	result = (tolerance == 0) ? image : _referenceImage;
+	if (tolerance != 0 && !_changedTiles.empty())
+	{
+		ColorRgb* dest = result.memptr();
+		const uint8_t* pixels = _tilePixels.data();
+		for (const uint32_t tile : _changedTiles)
+		{
+			const int x0 = int(tile % tilesX) * TILE_SIZE;
+			const int y0 = int(tile / tilesX) * TILE_SIZE;
+			const int tileWidth = qMin(TILE_SIZE, width - x0);
+			const int tileHeight = qMin(TILE_SIZE, height - y0);
+			for (int y = y0; y < y0 + tileHeight; ++y)
+			{
+				memcpy(dest + y * width + x0, pixels, size_t(tileWidth) * 3);
+				pixels += tileWidth * 3;
+			}
+		}
+	}
+
+	auto tiles = _builder.CreateVector(_changedTiles);
+	flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data;
+	if (!_changedTiles.empty())
+	{
+		const QByteArray compressed = qCompress(_tilePixels.data(), int(_tilePixels.size()), 1);
+		data = _builder.CreateVector(reinterpret_cast<const uint8_t*>(compressed.constData()), compressed.size());
+	}
+	auto deltaImg = hyperionnet::CreateDeltaImage(_builder, tiles, data, width, height, TILE_SIZE);
+	auto imageReq = hyperionnet::CreateImage(_builder, hyperionnet::ImageType_DeltaImage, deltaImg.Union(), -1);
+	auto req = hyperionnet::CreateRequest(_builder, hyperionnet::Command_Image, imageReq.Union());
+	_builder.Finish(req);
+
+	return true;
+}
+
+void FlatBufferConnection::resetImageState()
+{
+	_referenceImage.clear();
+	_frameTimer.invalidate();
+	_bytesWritten = 0;
+	_lastDrained = 0;
+	_lastPending = 0;
+	_lastImageSize = 0;
+	_pendingImage.clear();
+	_bandwidth = 0;
+	_frameRate = 0;
+
+	// the ring of a previous connection may still hold slots
+	_frames.detach();
+	_slotSize = 0;
+	_slotStall.invalidate();
 }
 
 void FlatBufferConnection::clear(int priority)
@@ -147,39 +555,79 @@ void FlatBufferConnection::clearAll()
 void FlatBufferConnection::connectToHost()
 {
 	// try connection only when
-	if (_socket.state() == QAbstractSocket::UnconnectedState)
+	if (_local)
+	{
+		if (_localSocket.state() == QLocalSocket::UnconnectedState)
+			_localSocket.connectToServer(SharedFrames::localServerName(_port));
+	}
+	else if (_socket.state() == QAbstractSocket::UnconnectedState)
 	   _socket.connectToHost(_host, _port);
 }
 
-void FlatBufferConnection::sendMessage(const uint8_t* buffer, uint32_t size)
+QAbstractSocket::SocketState FlatBufferConnection::socketState() const
+{
+	// the states of the local socket have the values of the TCP socket states
+	return _local ? QAbstractSocket::SocketState(_localSocket.state()) : _socket.state();
+}
+
+QIODevice* FlatBufferConnection::device()
+{
+	return _local ? static_cast<QIODevice*>(&_localSocket) : static_cast<QIODevice*>(&_socket);
+}
+
+void FlatBufferConnection::flushSocket()
+{
+	if (_local)
+		_localSocket.flush();
+	else
+		_socket.flush();
+}
+
+bool FlatBufferConnection::isReady()
 {
 	// print out connection message only when state is changed
-	if (_socket.state() != _prevSocketState )
+	if (socketState() != _prevSocketState )
 	{
 		_registered = false;
-		switch (_socket.state() )
+		_imageTypes = 0;
+		resetImageState();
+		switch (socketState() )
 		{
 			case QAbstractSocket::UnconnectedState:
 				Info(_log, "No connection to Hyperion: %s:%d", _host.toStdString().c_str(), _port);
 				break;
 			case QAbstractSocket::ConnectedState:
-				Info(_log, "Connected to Hyperion: %s:%d", _host.toStdString().c_str(), _port);
+				Info(_log, "Connected to Hyperion: %s:%d%s", _host.toStdString().c_str(), _port, _local ? " (local socket)" : "");
 				break;
 			default:
 				Debug(_log, "Connecting to Hyperion: %s:%d", _host.toStdString().c_str(), _port);
 				break;
 	  }
-	  _prevSocketState = _socket.state();
+	  _prevSocketState = socketState();
 	}
 
 
-	if (_socket.state() != QAbstractSocket::ConnectedState)
-		return;
+	if (socketState() != QAbstractSocket::ConnectedState)
+	{
+		return false;
+	}
 
 	if(!_registered)
 	{
+		_builder.Clear();
 		setRegister(_origin, _priority);
-		return;
+		return false;
+	}
+
+	return true;
+}
+
+bool FlatBufferConnection::sendMessage(const uint8_t* buffer, uint32_t size)
+{
+	if (!isReady())
+	{
+		_builder.Clear();
+		return false;
 	}
 
 	const uint8_t header[] = {
@@ -190,10 +638,45 @@ void FlatBufferConnection::sendMessage(const uint8_t* buffer, uint32_t size)
 
 	// write message
 	int count = 0;
-	count += _socket.write(reinterpret_cast<const char *>(header), 4);
-	count += _socket.write(reinterpret_cast<const char *>(buffer), size);
-	_socket.flush();
+	count += device()->write(reinterpret_cast<const char *>(header), 4);
+	count += device()->write(reinterpret_cast<const char *>(buffer), size);
+	flushSocket();
 	_builder.Clear();
+
+	_bytesWritten += count;
+	return true;
+}
+
+bool FlatBufferConnection::sendImageMessage(const uint8_t* buffer, uint32_t size)
+{
+	// only the newest image waits, it is late already when it gets its turn
+	if (_lastImageSize > 0 && device()->bytesToWrite() >= _lastImageSize)
+	{
+		_pendingImage.resize(int(size));
+		memcpy(_pendingImage.data(), buffer, size);
+		return false;
+	}
+	_pendingImage.clear();
+
+	if (!sendMessage(buffer, size))
+	{
+		return false;
+	}
+
+	// the server didn't get an image of this connection to refer deltas to
+	_referenceImage.clear();
+	_lastImageSize = size;
+	return true;
+}
+
+void FlatBufferConnection::writePendingImage()
+{
+	if (!_pendingImage.isEmpty() && device()->bytesToWrite() < _lastImageSize)
+	{
+		QByteArray image;
+		image.swap(_pendingImage);
+		sendImageMessage(reinterpret_cast<const uint8_t*>(image.constData()), uint32_t(image.size()));
+	}
 }
 
 bool FlatBufferConnection::parseReply(const hyperionnet::Reply *reply)
@@ -213,12 +696,41 @@ bool FlatBufferConnection::parseReply(const hyperionnet::Reply *reply)
 		if (registered == -1 || registered != _priority)
 			_registered = false;
 		else
+		{
 			_registered = true;
+			_imageTypes = reply->imageTypes();
+		}
 
 		return true;
 	}
-	else
-		throw std::runtime_error(reply->error()->str());
+
+	// an error of a shared image drops the frame ring only, e.g. the server runs as another user and
+	// may not attach to it. Errors of images sent before the fallback are ignored.
+	const auto imageType = hyperionnet::ImageType(reply->imageType());
+	if (imageType == hyperionnet::ImageType_SharedImage)
+	{
+		if (_local && _sharedFrames)
+		{
+			Warning(_log, "Hyperion can't read the shared images (%s), sending them over the socket", reply->error()->c_str());
+			_sharedFrames = false;
+			_frames.detach();
+		}
+		return false;
+	}
+
+	// a server that can't use an image type gets raw images or the other types from now on
+	if (imageType != hyperionnet::ImageType_NONE && imageType != hyperionnet::ImageType_RawImage)
+	{
+		if (imageType <= hyperionnet::ImageType_MAX && supportsImageType(imageType))
+		{
+			Warning(_log, "Hyperion rejected a %s (%s), not sending this image type anymore", hyperionnet::EnumNameImageType(imageType), reply->error()->c_str());
+			_imageTypes &= ~(1u << imageType);
+			_referenceImage.clear();
+		}
+		return false;
+	}
+
+	throw std::runtime_error(reply->error()->str());
 
 	return false;
 }
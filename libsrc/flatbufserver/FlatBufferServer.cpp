@@ -1,5 +1,6 @@
 #include <flatbufserver/FlatBufferServer.h>
 #include "FlatBufferClient.h"
+#include "SharedFrames.h"
 
 // util
 #include <utils/NetOrigin.h>
@@ -9,12 +10,33 @@
 #include <QJsonObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QUdpSocket>
+#include <QNetworkInterface>
+
+namespace {
+
+/// Datagram senders served at the same time, further senders are ignored until one times out
+const int MAX_DATAGRAM_CLIENTS = 32;
+
+/// Rejected datagram senders remembered at most, the list starts over once it is full
+const int MAX_REJECTED_SENDERS = 256;
+
+/// Time until a rejected datagram sender is checked again [ms]
+const qint64 REJECTED_SENDER_TIMEOUT = 60000;
+
+}
 
 FlatBufferServer::FlatBufferServer(const QJsonDocument& config, QObject* parent)
 	: QObject(parent)
 	, _server(new QTcpServer(this))
+	, _localServer(new QLocalServer(this))
+	, _udpSocket(new QUdpSocket(this))
+	, _udp(false)
 	, _log(Logger::getInstance("FLATBUFSERVER"))
 	, _timeout(5000)
+	, _maxMessageSize(FramedReader::DEFAULT_MAX_MESSAGE_SIZE)
 	, _config(config)
 {
 
@@ -24,12 +46,16 @@ FlatBufferServer::~FlatBufferServer()
 {
 	stopServer();
 	delete _server;
+	delete _localServer;
+	delete _udpSocket;
 }
 
 void FlatBufferServer::initServer()
 {
 	_netOrigin = NetOrigin::getInstance();
 	connect(_server, &QTcpServer::newConnection, this, &FlatBufferServer::newConnection);
+	connect(_localServer, &QLocalServer::newConnection, this, &FlatBufferServer::newLocalConnection);
+	connect(_udpSocket, &QUdpSocket::readyRead, this, &FlatBufferServer::readDatagrams);
 
 	// apply config
 	handleSettingsUpdate(settings::FLATBUFSERVER, _config);
@@ -42,16 +68,28 @@ void FlatBufferServer::handleSettingsUpdate(const settings::type& type, const QJ
 		const QJsonObject& obj = config.object();
 
 		quint16 port = obj["port"].toInt(19400);
+		const bool udp = obj["udp"].toBool(false);
+		const QString multicastGroup = obj["multicastGroup"].toString("");
 
 		// port check
-		if(_server->serverPort() != port)
+		if(_server->serverPort() != port || _udp != udp || _multicastGroup != multicastGroup)
 		{
 			stopServer();
 			_port = port;
+			_udp = udp;
+			_multicastGroup = multicastGroup;
 		}
 
 		// new timeout just for new connections
 		_timeout = obj["timeout"].toInt(5000);
+
+		// the size limit applies to the open connections as well
+		_maxMessageSize = quint32(obj["maxMessageSize"].toInt(64)) * 1024 * 1024;
+		for(FlatBufferClient* client : _openConnections)
+		{
+			client->setMaxMessageSize(_maxMessageSize);
+		}
+
 		// enable check
 		obj["enable"].toBool(true) ? startServer() : stopServer();
 	}
@@ -66,16 +104,7 @@ void FlatBufferServer::newConnection()
 			if(_netOrigin->accessAllowed(socket->peerAddress(), socket->localAddress()))
 			{
 				Debug(_log, "New connection from %s", QSTRING_CSTR(socket->peerAddress().toString()));
-				FlatBufferClient *client = new FlatBufferClient(socket, _timeout, this);
-				// internal
-				connect(client, &FlatBufferClient::clientDisconnected, this, &FlatBufferServer::clientDisconnected);
-				connect(client, &FlatBufferClient::registerGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::registerGlobalInput);
-				connect(client, &FlatBufferClient::clearGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::clearGlobalInput);
-				connect(client, &FlatBufferClient::clearAllGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::clearAllGlobalInput);
-				connect(client, &FlatBufferClient::setGlobalInputImage, GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage);
-				connect(client, &FlatBufferClient::setGlobalInputColor, GlobalSignals::getInstance(), &GlobalSignals::setGlobalColor);
-				connect(GlobalSignals::getInstance(), &GlobalSignals::globalRegRequired, client, &FlatBufferClient::registationRequired);
-				_openConnections.append(client);
+				addClient(new FlatBufferClient(socket, _timeout, this));
 			}
 			else
 				socket->close();
@@ -83,11 +112,91 @@ void FlatBufferServer::newConnection()
 	}
 }
 
+void FlatBufferServer::newLocalConnection()
+{
+	while(_localServer->hasPendingConnections())
+	{
+		if(QLocalSocket* socket = _localServer->nextPendingConnection())
+		{
+			Debug(_log, "New local connection");
+			addClient(new FlatBufferClient(socket, _timeout, this));
+		}
+	}
+}
+
+void FlatBufferServer::readDatagrams()
+{
+	while(_udpSocket->hasPendingDatagrams())
+	{
+		QHostAddress address;
+		quint16 port;
+		_datagram.resize(int(qMax<qint64>(0, _udpSocket->pendingDatagramSize())));
+		const qint64 size = _udpSocket->readDatagram(_datagram.data(), _datagram.size(), &address, &port);
+		if(size <= 0)
+			continue;
+
+		const QString sender = QString("%1:%2").arg(address.toString()).arg(port);
+		FlatBufferClient* client = _datagramClients.value(sender, nullptr);
+		if(client == nullptr)
+		{
+			const auto rejected = _rejectedSenders.constFind(sender);
+			if(rejected != _rejectedSenders.constEnd() && _uptime.elapsed() - rejected.value() < REJECTED_SENDER_TIMEOUT)
+				continue;
+
+			if(_datagramClients.size() >= MAX_DATAGRAM_CLIENTS)
+				continue;
+
+			// the local address of the receiving interface isn't known, compare with all of them
+			QHostAddress local;
+			for(const QHostAddress& interfaceAddress : QNetworkInterface::allAddresses())
+			{
+				if(interfaceAddress.protocol() == address.protocol() && _netOrigin->isLocalAddress(address, interfaceAddress))
+				{
+					local = interfaceAddress;
+					break;
+				}
+			}
+
+			if(!_netOrigin->accessAllowed(address, local))
+			{
+				if(_rejectedSenders.size() >= MAX_REJECTED_SENDERS)
+					_rejectedSenders.clear();
+				_rejectedSenders.insert(sender, _uptime.elapsed());
+				continue;
+			}
+			_rejectedSenders.remove(sender);
+
+			Debug(_log, "New datagram sender %s", QSTRING_CSTR(sender));
+			client = new FlatBufferClient(sender, _timeout, this);
+			addClient(client);
+			_datagramClients.insert(sender, client);
+		}
+
+		client->handleDatagram(reinterpret_cast<const uint8_t*>(_datagram.constData()), uint32_t(size));
+	}
+}
+
+void FlatBufferServer::addClient(FlatBufferClient* client)
+{
+	client->setMaxMessageSize(_maxMessageSize);
+
+	// internal
+	connect(client, &FlatBufferClient::clientDisconnected, this, &FlatBufferServer::clientDisconnected);
+	connect(client, &FlatBufferClient::registerGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::registerGlobalInput);
+	connect(client, &FlatBufferClient::clearGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::clearGlobalInput);
+	connect(client, &FlatBufferClient::clearAllGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::clearAllGlobalInput);
+	connect(client, &FlatBufferClient::setGlobalInputImage, GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage);
+	connect(client, &FlatBufferClient::setGlobalInputColor, GlobalSignals::getInstance(), &GlobalSignals::setGlobalColor);
+	connect(GlobalSignals::getInstance(), &GlobalSignals::globalRegRequired, client, &FlatBufferClient::registationRequired);
+	_openConnections.append(client);
+}
+
 void FlatBufferServer::clientDisconnected()
 {
 	FlatBufferClient* client = qobject_cast<FlatBufferClient*>(sender());
 	client->deleteLater();
 	_openConnections.removeAll(client);
+	_datagramClients.remove(_datagramClients.key(client));
 }
 
 void FlatBufferServer::startServer()
@@ -103,18 +212,46 @@ void FlatBufferServer::startServer()
 	        Info(_log,"Started on port %d", _port);
 	    }
 	}
+
+	if(!_localServer->isListening())
+	{
+		// a stale socket file of a crashed instance would block the name
+		const QString name = SharedFrames::localServerName(_port);
+		QLocalServer::removeServer(name);
+		if(!_localServer->listen(name))
+		{
+			Warning(_log, "Failed to listen on local socket %s: %s", QSTRING_CSTR(name), QSTRING_CSTR(_localServer->errorString()));
+		}
+	}
+
+	if(_udp && _udpSocket->state() != QAbstractSocket::BoundState)
+	{
+		_rejectedSenders.clear();
+		_uptime.start();
+		if(!_udpSocket->bind(QHostAddress::AnyIPv4, _port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+		{
+			Error(_log, "Failed to bind UDP port %d", _port);
+		}
+		else if(!_multicastGroup.isEmpty() && !_udpSocket->joinMulticastGroup(QHostAddress(_multicastGroup)))
+		{
+			Warning(_log, "Failed to join multicast group %s: %s", QSTRING_CSTR(_multicastGroup), QSTRING_CSTR(_udpSocket->errorString()));
+		}
+	}
 }
 
 void FlatBufferServer::stopServer()
 {
 	if(_server->isListening())
 	{
-		// close client connections
-		for(const auto& client : _openConnections)
+		// close client connections, datagram clients leave the list while closing
+		const QVector<FlatBufferClient*> clients = _openConnections;
+		for(const auto& client : clients)
 		{
 			client->forceClose();
 		}
 		_server->close();
 		Info(_log, "Stopped");
 	}
+	_localServer->close();
+	_udpSocket->close();
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+// STL includes
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Qt includes
+#include <QString>
+
+///
+/// Shared memory frame ring of a local flatbuffer connection. The client copies an image into a
+/// free slot, marks it ready and sends a SharedImage request with the slot index over the local
+/// socket, which also wakes up the server. The server copies the image out and frees the slot.
+/// The slot states are lock-free atomics, so neither side takes a lock shared with the other process.
+///
+namespace SharedFrames
+{
+	/// Identifies an initialized frame ring
+	const uint32_t MAGIC = 0x48594652;
+
+	/// Number of slots, the client drops images while all of them are in use
+	const uint32_t SLOT_COUNT = 3;
+
+	/// Offset of the first slot, keeps the pixel data cache line aligned
+	const size_t DATA_OFFSET = 64;
+
+	enum SlotState : uint32_t
+	{
+		SLOT_FREE,
+		SLOT_WRITING,
+		SLOT_READY
+	};
+
+	/// Header at the start of the segment
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t slotCount;
+		uint32_t slotSize;
+		uint32_t reserved;
+		std::atomic<uint32_t> state[SLOT_COUNT];
+	};
+
+	static_assert(ATOMIC_INT_LOCK_FREE == 2, "the slot states must be lock-free to be shared between processes");
+	static_assert(sizeof(Header) <= DATA_OFFSET, "the header must fit in front of the slots");
+
+	///
+	/// @brief Name of the local socket of the flatbuffer server
+	/// @param port  The TCP port of the server, separates several hyperiond processes
+	/// @return The server name
+	///
+	inline QString localServerName(const quint16 port)
+	{
+		return QString("hyperion-flatbuffer-%1").arg(port);
+	}
+}
@@ -8,101 +8,262 @@
 
 // STL includes
 #include <iostream>
+#include <cstring>
+#include <cerrno>
 
 // Local includes
 #include <grabber/FramebufferFrameGrabber.h>
+#include <utils/PixelKernels.h>
+
+namespace {
+
+/// An unchanged screen is still forwarded after this time, so the capture input doesn't time out
+const qint64 KEEPALIVE_INTERVAL_MS = 1000;
+
+/// Copy every step-th pixel of a row into a packed buffer
+template <size_t BYTES_PER_PIXEL>
+void gatherPixels(const uint8_t* source, size_t step, size_t count, uint8_t* target)
+{
+	const size_t stride = step * BYTES_PER_PIXEL;
+	for (size_t i = 0; i < count; ++i, source += stride, target += BYTES_PER_PIXEL)
+	{
+		memcpy(target, source, BYTES_PER_PIXEL);
+	}
+}
+
+}
 
 FramebufferFrameGrabber::FramebufferFrameGrabber(const QString & device, const unsigned width, const unsigned height)
 	: Grabber("FRAMEBUFFERGRABBER", width, height)
-	, _fbfd(0)
-	, _fbp(0)
+	, _fbfd(-1)
+	, _fbp(nullptr)
 	, _fbDevice()
+	, _screenWidth(0)
+	, _screenHeight(0)
+	, _bitsPerPixel(0)
+	, _mapSize(0)
+	, _pixelFormat(PIXELFORMAT_NO_CHANGE)
+	, _changeDetection(false)
+	, _lastHash(0)
+	, _hashRow()
+	, _lastImage()
+	, _lastFrameTimer()
 {
 	setDevicePath(device);
 }
 
 FramebufferFrameGrabber::~FramebufferFrameGrabber()
 {
+	closeDevice();
 }
 
 int FramebufferFrameGrabber::grabFrame(Image<ColorRgb> & image)
 {
 	if (!_enabled) return 0;
 
+	if (!openDevice())
+	{
+		return -1;
+	}
+
+	/* get variable screen information, the mapping is only renewed when the geometry changes */
 	struct fb_var_screeninfo vinfo;
-	unsigned capSize, bytesPerPixel;
-	PixelFormat pixelFormat;
+	if (ioctl(_fbfd, FBIOGET_VSCREENINFO, &vinfo) != 0)
+	{
+		Error(_log, "Could not get screen information");
+		closeDevice();
+		return -1;
+	}
+
+	if (_fbp == nullptr || vinfo.xres != _screenWidth || vinfo.yres != _screenHeight || vinfo.bits_per_pixel != _bitsPerPixel)
+	{
+		if (!mapScreen(vinfo.xres, vinfo.yres, vinfo.bits_per_pixel))
+		{
+			return -1;
+		}
+	}
+
+	const int horizontalDecimation = _screenWidth/_width;
+	const int verticalDecimation = _screenHeight/_height;
+
+	if (_changeDetection)
+	{
+		// the settings are part of the hash, changing them forces a new frame
+		uint64_t seed = PixelKernels::hash64(&horizontalDecimation, sizeof(horizontalDecimation), _screenWidth);
+		const int settings[] = { _cropLeft, _cropRight, _cropTop, _cropBottom, int(_videoMode), int(_bitsPerPixel) };
+		seed = PixelKernels::hash64(settings, sizeof(settings), seed ^ _screenHeight);
+
+		const uint64_t hash = PixelKernels::hash64(&seed, sizeof(seed), screenHash(horizontalDecimation, verticalDecimation));
+		if (hash == _lastHash && _lastFrameTimer.isValid() && _lastFrameTimer.elapsed() < KEEPALIVE_INTERVAL_MS)
+		{
+			return FRAME_UNCHANGED;
+		}
+
+		_lastFrameTimer.start();
+		if (hash == _lastHash)
+		{
+			// keep-alive, share the last frame instead of resampling it again
+			image = _lastImage;
+			return 0;
+		}
+		_lastHash = hash;
+	}
+
+	_imageResampler.setHorizontalPixelDecimation(horizontalDecimation);
+	_imageResampler.setVerticalPixelDecimation(verticalDecimation);
+	_imageResampler.processImage(_fbp,
+								_screenWidth,
+								_screenHeight,
+								_screenWidth * (_bitsPerPixel / 8),
+								_pixelFormat,
+								image);
+
+	if (_changeDetection)
+	{
+		_lastImage = image;
+	}
+
+	return 0;
+}
+
+void FramebufferFrameGrabber::setChangeDetectionEnabled(bool enable)
+{
+	_changeDetection = enable;
+	_lastHash = 0;
+	_lastImage.clear();
+	_lastFrameTimer.invalidate();
+}
+
+bool FramebufferFrameGrabber::openDevice()
+{
+	if (_fbfd < 0)
+	{
+		_fbfd = open(QSTRING_CSTR(_fbDevice), O_RDONLY);
+	}
+	return _fbfd >= 0;
+}
+
+void FramebufferFrameGrabber::closeDevice()
+{
+	if (_fbp != nullptr)
+	{
+		munmap(_fbp, _mapSize);
+		_fbp = nullptr;
+		_mapSize = 0;
+	}
 
-	/* Open the framebuffer device */
-	_fbfd = open(QSTRING_CSTR(_fbDevice), O_RDONLY);
+	if (_fbfd >= 0)
+	{
+		close(_fbfd);
+		_fbfd = -1;
+	}
 
-	/* get variable screen information */
-	ioctl (_fbfd, FBIOGET_VSCREENINFO, &vinfo);
+	_screenWidth = _screenHeight = _bitsPerPixel = 0;
+}
 
-	bytesPerPixel = vinfo.bits_per_pixel / 8;
-	capSize = vinfo.xres * vinfo.yres * bytesPerPixel;
+bool FramebufferFrameGrabber::mapScreen(unsigned xres, unsigned yres, unsigned bitsPerPixel)
+{
+	if (_fbp != nullptr)
+	{
+		munmap(_fbp, _mapSize);
+		_fbp = nullptr;
+		_mapSize = 0;
+	}
 
-	switch (vinfo.bits_per_pixel)
+	switch (bitsPerPixel)
 	{
-		case 16: pixelFormat = PIXELFORMAT_BGR16; break;
-		case 24: pixelFormat = PIXELFORMAT_BGR24; break;
+		case 16: _pixelFormat = PIXELFORMAT_BGR16; break;
+		case 24: _pixelFormat = PIXELFORMAT_BGR24; break;
 #ifdef ENABLE_AMLOGIC
-		case 32: pixelFormat = PIXELFORMAT_RGB32; break;
+		case 32: _pixelFormat = PIXELFORMAT_RGB32; break;
 #else
-		case 32: pixelFormat = PIXELFORMAT_BGR32; break;
+		case 32: _pixelFormat = PIXELFORMAT_BGR32; break;
 #endif
 		default:
-			Error(_log, "Unknown pixel format: %d bits per pixel", vinfo.bits_per_pixel);
-			close(_fbfd);
-			return -1;
+			Error(_log, "Unknown pixel format: %d bits per pixel", bitsPerPixel);
+			closeDevice();
+			return false;
 	}
 
 	/* map the device to memory */
-	_fbp = (unsigned char*)mmap(0, capSize, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, _fbfd, 0);
+	const size_t capSize = size_t(xres) * yres * (bitsPerPixel / 8);
+	void* fbp = mmap(0, capSize, PROT_READ, MAP_SHARED, _fbfd, 0);
+	if (fbp == MAP_FAILED)
+	{
+		Error(_log, "Could not map the framebuffer (%s)", strerror(errno));
+		closeDevice();
+		return false;
+	}
 
-	_imageResampler.setHorizontalPixelDecimation(vinfo.xres/_width);
-	_imageResampler.setVerticalPixelDecimation(vinfo.yres/_height);
-	_imageResampler.processImage(_fbp,
-								vinfo.xres,
-								vinfo.yres,
-								vinfo.xres * bytesPerPixel,
-								pixelFormat,
-								image);
+	_fbp = static_cast<unsigned char*>(fbp);
+	_mapSize = capSize;
+	_screenWidth = xres;
+	_screenHeight = yres;
+	_bitsPerPixel = bitsPerPixel;
+	_lastHash = 0;
 
-	munmap(_fbp, capSize);
-	close(_fbfd);
+	Debug(_log, "Framebuffer mapped with resolution: %dx%d@%dbit", xres, yres, bitsPerPixel);
+	return true;
+}
 
-	return 0;
+uint64_t FramebufferFrameGrabber::screenHash(int horizontalDecimation, int verticalDecimation)
+{
+	// only the pixels sampled by the resampler affect the output image, the 3D modes sample a subset
+	const size_t bytesPerPixel = _bitsPerPixel / 8;
+	const size_t lineLength = size_t(_screenWidth) * bytesPerPixel;
+	const int stepX = qMax(1, horizontalDecimation);
+	const int stepY = qMax(1, verticalDecimation);
+	const int xStart = _cropLeft + (stepX >> 1);
+	const int xEnd = int(_screenWidth) - _cropRight;
+	if (xStart >= xEnd)
+	{
+		return 0;
+	}
+
+	const size_t columns = size_t(xEnd - xStart + stepX - 1) / stepX;
+	_hashRow.resize(columns * bytesPerPixel);
+
+	uint64_t hash = 0;
+	for (int y = _cropTop + (stepY >> 1); y < int(_screenHeight) - _cropBottom; y += stepY)
+	{
+		const uint8_t* row = _fbp + y * lineLength + xStart * bytesPerPixel;
+		switch (bytesPerPixel)
+		{
+			case 2:  gatherPixels<2>(row, stepX, columns, _hashRow.data()); break;
+			case 3:  gatherPixels<3>(row, stepX, columns, _hashRow.data()); break;
+			default: gatherPixels<4>(row, stepX, columns, _hashRow.data()); break;
+		}
+		hash = PixelKernels::hash64(_hashRow.data(), _hashRow.size(), hash);
+	}
+	return hash;
 }
 
 void FramebufferFrameGrabber::setDevicePath(const QString& path)
 {
 	if(_fbDevice != path)
 	{
+		closeDevice();
+
 		_fbDevice = path;
 		int result;
 		struct fb_var_screeninfo vinfo;
 
 		// Check if the framebuffer device can be opened and display the current resolution
-		_fbfd = open(QSTRING_CSTR(_fbDevice), O_RDONLY);
-		if (_fbfd == 0)
+		if (!openDevice())
 		{
 			Error(_log, "Error openning %s", QSTRING_CSTR(_fbDevice));
+			return;
+		}
+
+		// get variable screen information
+		result = ioctl (_fbfd, FBIOGET_VSCREENINFO, &vinfo);
+		if (result != 0)
+		{
+			Error(_log, "Could not get screen information");
 		}
 		else
 		{
-			// get variable screen information
-			result = ioctl (_fbfd, FBIOGET_VSCREENINFO, &vinfo);
-			if (result != 0)
-			{
-				Error(_log, "Could not get screen information");
-			}
-			else
-			{
-				Info(_log, "Display opened with resolution: %dx%d@%dbit", vinfo.xres, vinfo.yres, vinfo.bits_per_pixel);
-			}
-			close(_fbfd);
+			Info(_log, "Display opened with resolution: %dx%d@%dbit", vinfo.xres, vinfo.yres, vinfo.bits_per_pixel);
 		}
-
 	}
 }
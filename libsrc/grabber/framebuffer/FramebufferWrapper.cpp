@@ -3,7 +3,10 @@
 FramebufferWrapper::FramebufferWrapper(const QString & device, const unsigned grabWidth, const unsigned grabHeight, const unsigned updateRate_Hz)
 	: GrabberWrapper("FrameBuffer", &_grabber, grabWidth, grabHeight, updateRate_Hz)
 	, _grabber(device, grabWidth, grabHeight)
-{}
+{
+	// unchanged screens don't need to pass the pipeline again
+	_grabber.setChangeDetectionEnabled(true);
+}
 
 void FramebufferWrapper::action()
 {
@@ -0,0 +1,142 @@
+#ifdef HAVE_JPEG
+
+#include "MjpegDecoder.h"
+
+#include <cstring>
+
+#include <QtGlobal>
+
+MjpegDecoder::MjpegDecoder()
+	: _decompress()
+	, _error()
+	, _scanline()
+	, _columns()
+{
+	_decompress.err = jpeg_std_error(&_error.pub);
+	_error.pub.error_exit = &errorHandler;
+	_error.pub.output_message = &outputHandler;
+
+	jpeg_create_decompress(&_decompress);
+}
+
+MjpegDecoder::~MjpegDecoder()
+{
+	jpeg_destroy_decompress(&_decompress);
+}
+
+void MjpegDecoder::errorHandler(j_common_ptr cInfo)
+{
+	ErrorManager* mgr = reinterpret_cast<ErrorManager*>(cInfo->err);
+	longjmp(mgr->setjmp_buffer, 1);
+}
+
+void MjpegDecoder::outputHandler(j_common_ptr cInfo)
+{
+	// Suppress fprintf warnings.
+}
+
+bool MjpegDecoder::decode(const uint8_t* data, size_t size, int cropLeft, int cropRight, int cropTop, int cropBottom, int pixelDecimation, Image<ColorRgb>& image)
+{
+	if (setjmp(_error.setjmp_buffer))
+	{
+		// resets the context for the next frame
+		jpeg_abort_decompress(&_decompress);
+		return false;
+	}
+
+	_error.pub.num_warnings = 0;
+	jpeg_mem_src(&_decompress, const_cast<uint8_t*>(data), size);
+
+	if (jpeg_read_header(&_decompress, TRUE) != JPEG_HEADER_OK)
+	{
+		jpeg_abort_decompress(&_decompress);
+		return false;
+	}
+
+	const int decimation   = qMax(1, pixelDecimation);
+	const int outputWidth  = (int(_decompress.image_width)  - cropLeft - cropRight)  / decimation;
+	const int outputHeight = (int(_decompress.image_height) - cropTop  - cropBottom) / decimation;
+	if (outputWidth <= 0 || outputHeight <= 0)
+	{
+		jpeg_abort_decompress(&_decompress);
+		return false;
+	}
+
+	// let the IDCT decimate by the largest supported power of two
+	int scale = 1;
+	while (scale < 8 && scale * 2 <= decimation)
+	{
+		scale *= 2;
+	}
+
+	_decompress.scale_num = 1;
+	_decompress.scale_denom = scale;
+	_decompress.out_color_space = JCS_RGB;
+	_decompress.dct_method = JDCT_IFAST;
+	_decompress.do_fancy_upsampling = FALSE;
+
+	if (!jpeg_start_decompress(&_decompress) || _decompress.out_color_components != 3)
+	{
+		jpeg_abort_decompress(&_decompress);
+		return false;
+	}
+
+	const int scaledWidth = int(_decompress.output_width);
+
+	// the remaining decimation samples the center of each block of the scaled image
+	_columns.resize(outputWidth);
+	for (int x = 0; x < outputWidth; ++x)
+	{
+		_columns[x] = (cropLeft + x * decimation + (decimation >> 1)) / scale;
+	}
+
+	// undecimated and uncropped rows are decoded straight into the output image
+	const bool direct = (decimation == scale && cropLeft == 0 && outputWidth == scaledWidth);
+
+	_scanline.resize(size_t(scaledWidth) * 3);
+	image.resize(outputWidth, outputHeight);
+	ColorRgb* output = image.memptr();
+
+	JDIMENSION nextRow = JDIMENSION((cropTop + (decimation >> 1)) / scale);
+
+#ifdef LIBJPEG_TURBO_VERSION_NUMBER
+	// skip the cropped rows at the top without color conversion
+	if (nextRow > 0)
+	{
+		jpeg_skip_scanlines(&_decompress, nextRow);
+	}
+#endif
+
+	for (int y = 0; y < outputHeight; )
+	{
+		const JDIMENSION line = _decompress.output_scanline;
+		JSAMPROW row = (direct && line == nextRow) ? reinterpret_cast<JSAMPROW>(output + y * outputWidth) : _scanline.data();
+		jpeg_read_scanlines(&_decompress, &row, 1);
+
+		if (line != nextRow)
+		{
+			continue;
+		}
+
+		if (!direct)
+		{
+			ColorRgb* dest = output + y * outputWidth;
+			for (int x = 0; x < outputWidth; ++x)
+			{
+				memcpy(dest + x, _scanline.data() + 3 * _columns[x], 3);
+			}
+		}
+
+		++y;
+		nextRow = JDIMENSION((cropTop + y * decimation + (decimation >> 1)) / scale);
+	}
+
+	const bool corrupted = _error.pub.num_warnings > 0;
+
+	// the rows below the last sampled row are not needed
+	jpeg_abort_decompress(&_decompress);
+
+	return !corrupted;
+}
+
+#endif
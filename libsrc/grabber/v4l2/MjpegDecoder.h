@@ -0,0 +1,65 @@
+#pragma once
+
+#ifdef HAVE_JPEG
+
+// STL includes
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <csetjmp>
+
+// libjpeg includes
+#include <jpeglib.h>
+
+// hyperion includes
+#include <utils/ColorRgb.h>
+#include <utils/Image.h>
+
+///
+/// Decoder for the MJPEG frames of a V4L2 device. The libjpeg context and the scanline buffers
+/// are kept between frames. Pixel decimation is done in the DCT domain (scale_num/scale_denom)
+/// as far as possible and the remaining decimation and the cropping are applied while the
+/// scanlines are copied into the output image.
+///
+class MjpegDecoder
+{
+public:
+	MjpegDecoder();
+	~MjpegDecoder();
+
+	///
+	/// @brief Decode a frame into the given image
+	/// @param[in]  data             The jpeg data
+	/// @param[in]  size             The size of the jpeg data in bytes
+	/// @param[in]  cropLeft         Pixels to crop at the left (source resolution)
+	/// @param[in]  cropRight        Pixels to crop at the right (source resolution)
+	/// @param[in]  cropTop          Pixels to crop at the top (source resolution)
+	/// @param[in]  cropBottom       Pixels to crop at the bottom (source resolution)
+	/// @param[in]  pixelDecimation  Decimation of the output in both directions
+	/// @param[out] image            The decoded image, resized to the cropped and decimated size
+	/// @return True on success, false on a corrupted frame
+	///
+	bool decode(const uint8_t* data, size_t size, int cropLeft, int cropRight, int cropTop, int cropBottom, int pixelDecimation, Image<ColorRgb>& image);
+
+private:
+	struct ErrorManager
+	{
+		jpeg_error_mgr pub;
+		jmp_buf setjmp_buffer;
+	};
+
+	static void errorHandler(j_common_ptr cInfo);
+	static void outputHandler(j_common_ptr cInfo);
+
+	/// The persistent libjpeg context
+	jpeg_decompress_struct _decompress;
+	ErrorManager _error;
+
+	/// Scanline buffer for rows that can't be written directly into the output image
+	std::vector<uint8_t> _scanline;
+
+	/// The scaled source column of each output column
+	std::vector<int> _columns;
+};
+
+#endif
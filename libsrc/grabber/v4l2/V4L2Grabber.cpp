@@ -2,7 +2,6 @@
 #include <sstream>
 #include <stdexcept>
 #include <cstdio>
-#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
@@ -14,24 +13,78 @@
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <linux/videodev2.h>
 
+#include <functional>
+#include <chrono>
+
 #include <hyperion/Hyperion.h>
 #include <hyperion/HyperionIManager.h>
 
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QMutexLocker>
 
 #include "grabber/V4L2Grabber.h"
 
+#ifdef HAVE_JPEG
+	#include "MjpegDecoder.h"
+#endif
+
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
 
+namespace {
+
+/// Wait time of the pipeline threads, bounds the reaction time on stop()
+const int POLL_TIMEOUT_MS = 100;
+
+/// Interval of the capture statistics
+const qint64 STATISTICS_INTERVAL_MS = 10000;
+
+/// Output images in the ring, enough for the frames still queued towards the consumers
+const int OUTPUT_IMAGE_COUNT = 3;
+
+/// Monotonic time for the buffer latency [us]
+inline qint64 monotonicUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///
+/// Thread running a single loop function
+///
+class LoopThread : public QThread
+{
+public:
+	LoopThread(const std::function<void()>& loop)
+		: _loop(loop)
+	{
+	}
+
+protected:
+	void run() override
+	{
+		_loop();
+	}
+
+private:
+	const std::function<void()> _loop;
+};
+
+} // anonymous namespace
+
 V4L2Grabber::V4L2Grabber(const QString & device
 		, VideoStandard videoStandard
 		, PixelFormat pixelFormat
 		, int pixelDecimation
 		)
 	: Grabber("V4L2:"+device)
+#ifdef HAVE_JPEG
+	, _mjpegDecoder(new MjpegDecoder())
+#endif
 	, _deviceName()
 	, _input(-1)
 	, _videoStandard(videoStandard)
@@ -51,7 +104,20 @@ V4L2Grabber::V4L2Grabber(const QString & device
 	, _y_frac_min(0.25)
 	, _x_frac_max(0.75)
 	, _y_frac_max(0.75)
-	, _streamNotifier(nullptr)
+	, _captureThread(nullptr)
+	, _decodeThread(nullptr)
+	, _capturing(false)
+	, _handoff()
+	, _buffersInUse(0)
+	, _capturedFrames(0)
+	, _droppedFrames(0)
+	, _requeueCount(0)
+	, _requeueLatencySum(0)
+	, _requeueLatencyMax(0)
+	, _settingsMutex()
+	, _frameResampler()
+	, _outputImages(OUTPUT_IMAGE_COUNT)
+	, _nextOutputImage(0)
 	, _initialized(false)
 	, _deviceAutoDiscoverEnabled(false)
 {
@@ -69,6 +135,10 @@ V4L2Grabber::V4L2Grabber(const QString & device
 V4L2Grabber::~V4L2Grabber()
 {
 	uninit();
+
+#ifdef HAVE_JPEG
+	delete _mjpegDecoder;
+#endif
 }
 
 void V4L2Grabber::uninit()
@@ -186,6 +256,7 @@ void V4L2Grabber::getV4Ldevices()
 
 void V4L2Grabber::setSignalThreshold(double redSignalThreshold, double greenSignalThreshold, double blueSignalThreshold, int noSignalCounterThreshold)
 {
+	QMutexLocker lock(&_settingsMutex);
 	_noSignalThresholdColor.red   = uint8_t(255*redSignalThreshold);
 	_noSignalThresholdColor.green = uint8_t(255*greenSignalThreshold);
 	_noSignalThresholdColor.blue  = uint8_t(255*blueSignalThreshold);
@@ -199,6 +270,7 @@ void V4L2Grabber::setSignalDetectionOffset(double horizontalMin, double vertical
 	// rainbow 16 stripes 0.47 0.2 0.49 0.8
 	// unicolor: 0.25 0.25 0.75 0.75
 
+	QMutexLocker lock(&_settingsMutex);
 	_x_frac_min = horizontalMin;
 	_y_frac_min = verticalMin;
 	_x_frac_max = horizontalMax;
@@ -211,10 +283,24 @@ bool V4L2Grabber::start()
 {
 	try
 	{
-		if (init() && _streamNotifier != nullptr && !_streamNotifier->isEnabled())
+		if (init() && !_capturing)
 		{
-			_streamNotifier->setEnabled(true);
 			start_capturing();
+
+			_handoff.reset();
+			_buffersInUse = 0;
+			_capturedFrames = 0;
+			_droppedFrames = 0;
+			_requeueCount = 0;
+			_requeueLatencySum = 0;
+			_requeueLatencyMax = 0;
+			_capturing = true;
+
+			_decodeThread = new LoopThread(std::bind(&V4L2Grabber::decodeLoop, this));
+			_captureThread = new LoopThread(std::bind(&V4L2Grabber::captureLoop, this));
+			_decodeThread->start(QThread::HighPriority);
+			_captureThread->start(QThread::TimeCriticalPriority);
+
 			Info(_log, "Started");
 			return true;
 		}
@@ -229,10 +315,17 @@ bool V4L2Grabber::start()
 
 void V4L2Grabber::stop()
 {
-	if (_streamNotifier != nullptr && _streamNotifier->isEnabled())
+	if (_capturing)
 	{
+		_capturing = false;
+		_captureThread->wait();
+		_decodeThread->wait();
+		delete _captureThread;
+		delete _decodeThread;
+		_captureThread = nullptr;
+		_decodeThread = nullptr;
+
 		stop_capturing();
-		_streamNotifier->setEnabled(false);
 		uninit_device();
 		close_device();
 		_initialized = false;
@@ -264,10 +357,6 @@ bool V4L2Grabber::open_device()
 		return false;
 	}
 
-	// create the notifier for when a new frame is available
-	_streamNotifier = new QSocketNotifier(_fileDescriptor, QSocketNotifier::Read);
-	_streamNotifier->setEnabled(false);
-	connect(_streamNotifier, SIGNAL(activated(int)), this, SLOT(read_frame()));
 	return true;
 }
 
@@ -280,12 +369,6 @@ void V4L2Grabber::close_device()
 	}
 
 	_fileDescriptor = -1;
-
-	if (_streamNotifier != nullptr)
-	{
-		delete _streamNotifier;
-		_streamNotifier = nullptr;
-	}
 }
 
 void V4L2Grabber::init_read(unsigned int buffer_size)
@@ -364,6 +447,8 @@ void V4L2Grabber::init_mmap()
 			return;
 		}
 	}
+
+	Debug(_log, "Using %d mmap buffers", int(_buffers.size()));
 }
 
 void V4L2Grabber::init_userp(unsigned int buffer_size)
@@ -394,8 +479,12 @@ void V4L2Grabber::init_userp(unsigned int buffer_size)
 
 	for (size_t n_buffers = 0; n_buffers < 4; ++n_buffers)
 	{
+		// page aligned, drivers may reject or bounce unaligned user pointers
 		_buffers[n_buffers].length = buffer_size;
-		_buffers[n_buffers].start = malloc(buffer_size);
+		if (0 != posix_memalign(&_buffers[n_buffers].start, sysconf(_SC_PAGESIZE), buffer_size))
+		{
+			_buffers[n_buffers].start = nullptr;
+		}
 
 		if (!_buffers[n_buffers].start)
 		{
@@ -843,109 +932,191 @@ void V4L2Grabber::stop_capturing()
 	}
 }
 
-int V4L2Grabber::read_frame()
+void V4L2Grabber::captureLoop()
 {
-	bool rc = false;
+	pollfd fds;
+	CLEAR(fds);
+	fds.fd = _fileDescriptor;
+	fds.events = POLLIN;
 
-	try
+	while (_capturing)
 	{
-		struct v4l2_buffer buf;
+		const int ready = poll(&fds, 1, POLL_TIMEOUT_MS);
+		if (ready == -1 && errno != EINTR)
+		{
+			throw_errno_exception("poll");
+			emit readError("poll");
+			return;
+		}
 
-		switch (_ioMethod)
+		if (ready <= 0)
+			continue;
+
+		// read() i/o has a single buffer, the frame is converted on this thread
+		if (_ioMethod == IO_METHOD_READ)
 		{
-			case IO_METHOD_READ:
-			{
-				int size;
-				if ((size = read(_fileDescriptor, _buffers[0].start, _buffers[0].length)) == -1)
-				{
-					switch (errno)
-					{
-						case EAGAIN:
-							return 0;
-
-						case EIO: /* Could ignore EIO, see spec. */
-						default:
-							throw_errno_exception("read");
-						return 0;
-					}
-				}
+			read_frame();
+			continue;
+		}
 
-				rc = process_image(_buffers[0].start, size);
-			}
-			break;
+		const int index = dequeue_buffer();
+		if (index == -2)
+		{
+			emit readError("VIDIOC_DQBUF");
+			return;
+		}
 
-			case IO_METHOD_MMAP:
-			{
-				CLEAR(buf);
+		if (index < 0)
+			continue;
 
-				buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				buf.memory = V4L2_MEMORY_MMAP;
+		++_buffersInUse;
+		++_capturedFrames;
 
-				if (-1 == xioctl(VIDIOC_DQBUF, &buf))
-				{
-					switch (errno)
-					{
-						case EAGAIN:
-							return 0;
-
-						case EIO: /* Could ignore EIO, see spec. */
-						default:
-							throw_errno_exception("VIDIOC_DQBUF");
-						return 0;
-					}
-				}
+		// latest frame wins, a frame the decoder didn't pick up in time goes back to the device
+		const int dropped = _handoff.publish(index);
+		if (dropped != FrameHandoff::NO_FRAME)
+		{
+			++_droppedFrames;
+			queue_buffer(dropped);
+		}
+	}
+}
+
+void V4L2Grabber::decodeLoop()
+{
+	QElapsedTimer statisticsTimer;
+	statisticsTimer.start();
+
+	while (_capturing)
+	{
+		const int index = _handoff.take(POLL_TIMEOUT_MS);
+		if (index != FrameHandoff::NO_FRAME)
+		{
+			process_image(_buffers[index].start, int(_buffers[index].bytesused));
+			queue_buffer(index);
+		}
 
-				assert(buf.index < _buffers.size());
+		if (statisticsTimer.elapsed() >= STATISTICS_INTERVAL_MS)
+		{
+			statisticsTimer.restart();
 
-				rc = process_image(_buffers[buf.index].start, buf.bytesused);
+			const quint64 captured = _capturedFrames.exchange(0);
+			const quint64 dropped = _droppedFrames.exchange(0);
+			const int queueDepth = _buffersInUse;
+			const quint64 requeued = _requeueCount.exchange(0);
+			const int requeueAvg = requeued > 0 ? int(_requeueLatencySum.exchange(0) / requeued) : 0;
+			const int requeueMax = int(_requeueLatencyMax.exchange(0));
 
-				if (-1 == xioctl(VIDIOC_QBUF, &buf))
-				{
-					throw_errno_exception("VIDIOC_QBUF");
-					return 0;
-				}
-			}
-			break;
+			Debug(_log, "Captured %llu frames, dropped %llu, %d of %d buffers in use, requeue latency avg %d us max %d us",
+				  captured, dropped, queueDepth, int(_buffers.size()), requeueAvg, requeueMax);
+		}
+	}
+}
+
+int V4L2Grabber::dequeue_buffer()
+{
+	struct v4l2_buffer buf;
+
+	CLEAR(buf);
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = (_ioMethod == IO_METHOD_MMAP) ? V4L2_MEMORY_MMAP : V4L2_MEMORY_USERPTR;
 
-			case IO_METHOD_USERPTR:
+	if (-1 == xioctl(VIDIOC_DQBUF, &buf))
+	{
+		switch (errno)
+		{
+			case EAGAIN:
+				return -1;
+
+			case EIO: /* Could ignore EIO, see spec. */
+			default:
+				throw_errno_exception("VIDIOC_DQBUF");
+			return -2;
+		}
+	}
+
+	size_t index = buf.index;
+	if (_ioMethod == IO_METHOD_USERPTR)
+	{
+		for (index = 0; index < _buffers.size(); ++index)
+		{
+			if (buf.m.userptr == (unsigned long)_buffers[index].start && buf.length == _buffers[index].length)
 			{
-				CLEAR(buf);
+				break;
+			}
+		}
+	}
 
-				buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				buf.memory = V4L2_MEMORY_USERPTR;
+	if (index >= _buffers.size())
+	{
+		// not one of ours, hand it back to the driver and skip the frame
+		Error(_log, "VIDIOC_DQBUF returned an unknown buffer (index %u)", buf.index);
+		return (-1 == xioctl(VIDIOC_QBUF, &buf)) ? -2 : -1;
+	}
 
-				if (-1 == xioctl(VIDIOC_DQBUF, &buf))
-				{
-					switch (errno)
-					{
-						case EAGAIN:
-							return 0;
-
-						case EIO: /* Could ignore EIO, see spec. */
-						default:
-							throw_errno_exception("VIDIOC_DQBUF");
-						return 0;
-					}
-				}
+	_buffers[index].bytesused = buf.bytesused;
+	_buffers[index].dequeuedAt = monotonicUs();
+	return int(index);
+}
 
-				for (size_t i = 0; i < _buffers.size(); ++i)
-				{
-					if (buf.m.userptr == (unsigned long)_buffers[i].start && buf.length == _buffers[i].length)
-					{
-						break;
-					}
-				}
+void V4L2Grabber::queue_buffer(int index)
+{
+	struct v4l2_buffer buf;
 
-				rc = process_image((void *)buf.m.userptr, buf.bytesused);
+	CLEAR(buf);
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.index = index;
 
-				if (-1 == xioctl(VIDIOC_QBUF, &buf))
-				{
-					throw_errno_exception("VIDIOC_QBUF");
+	if (_ioMethod == IO_METHOD_MMAP)
+	{
+		buf.memory = V4L2_MEMORY_MMAP;
+	}
+	else
+	{
+		buf.memory = V4L2_MEMORY_USERPTR;
+		buf.m.userptr = (unsigned long)_buffers[index].start;
+		buf.length = _buffers[index].length;
+	}
+
+	// time the buffer was away from the device
+	const qint64 latency = monotonicUs() - _buffers[index].dequeuedAt;
+	++_requeueCount;
+	_requeueLatencySum += quint64(latency);
+	qint64 latencyMax = _requeueLatencyMax;
+	while (latency > latencyMax && !_requeueLatencyMax.compare_exchange_weak(latencyMax, latency))
+	{
+	}
+
+	--_buffersInUse;
+
+	if (-1 == xioctl(VIDIOC_QBUF, &buf))
+	{
+		throw_errno_exception("VIDIOC_QBUF");
+	}
+}
+
+int V4L2Grabber::read_frame()
+{
+	bool rc = false;
+
+	try
+	{
+		int size;
+		if ((size = read(_fileDescriptor, _buffers[0].start, _buffers[0].length)) == -1)
+		{
+			switch (errno)
+			{
+				case EAGAIN:
 					return 0;
-				}
+
+				case EIO: /* Could ignore EIO, see spec. */
+				default:
+					throw_errno_exception("read");
+				return 0;
 			}
-			break;
 		}
+
+		rc = process_image(_buffers[0].start, size);
 	}
 	catch (std::exception& e)
 	{
@@ -978,121 +1149,66 @@ bool V4L2Grabber::process_image(const void *p, int size)
 
 void V4L2Grabber::process_image(const uint8_t * data, int size)
 {
-	Image<ColorRgb> image(_width, _height);
+	// convert into the next image of the ring, resized by the decoder/resampler to the cropped and
+	// decimated size. Its buffer is reused in place unless a consumer still holds the previous frame,
+	// then resize() takes a recycled buffer of the FramePool instead of copying the held one.
+	Image<ColorRgb> & image = _outputImages[_nextOutputImage];
+	_nextOutputImage = (_nextOutputImage + 1) % _outputImages.size();
+
+	// the settings are changed from the settings thread, the frame is converted with a consistent copy
+	int cropLeft, cropRight, cropTop, cropBottom, pixelDecimation;
+	bool signalDetectionEnabled;
+	ColorRgb noSignalThresholdColor;
+	int noSignalCounterThreshold;
+	double xFracMin, yFracMin, xFracMax, yFracMax;
+	{
+		QMutexLocker lock(&_settingsMutex);
+		_frameResampler = _imageResampler;
+		cropLeft = _cropLeft;
+		cropRight = _cropRight;
+		cropTop = _cropTop;
+		cropBottom = _cropBottom;
+		pixelDecimation = _pixelDecimation;
+		signalDetectionEnabled = _signalDetectionEnabled;
+		noSignalThresholdColor = _noSignalThresholdColor;
+		noSignalCounterThreshold = _noSignalCounterThreshold;
+		xFracMin = _x_frac_min;
+		yFracMin = _y_frac_min;
+		xFracMax = _x_frac_max;
+		yFracMax = _y_frac_max;
+	}
 
 #ifdef HAVE_JPEG
 	if (_pixelFormat == PIXELFORMAT_MJPEG)
 	{
-		_decompress = new jpeg_decompress_struct;
-		_error = new errorManager;
-
-		_decompress->err = jpeg_std_error(&_error->pub);
-		_error->pub.error_exit = &errorHandler;
-		_error->pub.output_message = &outputHandler;
-
-		jpeg_create_decompress(_decompress);
-
-		if (setjmp(_error->setjmp_buffer))
-		{
-			jpeg_abort_decompress(_decompress);
-			jpeg_destroy_decompress(_decompress);
-			delete _decompress;
-			delete _error;
-			return;
-		}
-
-		jpeg_mem_src(_decompress, const_cast<uint8_t*>(data), size);
-
-		if (jpeg_read_header(_decompress, (bool) TRUE) != JPEG_HEADER_OK)
-		{
-			jpeg_abort_decompress(_decompress);
-			jpeg_destroy_decompress(_decompress);
-			delete _decompress;
-			delete _error;
+		if (!_mjpegDecoder->decode(data, size, cropLeft, cropRight, cropTop, cropBottom, pixelDecimation, image))
 			return;
-		}
-
-		_decompress->scale_num = 1;
-		_decompress->scale_denom = 1;
-		_decompress->out_color_space = JCS_RGB;
-		_decompress->dct_method = JDCT_IFAST;
-
-		if (!jpeg_start_decompress(_decompress))
-		{
-			jpeg_abort_decompress(_decompress);
-			jpeg_destroy_decompress(_decompress);
-			delete _decompress;
-			delete _error;
-			return;
-		}
-
-		if (_decompress->out_color_components != 3)
-		{
-			jpeg_abort_decompress(_decompress);
-			jpeg_destroy_decompress(_decompress);
-			delete _decompress;
-			delete _error;
-			return;
-		}
-
-		QImage imageFrame = QImage(_decompress->output_width, _decompress->output_height, QImage::Format_RGB888);
-
-		int y = 0;
-		while (_decompress->output_scanline < _decompress->output_height)
-		{
-			uchar *row = imageFrame.scanLine(_decompress->output_scanline);
-			jpeg_read_scanlines(_decompress, &row, 1);
-			y++;
-		}
-
-		jpeg_finish_decompress(_decompress);
-		jpeg_destroy_decompress(_decompress);
-		delete _decompress;
-		delete _error;
-
-		if (imageFrame.isNull() || _error->pub.num_warnings > 0)
-			return;
-
-		QRect rect(_cropLeft, _cropTop, imageFrame.width() - _cropLeft - _cropRight, imageFrame.height() - _cropTop - _cropBottom);
-		imageFrame = imageFrame.copy(rect);
-		imageFrame = imageFrame.scaled(imageFrame.width() / _pixelDecimation, imageFrame.height() / _pixelDecimation,Qt::KeepAspectRatio);
-
-		if ((image.width() != unsigned(imageFrame.width())) || (image.height() != unsigned(imageFrame.height())))
-			image.resize(imageFrame.width(), imageFrame.height());
-
-		for (int y=0; y<imageFrame.height(); ++y)
-			for (int x=0; x<imageFrame.width(); ++x)
-			{
-				QColor inPixel(imageFrame.pixel(x,y));
-				ColorRgb & outPixel = image(x,y);
-				outPixel.red   = inPixel.red();
-				outPixel.green = inPixel.green();
-				outPixel.blue  = inPixel.blue();
-			}
 	}
 	else
 #endif
-		_imageResampler.processImage(data, _width, _height, _lineLength, _pixelFormat, image);
+		_frameResampler.processImage(data, _width, _height, _lineLength, _pixelFormat, image);
 
-	if (_signalDetectionEnabled)
+	if (signalDetectionEnabled)
 	{
 		// check signal (only in center of the resulting image, because some grabbers have noise values along the borders)
 		bool noSignal = true;
 
 		// top left
-		unsigned xOffset  = image.width()  * _x_frac_min;
-		unsigned yOffset  = image.height() * _y_frac_min;
+		unsigned xOffset  = image.width()  * xFracMin;
+		unsigned yOffset  = image.height() * yFracMin;
 
 		// bottom right
-		unsigned xMax     = image.width()  * _x_frac_max;
-		unsigned yMax     = image.height() * _y_frac_max;
+		unsigned xMax     = image.width()  * xFracMax;
+		unsigned yMax     = image.height() * yFracMax;
 
 
+		// read only, the non-const access would check the sharing of the buffer per pixel
+		const Image<ColorRgb>& frame = image;
 		for (unsigned x = xOffset; noSignal && x < xMax; ++x)
 		{
 			for (unsigned y = yOffset; noSignal && y < yMax; ++y)
 			{
-				noSignal &= (ColorRgb&)image(x, y) <= _noSignalThresholdColor;
+				noSignal &= frame(x, y) <= noSignalThresholdColor;
 			}
 		}
 
@@ -1102,7 +1218,7 @@ void V4L2Grabber::process_image(const uint8_t * data, int size)
 		}
 		else
 		{
-			if (_noSignalCounter >= _noSignalCounterThreshold)
+			if (_noSignalCounter >= noSignalCounterThreshold)
 			{
 				_noSignalDetected = true;
 				Info(_log, "Signal detected");
@@ -1111,11 +1227,11 @@ void V4L2Grabber::process_image(const uint8_t * data, int size)
 			_noSignalCounter = 0;
 		}
 
-		if ( _noSignalCounter < _noSignalCounterThreshold)
+		if ( _noSignalCounter < noSignalCounterThreshold)
 		{
 			emit newFrame(image);
 		}
-		else if (_noSignalCounter == _noSignalCounterThreshold)
+		else if (_noSignalCounter == noSignalCounterThreshold)
 		{
 			_noSignalDetected = false;
 			Info(_log, "Signal lost");
@@ -1142,6 +1258,7 @@ int V4L2Grabber::xioctl(int request, void *arg)
 
 void V4L2Grabber::setSignalDetectionEnable(bool enable)
 {
+	QMutexLocker lock(&_settingsMutex);
 	if (_signalDetectionEnabled != enable)
 	{
 		_signalDetectionEnabled = enable;
@@ -1151,6 +1268,7 @@ void V4L2Grabber::setSignalDetectionEnable(bool enable)
 
 void V4L2Grabber::setPixelDecimation(int pixelDecimation)
 {
+	QMutexLocker lock(&_settingsMutex);
 	if (_pixelDecimation != pixelDecimation)
 	{
 		_pixelDecimation = pixelDecimation;
@@ -1159,6 +1277,18 @@ void V4L2Grabber::setPixelDecimation(int pixelDecimation)
 	}
 }
 
+void V4L2Grabber::setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom)
+{
+	QMutexLocker lock(&_settingsMutex);
+	Grabber::setCropping(cropLeft, cropRight, cropTop, cropBottom);
+}
+
+void V4L2Grabber::setVideoMode(VideoMode mode)
+{
+	QMutexLocker lock(&_settingsMutex);
+	Grabber::setVideoMode(mode);
+}
+
 void V4L2Grabber::setDeviceVideoStandard(QString device, VideoStandard videoStandard)
 {
 	if (_deviceName != device || _videoStandard != videoStandard)
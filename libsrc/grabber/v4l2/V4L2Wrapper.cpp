@@ -20,9 +20,10 @@ V4L2Wrapper::V4L2Wrapper(const QString &device,
 	// register the image type
 	qRegisterMetaType<Image<ColorRgb>>("Image<ColorRgb>");
 
-	// Handle the image in the captured thread using a direct connection
+	// Handle the image in the decode thread using a direct connection
 	connect(&_grabber, SIGNAL(newFrame(Image<ColorRgb>)), this, SLOT(newFrame(Image<ColorRgb>)), Qt::DirectConnection);
-	connect(&_grabber, SIGNAL(readError(const char*)), this, SLOT(readError(const char*)), Qt::DirectConnection);
+	// read errors stop the grabber, which joins the capture threads, so they are handled in our thread
+	connect(&_grabber, SIGNAL(readError(QString)), this, SLOT(readError(QString)), Qt::QueuedConnection);
 	
 	connect(this, &V4L2Wrapper::componentStateChanged, _ggrabber, &Grabber::componentStateChanged);
 }
@@ -58,9 +59,9 @@ void V4L2Wrapper::newFrame(const Image<ColorRgb> &image)
 	emit systemImage(_grabberName, image);
 }
 
-void V4L2Wrapper::readError(const char* err)
+void V4L2Wrapper::readError(const QString& err)
 {
-	Error(_log, "stop grabber, because reading device failed. (%s)", err);
+	Error(_log, "stop grabber, because reading device failed. (%s)", QSTRING_CSTR(err));
 	stop();
 }
 
@@ -18,6 +18,8 @@
 // utils
 #include <utils/hyperion.h>
 #include <utils/GlobalSignals.h>
+#include <utils/PixelKernels.h>
+#include <utils/ImageDownscaler.h>
 
 // Leddevice includes
 #include <leddevice/LedDeviceWrapper.h>
@@ -56,6 +58,10 @@ Hyperion::Hyperion(const quint8& instance)
 	, _ledGridSize(hyperion::getLedLayoutGridSize(getSetting(settings::LEDS).array()))
 	, _prevCompId(hyperion::COMP_INVALID)
 	, _ledBuffer(_ledString.leds().size(), ColorRgb::BLACK)
+	, _keepAliveTime(0)
+	, _lastUpdate()
+	, _lastLedDeviceWrite()
+	, _lastLedDeviceData()
 {
 
 }
@@ -81,6 +87,12 @@ void Hyperion::start()
 	// handle hwLedCount
 	_hwLedCount = qMax(unsigned(getSetting(settings::DEVICE).object()["hardwareLedCount"].toInt(getLedCount())), getLedCount());
 
+	// network clients reduce their images to the largest target size of all instances
+	ImageDownscaler::setInstanceTargetSize(_instIndex, ImageDownscaler::targetSize(_ledGridSize));
+
+	// static scene keep-alive
+	_keepAliveTime = getSetting(settings::DEVICE).object()["keepAliveTime"].toInt(1000);
+
 	// init colororder vector
 	for (Led& led : _ledString.leds())
 	{
@@ -104,6 +116,7 @@ void Hyperion::start()
 	ledDevice["currentLedCount"] = int(_hwLedCount); // Inject led count info
 
 	_ledDeviceWrapper = new LedDeviceWrapper(this);
+	_ledDeviceWrapper->setColorOrders(_ledStringColorOrder);
 	connect(this, &Hyperion::componentStateChanged, _ledDeviceWrapper, &LedDeviceWrapper::handleComponentState);
 	connect(this, &Hyperion::ledDeviceData, _ledDeviceWrapper, &LedDeviceWrapper::write);
 	_ledDeviceWrapper->createLedDevice(ledDevice);
@@ -159,6 +172,8 @@ void Hyperion::freeObjects(bool emitCloseSignal)
 	// switch off all leds
 	clearall(true);
 
+	ImageDownscaler::removeInstance(_instIndex);
+
 	if (emitCloseSignal)
 	{
 		emit closing();
@@ -202,6 +217,7 @@ void Hyperion::handleSettingsUpdate(const settings::type& type, const QJsonDocum
 		_imageProcessor->setLedString(_ledString);
 		_muxer.updateLedColorsLength(_ledString.leds().size());
 		_ledGridSize = hyperion::getLedLayoutGridSize(leds);
+		ImageDownscaler::setInstanceTargetSize(_instIndex, ImageDownscaler::targetSize(_ledGridSize));
 
 		std::vector<ColorRgb> color(_ledString.leds().size(), ColorRgb{0,0,0});
 		_ledBuffer = color;
@@ -211,6 +227,7 @@ void Hyperion::handleSettingsUpdate(const settings::type& type, const QJsonDocum
 		{
 			_ledStringColorOrder.push_back(led.colorOrder);
 		}
+		_ledDeviceWrapper->setColorOrders(_ledStringColorOrder);
 
 		// handle hwLedCount update
 		_hwLedCount = qMax(unsigned(getSetting(settings::DEVICE).object()["hardwareLedCount"].toInt(getLedCount())), getLedCount());
@@ -230,6 +247,10 @@ void Hyperion::handleSettingsUpdate(const settings::type& type, const QJsonDocum
 		// handle hwLedCount update
 		_hwLedCount = qMax(unsigned(dev["hardwareLedCount"].toInt(getLedCount())), getLedCount());
 
+		// static scene keep-alive, the recreated device gets the current led data at once
+		_keepAliveTime = dev["keepAliveTime"].toInt(1000);
+		_lastLedDeviceData.clear();
+
 		// force ledString update, if device ByteOrder changed
 		if(_ledDeviceWrapper->getColorOrder() != dev["colorOrder"].toString("rgb"))
 		{
@@ -241,6 +262,7 @@ void Hyperion::handleSettingsUpdate(const settings::type& type, const QJsonDocum
 			{
 				_ledStringColorOrder.push_back(led.colorOrder);
 			}
+			_ledDeviceWrapper->setColorOrders(_ledStringColorOrder);
 		}
 
 		// do always reinit until the led devices can handle dynamic changes
@@ -318,7 +340,7 @@ bool Hyperion::setInput(const int priority, const std::vector<ColorRgb>& ledColo
 			_effectEngine->channelCleared(priority);
 
 		// if this priority is visible, update immediately
-		if(priority == _muxer.getCurrentPriority())
+		if(_muxer.isVisible(priority))
 			update();
 
 		return true;
@@ -334,15 +356,27 @@ bool Hyperion::setInputImage(const int priority, const Image<ColorRgb>& image, i
 		return false;
 	}
 
-	if(_muxer.setInputImage(priority, image, timeout_ms))
+	bool unchanged = false;
+	if(_muxer.setInputImage(priority, image, timeout_ms, &unchanged))
 	{
 		// clear effect if this call does not come from an effect
 		if(clearEffect)
 			_effectEngine->channelCleared(priority);
 
-		// if this priority is visible, update immediately
-		if(priority == _muxer.getCurrentPriority())
-			update();
+		// if this priority is visible, update immediately. A repeated image (static scene) is only processed as keep-alive
+		if(_muxer.isVisible(priority))
+		{
+			bool keepAliveSkip = false;
+			if (unchanged)
+			{
+				// the update writes the timestamp, possibly from another thread
+				QMutexLocker lock(&_changes);
+				keepAliveSkip = isKeepAliveSkip(_lastUpdate);
+			}
+
+			if (!keepAliveSkip)
+				update();
+		}
 
 		return true;
 	}
@@ -354,6 +388,22 @@ bool Hyperion::setInputInactive(const quint8& priority)
 	return _muxer.setInputInactive(priority);
 }
 
+bool Hyperion::setInputBlend(const int priority, const int alpha, const std::vector<int>& leds)
+{
+	std::vector<uint8_t> ledMask;
+	if (!leds.empty())
+	{
+		ledMask.resize(_ledString.leds().size(), 0);
+		for (int led : leds)
+		{
+			if (led >= 0 && led < int(ledMask.size()))
+				ledMask[led] = 1;
+		}
+	}
+
+	return _muxer.setInputBlend(priority, uint8_t(qBound(0, alpha, 255)), ledMask);
+}
+
 void Hyperion::setColor(const int priority, const ColorRgb &color, const int timeout_ms, const QString& origin, bool clearEffects)
 {
 	// clear effect if this call does not come from an effect
@@ -387,6 +437,7 @@ ColorAdjustment * Hyperion::getAdjustment(const QString& id)
 
 void Hyperion::adjustmentsUpdated()
 {
+	_raw2ledAdjustment->invalidateTables();
 	emit adjustmentChanged();
 	update();
 }
@@ -517,57 +568,52 @@ void Hyperion::updatedComponentState(const hyperion::Components comp, const bool
 void Hyperion::update()
 {
 	QMutexLocker lock(&_changes);
+	_lastUpdate.start();
 
-	// Obtain the current priority channel
-	int priority = _muxer.getCurrentPriority();
-	const PriorityMuxer::InputInfo priorityInfo = _muxer.getInputInfo(priority);
+	// Obtain the visible priority and the translucent priorities over the next opaque one, the frames are shared with the muxer slots
+	const std::vector<PriorityMuxer::InputLayer> layers = _muxer.getVisibleLayers();
+	const int priority = layers.front().priority;
 
-	// copy image & process OR copy ledColors from muxer
-	Image<ColorRgb> image = priorityInfo.image;
-	if(image.size() > 3)
+	// the black border detection follows the top image layer, its state would not settle on alternating images
+	const PriorityMuxer::InputLayer* topImageLayer = nullptr;
+	for (const PriorityMuxer::InputLayer& layer : layers)
 	{
-		emit currentImage(image);
-		_ledBuffer = _imageProcessor->process(image);
+		if (layer.frame->image.size() > 3)
+		{
+			topImageLayer = &layer;
+			break;
+		}
 	}
-	else
-		_ledBuffer = priorityInfo.ledColors;
-
-	// emit rawLedColors before transform
-	emit rawLedColors(_ledBuffer);
 
-	_raw2ledAdjustment->applyAdjustment(_ledBuffer);
-
-	int i = 0;
-	for (ColorRgb& color : _ledBuffer)
+	// process image OR copy ledColors from muxer, bottom layer first
+	for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer)
 	{
-		// correct the color byte order
-		switch (_ledStringColorOrder.at(i))
+		const bool bottom = (layer == layers.rbegin());
+		std::vector<ColorRgb>& colors = bottom ? _ledBuffer : _layerBuffer;
+
+		const Image<ColorRgb>& image = layer->frame->image;
+		if(image.size() > 3)
 		{
-		case ORDER_RGB:
-			// leave as it is
-			break;
-		case ORDER_BGR:
-			std::swap(color.red, color.blue);
-			break;
-		case ORDER_RBG:
-			std::swap(color.green, color.blue);
-			break;
-		case ORDER_GRB:
-			std::swap(color.red, color.green);
-			break;
-		case ORDER_GBR:
-			std::swap(color.red, color.green);
-			std::swap(color.green, color.blue);
-			break;
+			if (layer->priority == priority)
+				emit currentImage(image);
+			colors = (&*layer == topImageLayer) ? _imageProcessor->process(image) : _imageProcessor->processLowerLayer(image);
+		}
+		else
+			colors = layer->frame->ledColors;
 
-		case ORDER_BRG:
-			std::swap(color.red, color.blue);
-			std::swap(color.green, color.blue);
-			break;
+		if (!bottom)
+		{
+			blendLayer(*layer->blend);
 		}
-		i++;
 	}
 
+	// emit rawLedColors before transform
+	emit rawLedColors(_ledBuffer);
+
+	_raw2ledAdjustment->applyAdjustment(_ledBuffer);
+
+	// the color byte order is applied by the led device while packing its output
+
 	// fill additional hw leds with black
 	if ( _hwLedCount > _ledBuffer.size() )
 	{
@@ -577,13 +623,42 @@ void Hyperion::update()
 	// Write the data to the device
 	if (_ledDeviceWrapper->enabled())
 	{
-		_deviceSmooth->selectConfig(priorityInfo.smooth_cfg);
+		_deviceSmooth->selectConfig(_muxer.getSmoothingConfig(priority));
 
 		// feed smoothing in pause mode to maintain a smooth transistion back to smooth mode
 		if (_deviceSmooth->enabled() || _deviceSmooth->pause())
 			_deviceSmooth->setLedValues(_ledBuffer);
 
-		if  (! _deviceSmooth->enabled())
+		// unchanged led data is not written again until the keep-alive
+		if  (! _deviceSmooth->enabled() && !(_ledBuffer == _lastLedDeviceData && isKeepAliveSkip(_lastLedDeviceWrite)))
+		{
+			_lastLedDeviceData = _ledBuffer;
+			_lastLedDeviceWrite.start();
 			emit ledDeviceData(_ledBuffer);
+		}
+	}
+	else
+	{
+		// write at once when the device is enabled again
+		_lastLedDeviceData.clear();
+	}
+}
+
+void Hyperion::blendLayer(const PriorityMuxer::InputBlend& blend)
+{
+	const size_t count = qMin(_ledBuffer.size(), _layerBuffer.size());
+
+	_blendWeights.resize(count * 3);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint8_t weight = (blend.ledMask.empty() || (i < blend.ledMask.size() && blend.ledMask[i])) ? blend.alpha : 0;
+		_blendWeights[3*i] = _blendWeights[3*i + 1] = _blendWeights[3*i + 2] = weight;
 	}
+
+	PixelKernels::blend8(reinterpret_cast<uint8_t*>(_ledBuffer.data()), reinterpret_cast<const uint8_t*>(_layerBuffer.data()), _blendWeights.data(), count * 3);
+}
+
+bool Hyperion::isKeepAliveSkip(const QElapsedTimer& lastTime) const
+{
+	return _keepAliveTime > 0 && lastTime.isValid() && lastTime.elapsed() < _keepAliveTime;
 }
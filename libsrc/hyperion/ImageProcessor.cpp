@@ -1,4 +1,7 @@
 
+// STL includes
+#include <algorithm>
+
 // Hyperion includes
 #include <hyperion/Hyperion.h>
 #include <hyperion/ImageProcessor.h>
@@ -9,6 +12,13 @@
 
 using namespace hyperion;
 
+namespace {
+
+/// Number of mappings that are kept for border and size switches
+const size_t MAPPING_CACHE_SIZE = 4;
+
+}
+
 // global transform method
 int ImageProcessor::mappingTypeToInt(QString mappingType)
 {
@@ -32,6 +42,7 @@ ImageProcessor::ImageProcessor(const LedString& ledString, Hyperion* hyperion)
 	, _ledString(ledString)
 	, _borderProcessor(new BlackBorderProcessor(hyperion, this))
 	, _imageToLeds(nullptr)
+	, _mappingCache()
 	, _mappingType(0)
 	, _userMappingType(0)
 	, _hardMappingType(0)
@@ -45,7 +56,7 @@ ImageProcessor::ImageProcessor(const LedString& ledString, Hyperion* hyperion)
 
 ImageProcessor::~ImageProcessor()
 {
-	delete _imageToLeds;
+	clearMappings();
 }
 
 void ImageProcessor::handleSettingsUpdate(const settings::type& type, const QJsonDocument& config)
@@ -69,26 +80,78 @@ void ImageProcessor::setSize(const unsigned width, const unsigned height)
 		return;
 	}
 
-	// Clean up the old buffer and mapping
-	_imageToLeds = 0;
-
-	// Construct a new buffer and mapping
-	_imageToLeds = (width>0 && height>0) ? (new ImageToLedsMap(width, height, 0, 0, _ledString.leds())) : nullptr;
+	if (width>0 && height>0)
+	{
+		selectMapping(width, height, 0, 0);
+	}
+	else
+	{
+		_imageToLeds = nullptr;
+	}
 }
 
 void ImageProcessor::setLedString(const LedString& ledString)
 {
 	_ledString = ledString;
 
-	// get current width/height
+	// get current width/height, there is no mapping before the first image
+	if (_imageToLeds == nullptr)
+	{
+		clearMappings();
+		return;
+	}
 	const unsigned width = _imageToLeds->width();
 	const unsigned height = _imageToLeds->height();
 
-	// Clean up the old buffer and mapping
-	_imageToLeds = 0;
+	// all mappings refer to the old leds
+	clearMappings();
+	selectMapping(width, height, 0, 0);
+}
+
+void ImageProcessor::selectMapping(const unsigned width, const unsigned height, const unsigned horizontalBorder, const unsigned verticalBorder)
+{
+	_imageToLeds = findMapping(width, height, horizontalBorder, verticalBorder);
+}
+
+ImageToLedsMap* ImageProcessor::findMapping(const unsigned width, const unsigned height, const unsigned horizontalBorder, const unsigned verticalBorder)
+{
+	for (auto it = _mappingCache.begin(); it != _mappingCache.end(); ++it)
+	{
+		ImageToLedsMap* mapping = *it;
+		if (mapping->width() == width && mapping->height() == height
+			&& mapping->horizontalBorder() == horizontalBorder && mapping->verticalBorder() == verticalBorder)
+		{
+			// move to the front
+			std::rotate(_mappingCache.begin(), it, it + 1);
+			return mapping;
+		}
+	}
 
-	// Construct a new buffer and mapping
-	_imageToLeds = new ImageToLedsMap(width, height, 0, 0, _ledString.leds());
+	if (_mappingCache.size() >= MAPPING_CACHE_SIZE)
+	{
+		// the current mapping stays, it may be behind the mappings of the lower image layers
+		auto oldest = _mappingCache.end() - 1;
+		if (*oldest == _imageToLeds)
+		{
+			--oldest;
+		}
+		delete *oldest;
+		_mappingCache.erase(oldest);
+	}
+
+	ImageToLedsMap* mapping = new ImageToLedsMap(width, height, horizontalBorder, verticalBorder, _ledString.leds());
+	_mappingCache.insert(_mappingCache.begin(), mapping);
+	return mapping;
+}
+
+void ImageProcessor::clearMappings()
+{
+	for (ImageToLedsMap* mapping : _mappingCache)
+	{
+		delete mapping;
+	}
+	_mappingCache.clear();
+	_imageToLeds = nullptr;
 }
 
 void ImageProcessor::setBlackbarDetectDisable(bool enable)
@@ -7,12 +7,17 @@ ImageToLedsMap::ImageToLedsMap(
 		const unsigned height,
 		const unsigned horizontalBorder,
 		const unsigned verticalBorder,
-		const std::vector<Led>& leds)
+		const std::vector<Led>& leds,
+		const SamplingMode samplingMode)
 	: _width(width)
 	, _height(height)
 	, _horizontalBorder(horizontalBorder)
 	, _verticalBorder(verticalBorder)
-	, _colorsMap()
+	, _samplingMode(samplingMode)
+	, _ledAreas()
+	, _colorSpans()
+	, _integralMutex()
+	, _integral()
 {
 	// Sanity check of the size of the borders (and width and height)
 	Q_ASSERT(_width  > 2*_verticalBorder);
@@ -21,19 +26,21 @@ ImageToLedsMap::ImageToLedsMap(
 	Q_ASSERT(_height < 10000);
 
 	// Reserve enough space in the map for the leds
-	_colorsMap.reserve(leds.size());
+	_ledAreas.reserve(leds.size());
 
 	const unsigned xOffset      = _verticalBorder;
 	const unsigned actualWidth  = _width  - 2 * _verticalBorder;
 	const unsigned yOffset      = _horizontalBorder;
 	const unsigned actualHeight = _height - 2 * _horizontalBorder;
 
+	quint64 totalPixels = 0;
+
 	for (const Led& led : leds)
 	{
 		// skip leds without area
 		if ((led.maxX_frac-led.minX_frac) < 1e-6 || (led.maxY_frac-led.minY_frac) < 1e-6)
 		{
-			_colorsMap.emplace_back();
+			_ledAreas.push_back(LedArea{unsigned(_colorSpans.size()), 0, 0, 0, 0, 0, 0});
 			continue;
 		}
 
@@ -55,23 +62,27 @@ ImageToLedsMap::ImageToLedsMap(
 			maxY_idx++;
 		}
 
-		// Add all the indices in the above defined rectangle to the indices for this led
+		// Add a span per row of the above defined rectangle to the spans for this led
 		const auto maxYLedCount = qMin(maxY_idx, yOffset+actualHeight);
 		const auto maxXLedCount = qMin(maxX_idx, xOffset+actualWidth);
 
-		std::vector<unsigned> ledColors;
-		ledColors.reserve((size_t) maxXLedCount*maxYLedCount);
-
-		for (unsigned y = minY_idx; y < maxYLedCount; ++y)
+		LedArea area{unsigned(_colorSpans.size()), 0, 0, minX_idx, qMax(minX_idx, maxXLedCount), minY_idx, qMax(minY_idx, maxYLedCount)};
+		for (unsigned y = area.minY; y < area.maxY && area.minX < area.maxX; ++y)
 		{
-			for (unsigned x = minX_idx; x < maxXLedCount; ++x)
-			{
-				ledColors.push_back(y*width + x);
-			}
+			_colorSpans.push_back(ColorSpan{y, area.minX, area.maxX});
+			++area.spanCount;
+			area.pixelCount += area.maxX - area.minX;
 		}
+		totalPixels += area.pixelCount;
 
-		// Add the constructed vector to the map
-		_colorsMap.push_back(ledColors);
+		// Add the constructed area to the map
+		_ledAreas.push_back(area);
+	}
+
+	// the summed-area table pays off as soon as the led regions overlap (e.g. large depth settings)
+	if (_samplingMode == SAMPLE_AUTO)
+	{
+		_samplingMode = (totalPixels > quint64(_width) * _height) ? SAMPLE_INTEGRAL : SAMPLE_SPANS;
 	}
 }
 
@@ -84,3 +95,24 @@ unsigned ImageToLedsMap::height() const
 {
 	return _height;
 }
+
+ColorRgb ImageToLedsMap::calcIntegralMeanColor(const LedArea & area) const
+{
+	if (area.pixelCount == 0)
+	{
+		return ColorRgb::BLACK;
+	}
+
+	const size_t stride = 3 * size_t(_width + 1);
+	const uint32_t* topLeft     = _integral.data() + area.minY * stride + 3 * area.minX;
+	const uint32_t* topRight    = _integral.data() + area.minY * stride + 3 * area.maxX;
+	const uint32_t* bottomLeft  = _integral.data() + area.maxY * stride + 3 * area.minX;
+	const uint32_t* bottomRight = _integral.data() + area.maxY * stride + 3 * area.maxX;
+
+	// unsigned wrap-around cancels out, the differences are exact
+	const uint32_t cummRed   = bottomRight[0] - bottomLeft[0] - topRight[0] + topLeft[0];
+	const uint32_t cummGreen = bottomRight[1] - bottomLeft[1] - topRight[1] + topLeft[1];
+	const uint32_t cummBlue  = bottomRight[2] - bottomLeft[2] - topRight[2] + topLeft[2];
+
+	return {uint8_t(cummRed/area.pixelCount), uint8_t(cummGreen/area.pixelCount), uint8_t(cummBlue/area.pixelCount)};
+}
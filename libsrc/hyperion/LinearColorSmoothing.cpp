@@ -1,5 +1,4 @@
 // Qt includes
-#include <QDateTime>
 #include <QTimer>
 
 #include "LinearColorSmoothing.h"
@@ -9,13 +8,33 @@
 
 using namespace hyperion;
 
+namespace {
+
+/// Interval of the output jitter statistics (usec)
+const int64_t STATISTICS_INTERVAL = 10000000;
+
+/// ln(256), the exponential decay is within 1/256 of the target after the settling time
+const double DECAY_RATE = 5.545177444479562;
+
+/// omega * settlingTime of the damped curve, (1 + 8) * exp(-8) is below 1/256 as well
+const double DAMPED_RATE = 8.0;
+
+}
+
 LinearColorSmoothing::LinearColorSmoothing(const QJsonDocument& config, Hyperion* hyperion)
 	: LedDevice(QJsonObject(), hyperion)
 	, _log(Logger::getInstance("SMOOTHING"))
 	, _hyperion(hyperion)
-	, _updateInterval(1000)
-	, _settlingTime(200)
+	, _updateInterval(1000000)
+	, _settlingTime(200000)
 	, _timer(new QTimer(this))
+	, _scheduler()
+	, _statisticsTime(0)
+	, _targetTime(0)
+	, _previousTime(0)
+	, _smoothing()
+	, _type(SMOOTHING_LINEAR)
+	, _dithering(false)
 	, _outputDelay(0)
 	, _writeToLedsEnable(true)
 	, _continuousOutput(false)
@@ -26,7 +45,7 @@ LinearColorSmoothing::LinearColorSmoothing(const QJsonDocument& config, Hyperion
 	_hyperion->getComponentRegister().componentStateChanged(hyperion::COMP_SMOOTHING, true);
 
 	// init cfg 0 (default)
-	_cfgList.append({false, 200, 25, 0});
+	_cfgList.append({false, 200, 40000, 0});
 	handleSettingsUpdate(settings::SMOOTHING, config);
 
 	// add pause on cfg 1
@@ -36,6 +55,8 @@ LinearColorSmoothing::LinearColorSmoothing(const QJsonDocument& config, Hyperion
 	// listen for comp changes
 	connect(_hyperion, &Hyperion::componentStateChanged, this, &LinearColorSmoothing::componentStateChange);
 	// timer
+	_timer->setSingleShot(true);
+	_timer->setTimerType(Qt::PreciseTimer);
 	connect(_timer, SIGNAL(timeout()), this, SLOT(updateLeds()));
 }
 
@@ -50,7 +71,14 @@ void LinearColorSmoothing::handleSettingsUpdate(const settings::type& type, cons
 	{
 		QJsonObject obj = config.object();
 		_continuousOutput = obj["continuousOutput"].toBool(true);
-		SMOOTHING_CFG cfg = {false, obj["time_ms"].toInt(200), unsigned(1000.0/obj["updateFrequency"].toDouble(25.0)), unsigned(obj["updateDelay"].toInt(0))};
+		_dithering = obj["dithering"].toBool(false);
+
+		const QString type = obj["type"].toString("linear");
+		const SmoothingType smoothingType = (type == "decay")  ? SMOOTHING_DECAY
+		                                  : (type == "damped") ? SMOOTHING_DAMPED
+		                                  : SMOOTHING_LINEAR;
+
+		SMOOTHING_CFG cfg = {false, obj["time_ms"].toInt(200), int64_t(1000000.0/obj["updateFrequency"].toDouble(25.0)), unsigned(obj["updateDelay"].toInt(0)), smoothingType};
 		_cfgList[0] = cfg;
 		// if current id is 0, we need to apply the settings (forced)
 		if(!_currentConfigId)
@@ -64,20 +92,12 @@ void LinearColorSmoothing::handleSettingsUpdate(const settings::type& type, cons
 int LinearColorSmoothing::write(const std::vector<ColorRgb> &ledValues)
 {
 	// received a new target color
-	if (_previousValues.empty())
-	{
-		// not initialized yet
-		_targetTime = QDateTime::currentMSecsSinceEpoch() + _settlingTime;
-		_targetValues = ledValues;
+	_targetTime = FrameScheduler::now() + _settlingTime;
 
-		_previousTime = QDateTime::currentMSecsSinceEpoch();
-		_previousValues = ledValues;
-		QMetaObject::invokeMethod(_timer, "start", Qt::QueuedConnection, Q_ARG(int, _updateInterval));
-	}
-	else
+	if (_smoothing.setTarget(ledValues))
 	{
-		_targetTime = QDateTime::currentMSecsSinceEpoch() + _settlingTime;
-		memcpy(_targetValues.data(), ledValues.data(), ledValues.size() * sizeof(ColorRgb));
+		_previousTime = FrameScheduler::now();
+		startTimer();
 	}
 
 	return 0;
@@ -88,13 +108,13 @@ int LinearColorSmoothing::switchOff()
 	// We will keep updating the leds (but with pure-black)
 
 	// Clear the smoothing parameters
-	std::fill(_targetValues.begin(), _targetValues.end(), ColorRgb::BLACK);
+	_smoothing.switchOff();
 	_targetTime = 0;
 
 	// Erase the output-queue
 	for (unsigned i=0; i<_outputQueue.size(); ++i)
 	{
-		_outputQueue.push_back(_targetValues);
+		_outputQueue.push_back(_smoothing.targetValues());
 		_outputQueue.pop_front();
 	}
 
@@ -105,41 +125,79 @@ int LinearColorSmoothing::switchOff()
 
 void LinearColorSmoothing::updateLeds()
 {
-	int64_t now = QDateTime::currentMSecsSinceEpoch();
-	int deltaTime = _targetTime - now;
+	if (_smoothing.empty())
+	{
+		return;
+	}
 
-	if (deltaTime < 0)
+	const int64_t now = FrameScheduler::now();
+	const int64_t deltaTime = now - _previousTime;
+	_scheduler.frameDone(now);
+
+	bool settled;
+	switch (_type)
 	{
-		memcpy(_previousValues.data(), _targetValues.data(), _targetValues.size() * sizeof(ColorRgb));
-		_previousTime = now;
+		case SMOOTHING_DECAY:  settled = updateDecay(deltaTime);  break;
+		case SMOOTHING_DAMPED: settled = updateDamped(deltaTime); break;
+		default:               settled = updateLinear(deltaTime); break;
+	}
+	_previousTime = now;
 
-		queueColors(_previousValues);
+	_smoothing.updateOutput(_dithering);
+
+	if (settled)
+	{
+		queueColors(_smoothing.outputValues());
 		_writeToLedsEnable = _continuousOutput;
 	}
 	else
 	{
 		_writeToLedsEnable = true;
-		float k = 1.0f - 1.0f * deltaTime / (_targetTime - _previousTime);
+		queueColors(_smoothing.outputValues());
+	}
 
-		int reddif = 0, greendif = 0, bluedif = 0;
+	// the next deadline is absolute, the time spent here doesn't delay the following updates
+	const int64_t done = FrameScheduler::now();
+	_timer->start(_scheduler.timerDelay(done));
 
-		for (size_t i = 0; i < _previousValues.size(); ++i)
-		{
-			ColorRgb & prev   = _previousValues[i];
-			ColorRgb & target = _targetValues[i];
-
-			reddif   = target.red   - prev.red;
-			greendif = target.green - prev.green;
-			bluedif  = target.blue  - prev.blue;
+	if (done - _statisticsTime >= STATISTICS_INTERVAL)
+	{
+		_statisticsTime = done;
+		const FrameScheduler::Jitter jitter = _scheduler.takeJitter();
+		Debug(_log, "%llu updates, %llu skipped, jitter avg %lld us max %lld us",
+			  (unsigned long long)jitter.frames, (unsigned long long)jitter.skipped, (long long)jitter.average_us, (long long)jitter.max_us);
+	}
+}
 
-			prev.red   += (reddif   < 0 ? -1:1) * std::ceil(k * std::abs(reddif));
-			prev.green += (greendif < 0 ? -1:1) * std::ceil(k * std::abs(greendif));
-			prev.blue  += (bluedif  < 0 ? -1:1) * std::ceil(k * std::abs(bluedif));
-		}
-		_previousTime = now;
+void LinearColorSmoothing::startTimer()
+{
+	_scheduler.start(_updateInterval);
+	_statisticsTime = FrameScheduler::now();
+	QMetaObject::invokeMethod(_timer, "start", Qt::QueuedConnection, Q_ARG(int, _scheduler.timerDelay(_statisticsTime)));
+}
 
-		queueColors(_previousValues);
+bool LinearColorSmoothing::updateLinear(int64_t deltaTime)
+{
+	const int64_t remaining = _targetTime - _previousTime;
+	if (deltaTime > remaining || remaining <= 0)
+	{
+		_smoothing.settle();
+		return true;
 	}
+
+	_smoothing.approach(double(deltaTime) / remaining);
+	return false;
+}
+
+bool LinearColorSmoothing::updateDecay(int64_t deltaTime)
+{
+	return _smoothing.approach(1.0 - std::exp(-DECAY_RATE * deltaTime / qMax<int64_t>(1, _settlingTime)));
+}
+
+bool LinearColorSmoothing::updateDamped(int64_t deltaTime)
+{
+	// exact step of the spring for the elapsed time with x = omega * deltaTime
+	return _smoothing.damp(DAMPED_RATE * deltaTime / qMax<int64_t>(1, _settlingTime));
 }
 
 void LinearColorSmoothing::queueColors(const std::vector<ColorRgb> & ledColors)
@@ -183,7 +241,8 @@ void LinearColorSmoothing::setEnable(bool enable)
 	if (!enable)
 	{
 		QMetaObject::invokeMethod(_timer, "stop", Qt::QueuedConnection);
-		_previousValues.clear();
+		_scheduler.stop();
+		_smoothing.clear();
 	}
 	// update comp register
 	_hyperion->getComponentRegister().componentStateChanged(hyperion::COMP_SMOOTHING, enable);
@@ -196,10 +255,10 @@ void LinearColorSmoothing::setPause(bool pause)
 
 unsigned LinearColorSmoothing::addConfig(int settlingTime_ms, double ledUpdateFrequency_hz, unsigned updateDelay)
 {
-	SMOOTHING_CFG cfg = {false, settlingTime_ms, int64_t(1000.0/ledUpdateFrequency_hz), updateDelay};
+	SMOOTHING_CFG cfg = {false, settlingTime_ms, int64_t(1000000.0/ledUpdateFrequency_hz), updateDelay};
 	_cfgList.append(cfg);
 
-	//Debug( _log, "smoothing cfg %d: interval: %d ms, settlingTime: %d ms, updateDelay: %d frames",  _cfgList.count()-1, cfg.updateInterval, cfg.settlingTime,  cfg.outputDelay );
+	//Debug( _log, "smoothing cfg %d: interval: %d us, settlingTime: %d ms, updateDelay: %d frames",  _cfgList.count()-1, cfg.updateInterval, cfg.settlingTime,  cfg.outputDelay );
 	return _cfgList.count() - 1;
 }
 
@@ -212,18 +271,20 @@ bool LinearColorSmoothing::selectConfig(unsigned cfg, const bool& force)
 
 	if ( cfg < (unsigned)_cfgList.count())
 	{
-		_settlingTime     = _cfgList[cfg].settlingTime;
+		_settlingTime     = _cfgList[cfg].settlingTime * 1000;
 		_outputDelay      = _cfgList[cfg].outputDelay;
 		_pause            = _cfgList[cfg].pause;
+		_type             = _cfgList[cfg].type;
 
-		if (_cfgList[cfg].updateInterval != _updateInterval)
+		// the pause cfg has no interval, the leds keep their schedule
+		if (_cfgList[cfg].updateInterval != _updateInterval && !_pause)
 		{
 			QMetaObject::invokeMethod(_timer, "stop", Qt::QueuedConnection);
 			_updateInterval = _cfgList[cfg].updateInterval;
-			QMetaObject::invokeMethod(_timer, "start", Qt::QueuedConnection, Q_ARG(int, _updateInterval));
+			startTimer();
 		}
 		_currentConfigId = cfg;
-		//DebugIf( enabled() && !_pause, _log, "set smoothing cfg: %d, interval: %d ms, settlingTime: %d ms, updateDelay: %d frames",  _currentConfigId, _updateInterval, _settlingTime,  _outputDelay );
+		//DebugIf( enabled() && !_pause, _log, "set smoothing cfg: %d, interval: %d us, settlingTime: %d us, updateDelay: %d frames",  _currentConfigId, _updateInterval, _settlingTime,  _outputDelay );
 		DebugIf( _pause, _log, "set smoothing cfg: %d, pause",  _currentConfigId );
 
 		return true;
@@ -13,6 +13,11 @@
 // settings
 #include <utils/settings.h>
 
+// utils
+#include <utils/FrameScheduler.h>
+
+#include "SmoothingState.h"
+
 class QTimer;
 class Logger;
 class Hyperion;
@@ -20,7 +25,10 @@ class Hyperion;
 /// Linear Smooting class
 ///
 /// This class processes the requested led values and forwards them to the device after applying
-/// a linear smoothing effect. This class can be handled as a generic LedDevice.
+/// a smoothing effect (linear, exponential decay or critically damped). The state is kept as 8.8
+/// fixed-point per color channel, so slow fades don't step in whole 8-bit increments. The
+/// fraction is rounded or optionally dithered over time on output. This class can be handled as
+/// a generic LedDevice.
 class LinearColorSmoothing : public LedDevice
 {
 	Q_OBJECT
@@ -50,6 +58,12 @@ public:
 	bool pause() { return _pause; } ;
 	bool enabled() { return LedDevice::enabled() && !_pause; };
 
+	///
+	/// @brief Get and reset the deviation of the led updates from their schedule
+	/// @return The jitter since the last call
+	///
+	FrameScheduler::Jitter takeOutputJitter() { return _scheduler.takeJitter(); };
+
 	///
 	/// @brief Add a new smoothing cfg which can be used with selectConfig()
 	/// @param   settlingTime_ms       The buffer time
@@ -89,6 +103,29 @@ private slots:
 	void componentStateChange(const hyperion::Components component, const bool state);
 
 private:
+	/// The interpolation curves
+	enum SmoothingType
+	{
+		/// Reach the target at the end of the settling time
+		SMOOTHING_LINEAR = 0,
+		/// Exponential approach, within 1/256 of the target after the settling time
+		SMOOTHING_DECAY,
+		/// Critically damped spring, keeps the velocity when the target changes
+		SMOOTHING_DAMPED
+	};
+
+	///
+	/// @brief Move the state towards the targets for the given interval
+	/// @param deltaTime  The time since the last update (usec)
+	/// @return True when the targets are reached
+	///
+	bool updateLinear(int64_t deltaTime);
+	bool updateDecay(int64_t deltaTime);
+	bool updateDamped(int64_t deltaTime);
+
+	/// (Re)start the update timer with the current interval
+	void startTimer();
+
 	/**
 	 * Pushes the colors into the output queue and popping the head to the led-device
 	 *
@@ -102,26 +139,35 @@ private:
 	/// Hyperion instance
 	Hyperion* _hyperion;
 
-	/// The interval at which to update the leds (msec)
+	/// The interval at which to update the leds (usec)
 	int64_t _updateInterval;
 
-	/// The time after which the updated led values have been fully applied (msec)
+	/// The time after which the updated led values have been fully applied (usec)
 	int64_t _settlingTime;
 
-	/// The Qt timer object
+	/// The Qt timer object, single shot and re-armed for each deadline of the scheduler
 	QTimer * _timer;
 
-	/// The timestamp at which the target data should be fully applied
-	int64_t _targetTime;
+	/// The deadlines of the led updates
+	FrameScheduler _scheduler;
 
-	/// The target led data
-	std::vector<ColorRgb> _targetValues;
+	/// The time of the last jitter statistics (usec)
+	int64_t _statisticsTime;
 
-	/// The timestamp of the previously written led data
+	/// The monotonic timestamp at which the target data should be fully applied (usec)
+	int64_t _targetTime;
+
+	/// The monotonic timestamp of the previously written led data (usec)
 	int64_t _previousTime;
 
-	/// The previously written led data
-	std::vector<ColorRgb> _previousValues;
+	/// The target, smoothed and output led data
+	SmoothingState _smoothing;
+
+	/// The interpolation curve
+	SmoothingType _type;
+
+	/// Flag for temporal dithering of the fixed-point fraction
+	bool _dithering;
 
 	/// The number of updates to keep in the output queue (delayed) before being output
 	unsigned _outputDelay;
@@ -140,9 +186,12 @@ private:
 	struct SMOOTHING_CFG
 	{
 		bool     pause;
+		/// (msec)
 		int64_t  settlingTime;
+		/// (usec)
 		int64_t  updateInterval;
 		unsigned outputDelay;
+		SmoothingType type;
 	};
 
 	/// smooth config list
@@ -13,14 +13,34 @@
 // qt includes
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QUdpSocket>
 
 #include <flatbufserver/FlatBufferConnection.h>
 
+namespace {
+
+/// Messages kept per json target while it connects or is busy
+const int MAX_QUEUED_JSON_MESSAGES = 16;
+
+/// Largest payload of a UDP datagram
+const uint32_t MAX_DATAGRAM_SIZE = 65507;
+
+/// Space of the request around the pixels of a raw image
+const uint32_t REQUEST_OVERHEAD = 64;
+
+/// Interval of the register requests to the UDP targets [ms]
+const qint64 UDP_REGISTER_INTERVAL = 1000;
+
+}
+
 MessageForwarder::MessageForwarder(Hyperion *hyperion)
 	: QObject()
 	, _hyperion(hyperion)
 	, _log(Logger::getInstance("NETFORWARDER"))
 	, _muxer(_hyperion->getMuxerInstance())
+	, _udpSocket(nullptr)
+	, _udpRegistered()
+	, _udpOversizeLogged(false)
 	, _forwarder_enabled(true)
 	, _priority(140)
 {
@@ -39,8 +59,7 @@ MessageForwarder::MessageForwarder(Hyperion *hyperion)
 
 MessageForwarder::~MessageForwarder()
 {
-	while (!_forwardClients.isEmpty())
-		delete _forwardClients.takeFirst();
+	clearTargets();
 }
 
 void MessageForwarder::handleSettingsUpdate(const settings::type &type, const QJsonDocument &config)
@@ -48,10 +67,7 @@ void MessageForwarder::handleSettingsUpdate(const settings::type &type, const QJ
 	if(type == settings::NETFORWARD)
 	{
 		// clear the current targets
-		_jsonSlaves.clear();
-		_flatSlaves.clear();
-		while (!_forwardClients.isEmpty())
-			delete _forwardClients.takeFirst();
+		clearTargets();
 
 		// build new one
 		const QJsonObject &obj = config.object();
@@ -73,6 +89,15 @@ void MessageForwarder::handleSettingsUpdate(const settings::type &type, const QJ
 			}
 		}
 
+		if ( !obj["udp"].isNull() )
+		{
+			const QJsonArray & addr = obj["udp"].toArray();
+			for (const auto& entry : addr)
+			{
+				addUdpSlave(entry.toString());
+			}
+		}
+
 		if (!_jsonSlaves.isEmpty() && obj["enable"].toBool() && _forwarder_enabled)
 		{
 			InfoIf(obj["enable"].toBool(true), _log, "Forward now to json targets '%s'", QSTRING_CSTR(_jsonSlaves.join(", ")));
@@ -80,11 +105,15 @@ void MessageForwarder::handleSettingsUpdate(const settings::type &type, const QJ
 		} else if (_jsonSlaves.isEmpty() || ! obj["enable"].toBool() || !_forwarder_enabled)
 			disconnect(_hyperion, &Hyperion::forwardJsonMessage, 0, 0);
 
-		if (!_flatSlaves.isEmpty() && obj["enable"].toBool() && _forwarder_enabled)
+		if ((!_flatSlaves.isEmpty() || !_udpSlaves.isEmpty()) && obj["enable"].toBool() && _forwarder_enabled)
 		{
-			InfoIf(obj["enable"].toBool(true), _log, "Forward now to flatbuffer targets '%s'", QSTRING_CSTR(_flatSlaves.join(", ")));
+			InfoIf(!_flatSlaves.isEmpty(), _log, "Forward now to flatbuffer targets '%s'", QSTRING_CSTR(_flatSlaves.join(", ")));
+			InfoIf(!_udpSlaves.isEmpty(), _log, "Forward now to UDP targets '%s'", QSTRING_CSTR(_udpSlaves.join(", ")));
+
+			// the targets are new, the visible priority isn't
+			handlePriorityChanges(quint8(_muxer->getCurrentPriority()));
 		}
-		else if ( _flatSlaves.isEmpty() || ! obj["enable"].toBool() || !_forwarder_enabled)
+		else
 		{
 			disconnect(_hyperion, &Hyperion::forwardSystemProtoMessage, 0, 0);
 			disconnect(_hyperion, &Hyperion::forwardV4lProtoMessage, 0, 0);
@@ -111,22 +140,10 @@ void MessageForwarder::handlePriorityChanges(const quint8 &priority)
 	const QJsonObject obj = _hyperion->getSetting(settings::NETFORWARD).object();
 	if (priority != 0 && _forwarder_enabled && obj["enable"].toBool())
 	{
-		_flatSlaves.clear();
-		while (!_forwardClients.isEmpty())
-			delete _forwardClients.takeFirst();
-
+		// the connections to the targets persist, only the source of the forwarded images changes
 		hyperion::Components activeCompId = _hyperion->getPriorityInfo(priority).componentId;
 		if (activeCompId == hyperion::COMP_GRABBER || activeCompId == hyperion::COMP_V4L)
 		{
-			if ( !obj["proto"].isNull() )
-			{
-				const QJsonArray & addr = obj["proto"].toArray();
-				for (const auto& entry : addr)
-				{
-					addFlatbufferSlave(entry.toString());
-				}
-			}
-
 			switch(activeCompId)
 			{
 				case hyperion::COMP_GRABBER:
@@ -182,7 +199,17 @@ void MessageForwarder::addJsonSlave(QString slave)
 	}
 
 	if (_forwarder_enabled)
+	{
 		_jsonSlaves << slave;
+
+		// connected with the first message and kept open
+		JsonTarget* target = new JsonTarget{ new QTcpSocket(this), parts[0], parts[1].toUShort(), QList<QByteArray>() };
+		connect(target->socket, &QTcpSocket::connected, this, [=]() { sendJsonMessages(target); });
+		connect(target->socket, &QTcpSocket::bytesWritten, this, [=]() { sendJsonMessages(target); });
+		// the replies are not evaluated
+		connect(target->socket, &QTcpSocket::readyRead, this, [=]() { target->socket->readAll(); });
+		_jsonTargets << target;
+	}
 }
 
 void MessageForwarder::addFlatbufferSlave(QString slave)
@@ -218,73 +245,200 @@ void MessageForwarder::addFlatbufferSlave(QString slave)
 	}
 }
 
-void MessageForwarder::forwardJsonMessage(const QJsonObject &message)
+void MessageForwarder::addUdpSlave(QString slave)
 {
-	if (_forwarder_enabled)
+	QStringList parts = slave.split(":");
+	if (parts.size() != 2 || QHostAddress(parts[0]).isNull())
 	{
-		QTcpSocket client;
-		for (int i=0; i<_jsonSlaves.size(); i++)
-		{
-			QStringList parts = _jsonSlaves.at(i).split(":");
-			client.connectToHost(QHostAddress(parts[0]), parts[1].toUShort());
-			if ( client.waitForConnected(500) )
-			{
-				sendJsonMessage(message,&client);
-				client.close();
-			}
-		}
+		Error(_log, "Unable to parse address (%s)",QSTRING_CSTR(slave));
+		return;
+	}
+
+	bool ok;
+	const quint16 port = parts[1].toUShort(&ok);
+	if (!ok)
+	{
+		Error(_log, "Unable to parse port number (%s)",QSTRING_CSTR(parts[1]));
+		return;
+	}
+
+	// verify loop with flatbuffer server
+	const QJsonObject &obj = _hyperion->getSetting(settings::FLATBUFSERVER).object();
+	if(QHostAddress(parts[0]) == QHostAddress::LocalHost && port == obj["port"].toInt())
+	{
+		Error(_log, "Loop between Flatbuffer Server and Forwarder! (%s)",QSTRING_CSTR(slave));
+		return;
 	}
-}
 
-void MessageForwarder::forwardFlatbufferMessage(const QString& name, const Image<ColorRgb> &image)
-{
 	if (_forwarder_enabled)
 	{
-		for (int i=0; i < _forwardClients.size(); i++)
-			_forwardClients.at(i)->setImage(image);
+		if (_udpSocket == nullptr)
+		{
+			_udpSocket = new QUdpSocket(this);
+			_udpSocket->bind(QHostAddress::AnyIPv4, 0);
+			// the flatbuffer server of this host may be in the multicast group as well
+			_udpSocket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 0);
+		}
+
+		_udpSlaves << slave;
+		_udpTargets << qMakePair(QHostAddress(parts[0]), port);
+		_udpRegistered.invalidate();
 	}
 }
 
-void MessageForwarder::sendJsonMessage(const QJsonObject &message, QTcpSocket *socket)
+void MessageForwarder::forwardJsonMessage(const QJsonObject &message)
 {
+	if (!_forwarder_enabled || _jsonTargets.isEmpty())
+		return;
+
 	// for hyperion classic compatibility
 	QJsonObject jsonMessage = message;
 	if (jsonMessage.contains("tan") && jsonMessage["tan"].isNull())
 		jsonMessage["tan"] = 100;
 
-	// serialize message
+	// serialize message once for all targets
 	QJsonDocument writer(jsonMessage);
-	QByteArray serializedMessage = writer.toJson(QJsonDocument::Compact) + "\n";
+	const QByteArray serializedMessage = writer.toJson(QJsonDocument::Compact) + "\n";
+
+	for (JsonTarget* target : _jsonTargets)
+	{
+		if (target->queue.size() >= MAX_QUEUED_JSON_MESSAGES)
+		{
+			target->queue.removeFirst();
+		}
+		target->queue.append(serializedMessage);
+		sendJsonMessages(target);
+	}
+}
 
-	// write message
-	socket->write(serializedMessage);
-	if (!socket->waitForBytesWritten())
+void MessageForwarder::sendJsonMessages(JsonTarget* target)
+{
+	QTcpSocket* socket = target->socket;
+	if (socket->state() == QAbstractSocket::UnconnectedState)
 	{
-		Debug(_log, "Error while writing data to host");
+		socket->connectToHost(target->host, target->port);
 		return;
 	}
 
-	// read reply data
-	QByteArray serializedReply;
-	while (!serializedReply.contains('\n'))
+	// the queued messages are written as one batch once the previous one was sent
+	if (socket->state() == QAbstractSocket::ConnectedState && socket->bytesToWrite() == 0 && !target->queue.isEmpty())
 	{
-		// receive reply
-		if (!socket->waitForReadyRead())
+		for (const QByteArray& message : target->queue)
 		{
-			Debug(_log, "Error while writing data from host");
-			return;
+			socket->write(message);
 		}
+		target->queue.clear();
+	}
+}
+
+void MessageForwarder::forwardFlatbufferMessage(const QString& name, const Image<ColorRgb> &image)
+{
+	if (!_forwarder_enabled || (_forwardClients.isEmpty() && _udpTargets.isEmpty()))
+		return;
 
-		serializedReply += socket->readAll();
+	if (!_udpTargets.isEmpty() && (!_udpRegistered.isValid() || _udpRegistered.elapsed() >= UDP_REGISTER_INTERVAL))
+	{
+		registerUdpTargets();
 	}
 
-	// parse reply data
-	QJsonParseError error;
-	QJsonDocument reply = QJsonDocument::fromJson(serializedReply ,&error);
+	// the TCP targets get raw images, every server decodes them
+	if (!_forwardClients.isEmpty())
+	{
+		encodeImage(image, false);
+		const uint8_t* buffer = _builder.GetBufferPointer();
+		const uint32_t size = _builder.GetSize();
 
-	if (error.error != QJsonParseError::NoError)
+		// a target still busy with the previous image keeps the newest one until it is done
+		for (FlatBufferConnection* client : _forwardClients)
+		{
+			client->sendImageMessage(buffer, size);
+		}
+	}
+
+	if (!_udpTargets.isEmpty())
 	{
-		Error(_log, "Error while parsing reply: invalid json");
-		return;
+		// the raw request is reused if it fits into a datagram, larger images are compressed
+		if (_builder.GetSize() == 0 || _builder.GetSize() > MAX_DATAGRAM_SIZE)
+		{
+			_builder.Clear();
+			encodeImage(image, image.size() + REQUEST_OVERHEAD > MAX_DATAGRAM_SIZE);
+		}
+
+		const uint8_t* buffer = _builder.GetBufferPointer();
+		const uint32_t size = _builder.GetSize();
+		if (size <= MAX_DATAGRAM_SIZE)
+		{
+			for (const auto& target : _udpTargets)
+			{
+				_udpSocket->writeDatagram(reinterpret_cast<const char*>(buffer), size, target.first, target.second);
+			}
+		}
+		else if (!_udpOversizeLogged)
+		{
+			Warning(_log, "Image of %u bytes exceeds the size of a datagram, it is not forwarded to the UDP targets", size);
+			_udpOversizeLogged = true;
+		}
+	}
+
+	_builder.Clear();
+}
+
+void MessageForwarder::encodeImage(const Image<ColorRgb> &image, bool compressed)
+{
+	const uint8_t* pixels = reinterpret_cast<const uint8_t*>(image.memptr());
+	flatbuffers::Offset<void> imageData;
+	hyperionnet::ImageType imageType;
+
+	if (compressed)
+	{
+		const QByteArray data = qCompress(pixels, int(image.size()), 1);
+		auto vector = _builder.CreateVector(reinterpret_cast<const uint8_t*>(data.constData()), data.size());
+		imageData = hyperionnet::CreateCompressedImage(_builder, vector, image.width(), image.height()).Union();
+		imageType = hyperionnet::ImageType_CompressedImage;
+	}
+	else
+	{
+		auto data = _builder.CreateVector(pixels, image.size());
+		imageData = hyperionnet::CreateRawImage(_builder, data, image.width(), image.height()).Union();
+		imageType = hyperionnet::ImageType_RawImage;
+	}
+
+	auto imageReq = hyperionnet::CreateImage(_builder, imageType, imageData, -1);
+	auto req = hyperionnet::CreateRequest(_builder, hyperionnet::Command_Image, imageReq.Union());
+	_builder.Finish(req);
+}
+
+void MessageForwarder::registerUdpTargets()
+{
+	auto registerReq = hyperionnet::CreateRegister(_builder, _builder.CreateString("Forwarder"), _priority);
+	auto req = hyperionnet::CreateRequest(_builder, hyperionnet::Command_Register, registerReq.Union());
+	_builder.Finish(req);
+
+	for (const auto& target : _udpTargets)
+	{
+		_udpSocket->writeDatagram(reinterpret_cast<const char*>(_builder.GetBufferPointer()), _builder.GetSize(), target.first, target.second);
+	}
+
+	_builder.Clear();
+	_udpRegistered.start();
+}
+
+void MessageForwarder::clearTargets()
+{
+	_jsonSlaves.clear();
+	for (JsonTarget* target : _jsonTargets)
+	{
+		// no more signals to the deleted target
+		disconnect(target->socket, nullptr, this, nullptr);
+		target->socket->deleteLater();
+		delete target;
 	}
+	_jsonTargets.clear();
+
+	_flatSlaves.clear();
+	while (!_forwardClients.isEmpty())
+		delete _forwardClients.takeFirst();
+
+	_udpSlaves.clear();
+	_udpTargets.clear();
 }
@@ -2,8 +2,23 @@
 #include <utils/Logger.h>
 #include <hyperion/MultiColorAdjustment.h>
 
+namespace {
+
+///
+/// x / 65025 for x < 2^24 as multiplication, the products of three 8-bit channels stay below that
+///
+inline uint32_t div65025(const uint32_t x)
+{
+	return uint32_t((uint64_t(x) * 16909061) >> 40);
+}
+
+}
+
 MultiColorAdjustment::MultiColorAdjustment(const unsigned ledCnt)
 	: _ledAdjustments(ledCnt, nullptr)
+	, _tables()
+	, _ledTables()
+	, _tablesValid(false)
 	, _log(Logger::getInstance("ADJUSTMENT"))
 {
 }
@@ -21,6 +36,7 @@ void MultiColorAdjustment::addAdjustment(ColorAdjustment * adjustment)
 {
 	_adjustmentIds.push_back(adjustment->_id);
 	_adjustment.push_back(adjustment);
+	_tablesValid = false;
 }
 
 void MultiColorAdjustment::setAdjustmentForLed(const QString& id, const unsigned startLed, unsigned endLed)
@@ -44,6 +60,7 @@ void MultiColorAdjustment::setAdjustmentForLed(const QString& id, const unsigned
 	{
 		_ledAdjustments[iLed] = adjustment;
 	}
+	_tablesValid = false;
 }
 
 bool MultiColorAdjustment::verifyAdjustments() const
@@ -90,13 +107,69 @@ void MultiColorAdjustment::setBacklightEnabled(bool enable)
 	}
 }
 
+void MultiColorAdjustment::invalidateTables()
+{
+	_tablesValid = false;
+}
+
+void MultiColorAdjustment::buildTables()
+{
+	_tables.resize(_adjustment.size());
+	for (size_t i=0; i<_adjustment.size(); ++i)
+	{
+		ColorAdjustment* adjustment = _adjustment[i];
+		uint8_t B_RGB = 0, B_CMY = 0, B_W = 0;
+		adjustment->_rgbTransform.getBrightnessComponents(B_RGB, B_CMY, B_W);
+
+		const RgbChannelAdjustment* corners[8] = {
+			&adjustment->_rgbBlackAdjustment, &adjustment->_rgbRedAdjustment, &adjustment->_rgbGreenAdjustment, &adjustment->_rgbBlueAdjustment,
+			&adjustment->_rgbCyanAdjustment, &adjustment->_rgbMagentaAdjustment, &adjustment->_rgbYellowAdjustment, &adjustment->_rgbWhiteAdjustment };
+		const uint32_t brightness[8] = { 255, B_RGB, B_RGB, B_RGB, B_CMY, B_CMY, B_CMY, B_W };
+
+		AdjustmentTable& table = _tables[i];
+		table.adjustment = adjustment;
+		for (unsigned corner=0; corner<8; ++corner)
+		{
+			const uint32_t adjust[3] = { corners[corner]->getAdjustmentR(), corners[corner]->getAdjustmentG(), corners[corner]->getAdjustmentB() };
+			for (unsigned channel=0; channel<3; ++channel)
+			{
+				// same as RgbChannelAdjustment::apply()
+				for (uint32_t input=0; input<256; ++input)
+				{
+					table.corners[corner][channel][input] = qMin(brightness[corner] * input * adjust[channel] / 65025, uint32_t(UINT8_MAX));
+				}
+			}
+		}
+	}
+
+	_ledTables.assign(_ledAdjustments.size(), nullptr);
+	for (size_t iLed=0; iLed<_ledAdjustments.size(); ++iLed)
+	{
+		for (size_t i=0; i<_adjustment.size(); ++i)
+		{
+			if (_ledAdjustments[iLed] == _adjustment[i])
+			{
+				_ledTables[iLed] = &_tables[i];
+				break;
+			}
+		}
+	}
+
+	_tablesValid = true;
+}
+
 void MultiColorAdjustment::applyAdjustment(std::vector<ColorRgb>& ledColors)
 {
-	const size_t itCnt = qMin(_ledAdjustments.size(), ledColors.size());
+	if (!_tablesValid)
+	{
+		buildTables();
+	}
+
+	const size_t itCnt = qMin(_ledTables.size(), ledColors.size());
 	for (size_t i=0; i<itCnt; ++i)
 	{
-		ColorAdjustment* adjustment = _ledAdjustments[i];
-		if (adjustment == nullptr)
+		const AdjustmentTable* table = _ledTables[i];
+		if (table == nullptr)
 		{
 			// No transform set for this led (do nothing)
 			continue;
@@ -106,39 +179,35 @@ void MultiColorAdjustment::applyAdjustment(std::vector<ColorRgb>& ledColors)
 		uint8_t ored   = color.red;
 		uint8_t ogreen = color.green;
 		uint8_t oblue  = color.blue;
-		uint8_t B_RGB = 0, B_CMY = 0, B_W = 0;
 
-		adjustment->_rgbTransform.transform(ored,ogreen,oblue);
-		adjustment->_rgbTransform.getBrightnessComponents(B_RGB, B_CMY, B_W);
+		table->adjustment->_rgbTransform.transform(ored,ogreen,oblue);
+
+		const uint32_t nrng = (uint32_t) (255-ored)*(255-ogreen);
+		const uint32_t rng  = (uint32_t) (ored)    *(255-ogreen);
+		const uint32_t nrg  = (uint32_t) (255-ored)*(ogreen);
+		const uint32_t rg   = (uint32_t) (ored)    *(ogreen);
+
+		// corner weights in the order of the tables
+		const uint32_t weights[8] = {
+			div65025(nrng*(255-oblue)),	// black
+			div65025(rng *(255-oblue)),	// red
+			div65025(nrg *(255-oblue)),	// green
+			div65025(nrng*(oblue)),		// blue
+			div65025(nrg *(oblue)),		// cyan
+			div65025(rng *(oblue)),		// magenta
+			div65025(rg  *(255-oblue)),	// yellow
+			div65025(rg  *(oblue)) };	// white
+
+		unsigned red = 0, green = 0, blue = 0;
+		for (unsigned corner=0; corner<8; ++corner)
+		{
+			red   += table->corners[corner][0][weights[corner]];
+			green += table->corners[corner][1][weights[corner]];
+			blue  += table->corners[corner][2][weights[corner]];
+		}
 
-		uint32_t nrng = (uint32_t) (255-ored)*(255-ogreen);
-		uint32_t rng  = (uint32_t) (ored)    *(255-ogreen);
-		uint32_t nrg  = (uint32_t) (255-ored)*(ogreen);
-		uint32_t rg   = (uint32_t) (ored)    *(ogreen);
-
-		uint8_t black   = nrng*(255-oblue)/65025;
-		uint8_t red     = rng *(255-oblue)/65025;
-		uint8_t green   = nrg *(255-oblue)/65025;
-		uint8_t blue    = nrng*(oblue)    /65025;
-		uint8_t cyan    = nrg *(oblue)    /65025;
-		uint8_t magenta = rng *(oblue)    /65025;
-		uint8_t yellow  = rg  *(255-oblue)/65025;
-		uint8_t white   = rg  *(oblue)    /65025;
-
-		uint8_t OR, OG, OB, RR, RG, RB, GR, GG, GB, BR, BG, BB;
-		uint8_t CR, CG, CB, MR, MG, MB, YR, YG, YB, WR, WG, WB;
-
-		adjustment->_rgbBlackAdjustment.apply  (black  , 255  , OR, OG, OB);
-		adjustment->_rgbRedAdjustment.apply    (red    , B_RGB, RR, RG, RB);
-		adjustment->_rgbGreenAdjustment.apply  (green  , B_RGB, GR, GG, GB);
-		adjustment->_rgbBlueAdjustment.apply   (blue   , B_RGB, BR, BG, BB);
-		adjustment->_rgbCyanAdjustment.apply   (cyan   , B_CMY, CR, CG, CB);
-		adjustment->_rgbMagentaAdjustment.apply(magenta, B_CMY, MR, MG, MB);
-		adjustment->_rgbYellowAdjustment.apply (yellow , B_CMY, YR, YG, YB);
-		adjustment->_rgbWhiteAdjustment.apply  (white  , B_W  , WR, WG, WB);
-
-		color.red   = OR + RR + GR + BR + CR + MR + YR + WR;
-		color.green = OG + RG + GG + BG + CG + MG + YG + WG;
-		color.blue  = OB + RB + GB + BB + CB + MB + YB + WB;
+		color.red   = uint8_t(red);
+		color.green = uint8_t(green);
+		color.blue  = uint8_t(blue);
 	}
 }
@@ -1,5 +1,6 @@
 // STL includes
 #include <algorithm>
+#include <functional>
 #include <limits>
 
 // qt incl
@@ -20,35 +21,37 @@ PriorityMuxer::PriorityMuxer(int ledCount)
 	, _currentPriority(PriorityMuxer::LOWEST_PRIORITY)
 	, _manualSelectedPriority(256)
 	, _activeInputs()
+	, _emptyFrame(std::make_shared<const InputFrame>(InputFrame{ {}, Image<ColorRgb>(), 0 }))
 	, _lowestPriorityInfo()
 	, _sourceAutoSelectEnabled(true)
-	, _updateTimer(new QTimer())
-	, _timer(new QTimer())
-	, _blockTimer(new QTimer())
+	, _enabled(true)
+	, _timeouts()
+	, _timeoutTimer(new QTimer(this))
+	, _timeRunnerTimer(new QTimer(this))
 {
 	// init lowest priority info
 	_lowestPriorityInfo.priority       = PriorityMuxer::LOWEST_PRIORITY;
 	_lowestPriorityInfo.timeoutTime_ms = -1;
-	_lowestPriorityInfo.ledColors      = std::vector<ColorRgb>(ledCount, {0, 0, 0});
+	_lowestPriorityInfo.frame          = std::make_shared<const InputFrame>(InputFrame{ std::vector<ColorRgb>(ledCount, {0, 0, 0}), Image<ColorRgb>(), 0 });
 	_lowestPriorityInfo.componentId    = hyperion::COMP_COLOR;
 	_lowestPriorityInfo.origin         = "System";
+	_lowestPriorityInfo.smooth_cfg     = SMOOTHING_MODE_DEFAULT;
 	_lowestPriorityInfo.owner          = "";
 
 	_activeInputs[PriorityMuxer::LOWEST_PRIORITY] = _lowestPriorityInfo;
+	openSlot(PriorityMuxer::LOWEST_PRIORITY, _lowestPriorityInfo.frame, -1, SMOOTHING_MODE_DEFAULT);
 
-	// adapt to 1s interval for COLOR and EFFECT timeouts > -1
-	connect(_timer, &QTimer::timeout, this, &PriorityMuxer::timeTrigger);
-	_timer->setSingleShot(true);
-	_blockTimer->setSingleShot(true);
-	// forward timeRunner signal to prioritiesChanged signal & threading workaround
+	// 1s interval for COLOR and EFFECT timeouts > -1
+	connect(_timeRunnerTimer, &QTimer::timeout, this, &PriorityMuxer::timeRunner);
+	_timeRunnerTimer->setInterval(1000);
+	// forward timeRunner signal to prioritiesChanged signal
 	connect(this, &PriorityMuxer::timeRunner, this, &PriorityMuxer::prioritiesChanged);
-	connect(this, &PriorityMuxer::signalTimeTrigger, this, &PriorityMuxer::timeTrigger);
 	connect(this, &PriorityMuxer::activeStateChanged, this, &PriorityMuxer::prioritiesChanged);
 
-	// start muxer timer
-	connect(_updateTimer, &QTimer::timeout, this, &PriorityMuxer::setCurrentTime);
-	_updateTimer->setInterval(250);
-	_updateTimer->start();
+	// the timeout timer fires exactly at the next expiry, no polling
+	connect(_timeoutTimer, &QTimer::timeout, this, &PriorityMuxer::handleTimeouts);
+	_timeoutTimer->setSingleShot(true);
+	_timeoutTimer->setTimerType(Qt::PreciseTimer);
 }
 
 PriorityMuxer::~PriorityMuxer()
@@ -57,7 +60,17 @@ PriorityMuxer::~PriorityMuxer()
 
 void PriorityMuxer::setEnable(const bool& enable)
 {
-	enable ? _updateTimer->start() : _updateTimer->stop();
+	_enabled = enable;
+	if (enable)
+	{
+		// catch up with the timeouts that expired meanwhile
+		handleTimeouts();
+	}
+	else
+	{
+		_timeoutTimer->stop();
+		_timeRunnerTimer->stop();
+	}
 }
 
 bool PriorityMuxer::setSourceAutoSelectEnabled(const bool& enable, const bool& update)
@@ -98,13 +111,23 @@ bool PriorityMuxer::setPriority(const uint8_t priority)
 
 void PriorityMuxer::updateLedColorsLength(const int& ledCount)
 {
-	for (auto infoIt = _activeInputs.begin(); infoIt != _activeInputs.end();)
+	for (auto infoIt = _activeInputs.begin(); infoIt != _activeInputs.end(); ++infoIt)
 	{
-		if (infoIt->ledColors.size() >= 1)
+		InputSlot* input = slot(infoIt.key());
+		const InputFramePtr frame = std::atomic_load(&input->frame);
+		if (frame->ledColors.size() >= 1)
 		{
-			infoIt->ledColors.resize(ledCount, infoIt->ledColors.at(0));
+			// frames are immutable, publish a resized copy
+			InputFrame resized = *frame;
+			resized.ledColors.resize(ledCount, frame->ledColors.at(0));
+			const InputFramePtr resizedFrame = std::make_shared<const InputFrame>(std::move(resized));
+			std::atomic_store(&input->frame, resizedFrame);
+
+			if (infoIt.key() == PriorityMuxer::LOWEST_PRIORITY)
+			{
+				_lowestPriorityInfo.frame = resizedFrame;
+			}
 		}
-		++infoIt;
 	}
 }
 
@@ -115,7 +138,12 @@ QList<int> PriorityMuxer::getPriorities() const
 
 bool PriorityMuxer::hasPriority(const int priority) const
 {
-	return (priority == PriorityMuxer::LOWEST_PRIORITY) ? true : _activeInputs.contains(priority);
+	if (priority == PriorityMuxer::LOWEST_PRIORITY)
+	{
+		return true;
+	}
+	const InputSlot* input = slot(priority);
+	return input != nullptr && input->registered.load();
 }
 
 const PriorityMuxer::InputInfo PriorityMuxer::getInputInfo(const int priority) const
@@ -130,11 +158,122 @@ const PriorityMuxer::InputInfo PriorityMuxer::getInputInfo(const int priority) c
 			return _lowestPriorityInfo;
 		}
 	}
-	return elemIt.value();
+
+	// the descriptive part is kept in the map, the data in the slot
+	InputInfo info = elemIt.value();
+	const InputSlot* input = slot(info.priority);
+	info.timeoutTime_ms = input->timeoutTime_ms.load();
+	info.frame          = std::atomic_load(&input->frame);
+	if (!info.frame)
+	{
+		// closed in the meantime
+		info.frame = _emptyFrame;
+	}
+	return info;
+}
+
+PriorityMuxer::InputFramePtr PriorityMuxer::getInputFrame(const int priority) const
+{
+	const InputSlot* input = slot(priority);
+	if (input == nullptr || !input->registered.load())
+	{
+		input = slot(PriorityMuxer::LOWEST_PRIORITY);
+	}
+	InputFramePtr frame = std::atomic_load(&input->frame);
+	if (!frame)
+	{
+		// removed in the meantime
+		frame = std::atomic_load(&slot(PriorityMuxer::LOWEST_PRIORITY)->frame);
+	}
+	return frame ? frame : _emptyFrame;
+}
+
+unsigned PriorityMuxer::getSmoothingConfig(const int priority) const
+{
+	const InputSlot* input = slot(priority);
+	return (input != nullptr && input->registered.load()) ? input->smooth_cfg.load() : unsigned(SMOOTHING_MODE_DEFAULT);
+}
+
+std::vector<PriorityMuxer::InputLayer> PriorityMuxer::getVisibleLayers() const
+{
+	std::vector<InputLayer> layers;
+	for (int priority = getCurrentPriority(); priority <= PriorityMuxer::LOWEST_PRIORITY; ++priority)
+	{
+		const InputSlot* input = slot(priority);
+		if (!input->registered.load() || input->timeoutTime_ms.load() == -100)
+		{
+			continue;
+		}
+
+		const InputFramePtr frame = std::atomic_load(&input->frame);
+		if (!frame)
+		{
+			continue;
+		}
+
+		const InputBlendPtr blend = std::atomic_load(&input->blend);
+		layers.push_back({ priority, frame, blend });
+		if (!blend)
+		{
+			break;
+		}
+	}
+
+	if (layers.empty())
+	{
+		layers.push_back({ PriorityMuxer::LOWEST_PRIORITY, getInputFrame(PriorityMuxer::LOWEST_PRIORITY), nullptr });
+	}
+	return layers;
+}
+
+bool PriorityMuxer::isVisible(const int priority) const
+{
+	const int current = getCurrentPriority();
+	if (priority == current)
+	{
+		return true;
+	}
+	if (priority < current || slot(priority) == nullptr)
+	{
+		return false;
+	}
+
+	// hidden when an active opaque input lies in between
+	for (int above = current; above < priority; ++above)
+	{
+		const InputSlot* input = slot(above);
+		if (input->registered.load() && input->timeoutTime_ms.load() != -100 && !std::atomic_load(&input->blend))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PriorityMuxer::setInputBlend(const int priority, const uint8_t alpha, const std::vector<uint8_t>& ledMask)
+{
+	if (!hasPriority(priority))
+	{
+		return false;
+	}
+
+	InputBlendPtr blend;
+	if (alpha < 255 || !ledMask.empty())
+	{
+		blend = std::make_shared<const InputBlend>(InputBlend{ alpha, ledMask });
+	}
+	std::atomic_store(&slot(priority)->blend, blend);
+	return true;
 }
 
 void PriorityMuxer::registerInput(const int priority, const hyperion::Components& component, const QString& origin, const QString& owner, unsigned smooth_cfg)
 {
+	if (slot(priority) == nullptr)
+	{
+		Error(_log, "Can't register input '%s' with invalid priority %d", QSTRING_CSTR(origin), priority);
+		return;
+	}
+
 	// detect new registers
 	bool newInput = false;
 	if(!_activeInputs.contains(priority))
@@ -142,7 +281,6 @@ void PriorityMuxer::registerInput(const int priority, const hyperion::Components
 
 	InputInfo& input     = _activeInputs[priority];
 	input.priority       = priority;
-	input.timeoutTime_ms = newInput ? -100 : input.timeoutTime_ms;
 	input.componentId    = component;
 	input.origin         = origin;
 	input.smooth_cfg     = smooth_cfg;
@@ -150,16 +288,20 @@ void PriorityMuxer::registerInput(const int priority, const hyperion::Components
 
 	if(newInput)
 	{
+		openSlot(priority, _emptyFrame, -100, smooth_cfg);
+
 		Debug(_log,"Register new input '%s/%s' with priority %d as inactive", QSTRING_CSTR(origin), hyperion::componentToIdString(component), priority);
 		emit priorityChanged(priority, true);
 		emit prioritiesChanged();
 		return;
 	}
+
+	slot(priority)->smooth_cfg.store(smooth_cfg);
 }
 
 bool PriorityMuxer::setInput(const int priority, const std::vector<ColorRgb>& ledColors, int64_t timeout_ms)
 {
-	if(!_activeInputs.contains(priority))
+	if(!hasPriority(priority))
 	{
 		Error(_log,"setInput() used without registerInput() for priority '%d', probably the priority reached timeout",priority);
 		return false;
@@ -169,37 +311,13 @@ bool PriorityMuxer::setInput(const int priority, const std::vector<ColorRgb>& le
 	if(timeout_ms > 0)
 		timeout_ms = QDateTime::currentMSecsSinceEpoch() + timeout_ms;
 
-	InputInfo& input     = _activeInputs[priority];
-	// detect active <-> inactive changes
-	bool activeChange = false;
-	bool active = true;
-	if(input.timeoutTime_ms == -100 && timeout_ms != -100)
-	{
-		activeChange = true;
-	}
-	else if(timeout_ms == -100 && input.timeoutTime_ms != -100)
-	{
-		active = false;
-		activeChange = true;
-	}
-	// update input
-	input.timeoutTime_ms = timeout_ms;
-	input.ledColors      = ledColors;
-	input.image.clear();
-
-	// emit active change
-	if(activeChange)
-	{
-		Debug(_log, "Priority %d is now %s", priority, active ? "active" : "inactive");
-		emit activeStateChanged(priority, active);
-		setCurrentTime();
-	}
+	publish(priority, std::make_shared<const InputFrame>(InputFrame{ ledColors, Image<ColorRgb>(), 0 }), timeout_ms);
 	return true;
 }
 
-bool PriorityMuxer::setInputImage(const int priority, const Image<ColorRgb>& image, int64_t timeout_ms)
+bool PriorityMuxer::setInputImage(const int priority, const Image<ColorRgb>& image, int64_t timeout_ms, bool* unchanged)
 {
-	if(!_activeInputs.contains(priority))
+	if(!hasPriority(priority))
 	{
 		Error(_log,"setInputImage() used without registerInput() for priority '%d', probably the priority reached timeout",priority);
 		return false;
@@ -209,30 +327,15 @@ bool PriorityMuxer::setInputImage(const int priority, const Image<ColorRgb>& ima
 	if(timeout_ms > 0)
 		timeout_ms = QDateTime::currentMSecsSinceEpoch() + timeout_ms;
 
-	InputInfo& input     = _activeInputs[priority];
-	// detect active <-> inactive changes
-	bool activeChange = false;
-	bool active = true;
-	if(input.timeoutTime_ms == -100 && timeout_ms != -100)
-	{
-		activeChange = true;
-	}
-	else if(timeout_ms == -100 && input.timeoutTime_ms != -100)
-	{
-		active = false;
-		activeChange = true;
-	}
-	// update input
-	input.timeoutTime_ms = timeout_ms;
-	input.image          = image;
-	input.ledColors.clear();
+	// the fingerprint is shared with all instances that receive the same frame
+	const uint64_t fingerprint = image.fingerprint();
+	const bool wasActive = slot(priority)->timeoutTime_ms.load() != -100;
+	const InputFramePtr previous = publish(priority, std::make_shared<const InputFrame>(InputFrame{ {}, image, fingerprint }), timeout_ms);
 
-	// emit active change
-	if(activeChange)
+	if (unchanged != nullptr)
 	{
-		Debug(_log, "Priority %d is now %s", priority, active ? "active" : "inactive");
-		emit activeStateChanged(priority, active);
-		setCurrentTime();
+		const bool activeChange = wasActive != (timeout_ms != -100);
+		*unchanged = !activeChange && fingerprint != 0 && previous && fingerprint == previous->imageFingerprint;
 	}
 	return true;
 }
@@ -247,9 +350,11 @@ bool PriorityMuxer::clearInput(const uint8_t priority)
 {
 	if (priority < PriorityMuxer::LOWEST_PRIORITY && _activeInputs.remove(priority))
 	{
+		closeSlot(priority);
 		Debug(_log,"Removed source priority %d",priority);
 		// on clear success update _currentPriority
 		setCurrentTime();
+		armTimers();
 		emit priorityChanged(priority, false);
 		emit prioritiesChanged();
 		return true;
@@ -261,9 +366,16 @@ void PriorityMuxer::clearAll(bool forceClearAll)
 {
 	if (forceClearAll)
 	{
+		for (auto key : _activeInputs.keys())
+		{
+			closeSlot(key);
+		}
 		_activeInputs.clear();
 		_currentPriority = PriorityMuxer::LOWEST_PRIORITY;
-		_activeInputs[_currentPriority] = _lowestPriorityInfo;
+		_activeInputs[PriorityMuxer::LOWEST_PRIORITY] = _lowestPriorityInfo;
+		openSlot(PriorityMuxer::LOWEST_PRIORITY, _lowestPriorityInfo.frame, -1, SMOOTHING_MODE_DEFAULT);
+		_timeouts.clear();
+		armTimers();
 	}
 	else
 	{
@@ -280,32 +392,14 @@ void PriorityMuxer::clearAll(bool forceClearAll)
 
 void PriorityMuxer::setCurrentTime(void)
 {
-	const int64_t now = QDateTime::currentMSecsSinceEpoch();
 	int newPriority;
 	_activeInputs.contains(0) ? newPriority = 0 : newPriority = PriorityMuxer::LOWEST_PRIORITY;
 
-	for (auto infoIt = _activeInputs.begin(); infoIt != _activeInputs.end();)
+	for (auto infoIt = _activeInputs.begin(); infoIt != _activeInputs.end(); ++infoIt)
 	{
-		if (infoIt->timeoutTime_ms > 0 && infoIt->timeoutTime_ms <= now)
-		{
-			quint8 tPrio = infoIt->priority;
-			infoIt = _activeInputs.erase(infoIt);
-			Debug(_log,"Timeout clear for priority %d",tPrio);
-			emit priorityChanged(tPrio, false);
-			emit prioritiesChanged();
-		}
-		else
-		{
-			// timeoutTime of -100 is awaiting data (inactive); skip
-			if(infoIt->timeoutTime_ms > -100)
-				newPriority = qMin(newPriority, infoIt->priority);
-
-			// call timeTrigger when effect or color is running with timeout > 0, blacklist prio 255
-			if(infoIt->priority < 254 && infoIt->timeoutTime_ms > 0 && (infoIt->componentId == hyperion::COMP_EFFECT || infoIt->componentId == hyperion::COMP_COLOR  || infoIt->componentId == hyperion::COMP_IMAGE))
-				emit signalTimeTrigger(); // as signal to prevent Threading issues
-
-			++infoIt;
-		}
+		// timeoutTime of -100 is awaiting data (inactive); skip
+		if(slot(infoIt->priority)->timeoutTime_ms.load() > -100)
+			newPriority = qMin(newPriority, infoIt->priority);
 	}
 	// eval if manual selected prio is still available
 	if(!_sourceAutoSelectEnabled)
@@ -322,11 +416,7 @@ void PriorityMuxer::setCurrentTime(void)
 		}
 	}
 	// apply & emit on change (after apply!)
-	bool changed = false;
-	if(_currentPriority != newPriority)
-		changed = true;
-
-	_currentPriority = newPriority;
+	const bool changed = _currentPriority.exchange(newPriority) != newPriority;
 
 	if(changed)
 	{
@@ -336,15 +426,174 @@ void PriorityMuxer::setCurrentTime(void)
 	}
 }
 
-void PriorityMuxer::timeTrigger()
+PriorityMuxer::InputSlot* PriorityMuxer::slot(const int priority)
+{
+	return (priority >= 0 && priority <= PriorityMuxer::LOWEST_PRIORITY) ? &_slots[priority] : nullptr;
+}
+
+const PriorityMuxer::InputSlot* PriorityMuxer::slot(const int priority) const
+{
+	return (priority >= 0 && priority <= PriorityMuxer::LOWEST_PRIORITY) ? &_slots[priority] : nullptr;
+}
+
+PriorityMuxer::InputFramePtr PriorityMuxer::publish(const int priority, const InputFramePtr& frame, int64_t timeout_ms)
+{
+	InputSlot* input = slot(priority);
+
+	// the frame is visible before the timeout that may activate it
+	const InputFramePtr previous = std::atomic_exchange(&input->frame, frame);
+	const int64_t previousTimeout = input->timeoutTime_ms.exchange(timeout_ms);
+
+	// queue a timeout that expires before the queued entry, an extended timeout doesn't need the muxer thread
+	if (timeout_ms > 0)
+	{
+		const int64_t scheduled_ms = input->scheduledTimeout_ms.load();
+		if (scheduled_ms == 0 || timeout_ms < scheduled_ms)
+		{
+			QMetaObject::invokeMethod(this, "scheduleTimeout", Q_ARG(int, priority));
+		}
+	}
+
+	// detect active <-> inactive changes
+	const bool active = (timeout_ms != -100);
+	if (active != (previousTimeout != -100))
+	{
+		Debug(_log, "Priority %d is now %s", priority, active ? "active" : "inactive");
+		emit activeStateChanged(priority, active);
+		// the selection belongs to the muxer thread, direct call when published from there
+		QMetaObject::invokeMethod(this, "setCurrentTime");
+	}
+	return previous;
+}
+
+void PriorityMuxer::openSlot(const int priority, const InputFramePtr& frame, int64_t timeout_ms, unsigned smooth_cfg)
+{
+	InputSlot* input = slot(priority);
+	std::atomic_store(&input->frame, frame);
+	std::atomic_store(&input->blend, InputBlendPtr());
+	input->timeoutTime_ms.store(timeout_ms);
+	input->scheduledTimeout_ms.store(0);
+	input->smooth_cfg.store(smooth_cfg);
+	input->registered.store(true);
+}
+
+void PriorityMuxer::closeSlot(const int priority)
 {
-	if(_blockTimer->isActive())
+	InputSlot* input = slot(priority);
+	input->registered.store(false);
+	input->timeoutTime_ms.store(-100);
+	input->scheduledTimeout_ms.store(0);
+	std::atomic_store(&input->frame, InputFramePtr());
+	std::atomic_store(&input->blend, InputBlendPtr());
+}
+
+void PriorityMuxer::scheduleTimeout(const int priority)
+{
+	InputSlot* input = slot(priority);
+	const int64_t timeout_ms = input->timeoutTime_ms.load();
+	const int64_t scheduled_ms = input->scheduledTimeout_ms.load();
+
+	// a later timeout is picked up when the queued entry expires
+	if (!input->registered.load() || timeout_ms <= 0 || (scheduled_ms > 0 && scheduled_ms <= timeout_ms))
 	{
-		_timer->start(500);
+		return;
 	}
-	else
+
+	input->scheduledTimeout_ms.store(timeout_ms);
+	_timeouts.push_back(std::make_pair(timeout_ms, priority));
+	std::push_heap(_timeouts.begin(), _timeouts.end(), std::greater<std::pair<int64_t, int>>());
+	armTimers();
+}
+
+void PriorityMuxer::handleTimeouts()
+{
+	if (!_enabled)
+	{
+		return;
+	}
+
+	const int64_t now = QDateTime::currentMSecsSinceEpoch();
+	bool expired = false;
+
+	while (!_timeouts.empty() && _timeouts.front().first <= now)
+	{
+		const std::pair<int64_t, int> entry = _timeouts.front();
+		std::pop_heap(_timeouts.begin(), _timeouts.end(), std::greater<std::pair<int64_t, int>>());
+		_timeouts.pop_back();
+
+		InputSlot* input = slot(entry.second);
+		if (input->scheduledTimeout_ms.load() != entry.first)
+		{
+			// outdated entry of a removed or rescheduled priority
+			continue;
+		}
+		input->scheduledTimeout_ms.store(0);
+
+		const int64_t timeout_ms = input->timeoutTime_ms.load();
+		if (timeout_ms > 0 && timeout_ms <= now && _activeInputs.remove(entry.second))
+		{
+			closeSlot(entry.second);
+			expired = true;
+			Debug(_log,"Timeout clear for priority %d",entry.second);
+			emit priorityChanged(entry.second, false);
+			emit prioritiesChanged();
+		}
+		else if (timeout_ms > 0)
+		{
+			// extended in the meantime
+			scheduleTimeout(entry.second);
+		}
+	}
+
+	if (expired)
+	{
+		setCurrentTime();
+	}
+	armTimers();
+}
+
+void PriorityMuxer::armTimers()
+{
+	if (!_enabled)
+	{
+		return;
+	}
+
+	bool timeRunner = false;
+	for (const auto& entry : _timeouts)
 	{
-		emit timeRunner();
-		_blockTimer->start(1000);
+		// blacklist prio 254/255
+		auto infoIt = _activeInputs.find(entry.second);
+		if (entry.second < 254 && infoIt != _activeInputs.end() && slot(entry.second)->scheduledTimeout_ms.load() == entry.first &&
+			(infoIt->componentId == hyperion::COMP_EFFECT || infoIt->componentId == hyperion::COMP_COLOR || infoIt->componentId == hyperion::COMP_IMAGE))
+		{
+			timeRunner = true;
+			break;
+		}
 	}
+
+	if (timeRunner && !_timeRunnerTimer->isActive())
+	{
+		_timeRunnerTimer->start();
+	}
+	else if (!timeRunner)
+	{
+		_timeRunnerTimer->stop();
+	}
+
+	// don't wake up for outdated entries
+	while (!_timeouts.empty() && slot(_timeouts.front().second)->scheduledTimeout_ms.load() != _timeouts.front().first)
+	{
+		std::pop_heap(_timeouts.begin(), _timeouts.end(), std::greater<std::pair<int64_t, int>>());
+		_timeouts.pop_back();
+	}
+
+	if (_timeouts.empty())
+	{
+		_timeoutTimer->stop();
+		return;
+	}
+
+	const int64_t delay = _timeouts.front().first - QDateTime::currentMSecsSinceEpoch();
+	_timeoutTimer->start(int(qBound(int64_t(0), delay, int64_t(std::numeric_limits<int>::max()))));
 }
@@ -0,0 +1,164 @@
+#include "SmoothingState.h"
+
+#include <utils/PixelKernels.h>
+
+// STL includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Qt includes
+#include <QtGlobal>
+
+namespace {
+
+/// The fixed-point value of the largest 8-bit color value
+const int32_t STATE_MAX = 255 << 8;
+
+///
+/// Fixed-point product (Q16) rounded away from zero, a non zero step always moves the value
+///
+inline int32_t stepAwayFromZero(const int64_t product)
+{
+	return product < 0 ? -int32_t((-product + 0xFFFF) >> 16) : int32_t((product + 0xFFFF) >> 16);
+}
+
+///
+/// Convert a fraction of the distance to the factor of PixelKernels::approach16()
+///
+inline uint16_t approachFactor(const double fraction)
+{
+	return uint16_t(qBound(0.0, fraction * 65536.0, 65535.0));
+}
+
+}
+
+SmoothingState::SmoothingState()
+	: _targetValues()
+	, _targetState()
+	, _state()
+	, _velocity()
+	, _outputValues()
+	, _frameCounter(0)
+{
+}
+
+bool SmoothingState::setTarget(const std::vector<ColorRgb>& ledValues)
+{
+	// not initialized yet or the led layout changed, the state restarts at the target
+	const bool reset = _state.empty() || ledValues.size() != _targetValues.size();
+	if (reset)
+	{
+		_targetValues = ledValues;
+		_targetState.resize(ledValues.size() * 3);
+		_outputValues = ledValues;
+		_velocity.assign(_targetState.size(), 0);
+	}
+	else
+	{
+		memcpy(_targetValues.data(), ledValues.data(), ledValues.size() * sizeof(ColorRgb));
+	}
+
+	const uint8_t* target = reinterpret_cast<const uint8_t*>(_targetValues.data());
+	for (size_t i = 0; i < _targetState.size(); ++i)
+	{
+		_targetState[i] = uint16_t(target[i] << 8);
+	}
+
+	if (reset)
+	{
+		_state = _targetState;
+	}
+
+	return reset;
+}
+
+void SmoothingState::clear()
+{
+	_state.clear();
+}
+
+void SmoothingState::switchOff()
+{
+	std::fill(_targetValues.begin(), _targetValues.end(), ColorRgb::BLACK);
+	std::fill(_targetState.begin(), _targetState.end(), 0);
+	std::fill(_state.begin(), _state.end(), 0);
+	std::fill(_velocity.begin(), _velocity.end(), 0);
+}
+
+void SmoothingState::settle()
+{
+	_state = _targetState;
+}
+
+bool SmoothingState::approach(double fraction)
+{
+	PixelKernels::approach16(_state.data(), _targetState.data(), _state.size(), approachFactor(fraction));
+	return _state == _targetState;
+}
+
+bool SmoothingState::damp(double x)
+{
+	// The velocity is stored divided by omega, so it has the unit of the state and doesn't depend
+	// on the interval:
+	//   c' = (c + (u + c) * x) * exp(-x)
+	//   u' = (u - (u + c) * x) * exp(-x)
+	const double e = std::exp(-x);
+	const int64_t coupling  = int64_t(x * e * 65536.0 + 0.5);
+	const int64_t decay     = int64_t(e * 65536.0 + 0.5) - 65536;
+
+	bool settled = true;
+	for (size_t i = 0; i < _state.size(); ++i)
+	{
+		const int32_t target = _targetState[i];
+		int32_t c = int32_t(_state[i]) - target;
+		int32_t u = _velocity[i];
+		if (c == 0 && u == 0)
+		{
+			continue;
+		}
+
+		const int64_t push = coupling * (int64_t(u) + c);
+		const int32_t dc = stepAwayFromZero(decay * c + push);
+		const int32_t du = stepAwayFromZero(decay * u - push);
+		c = qBound(-target, c + dc, STATE_MAX - target);
+		u += du;
+
+		if (std::abs(c) <= 1 && std::abs(u) <= 1)
+		{
+			c = u = 0;
+		}
+		else
+		{
+			settled = false;
+		}
+
+		_state[i] = uint16_t(target + c);
+		_velocity[i] = u;
+	}
+	return settled;
+}
+
+void SmoothingState::updateOutput(bool dithering)
+{
+	const uint16_t* state = _state.data();
+	uint8_t* output = reinterpret_cast<uint8_t*>(_outputValues.data());
+	const size_t count = _state.size();
+
+	if (dithering)
+	{
+		// ordered dither offset per channel, over 16 updates every channel passes all 16 levels
+		const unsigned phase = 5 * _frameCounter++;
+		for (size_t i = 0; i < count; ++i)
+		{
+			output[i] = uint8_t((state[i] + ((((7 * i) + phase) & 15) << 4) + 8) >> 8);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			output[i] = uint8_t((state[i] + 128) >> 8);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// STL includes
+#include <vector>
+#include <cstdint>
+
+// utils
+#include <utils/ColorRgb.h>
+
+///
+/// The led data of the smoothing as 8.8 fixed-point per color channel. It holds the target, the
+/// current state with the velocity of the damped curve and the 8-bit output of the last update.
+/// The timing of the curves is up to the owner, a step gets the fraction of the remaining distance.
+///
+class SmoothingState
+{
+public:
+	SmoothingState();
+
+	///
+	/// @brief Set new target colors. Before the first target and after a change of the led count
+	/// all buffers are (re)sized and the state starts at the target.
+	/// @param ledValues  The color-value per led
+	/// @return True if the state was reset
+	///
+	bool setTarget(const std::vector<ColorRgb>& ledValues);
+
+	/// @return True if there is no target yet
+	bool empty() const { return _state.empty(); }
+
+	/// Drop the state, the next target starts over
+	void clear();
+
+	/// Set the target, the state and the velocity to black
+	void switchOff();
+
+	/// Jump to the target
+	void settle();
+
+	///
+	/// @brief Move the state by a fraction of the distance to the target
+	/// @param fraction  The fraction [0..1]
+	/// @return True when the target is reached
+	///
+	bool approach(double fraction);
+
+	///
+	/// @brief Exact step of the critically damped spring
+	/// @param x  omega * deltaTime of the step
+	/// @return True when the target is reached and the velocity is zero
+	///
+	bool damp(double x);
+
+	///
+	/// @brief Convert the state to the 8-bit output colors
+	/// @param dithering  Dither the fixed-point fraction over time instead of rounding it
+	///
+	void updateOutput(bool dithering);
+
+	const std::vector<ColorRgb>& targetValues() const { return _targetValues; }
+	const std::vector<ColorRgb>& outputValues() const { return _outputValues; }
+
+private:
+	/// The target led data
+	std::vector<ColorRgb> _targetValues;
+
+	/// The target led data as 8.8 fixed-point per channel
+	std::vector<uint16_t> _targetState;
+
+	/// The smoothed led data as 8.8 fixed-point per channel, empty when not initialized
+	std::vector<uint16_t> _state;
+
+	/// The velocity per channel of the damped curve (8.8 fixed-point per update)
+	std::vector<int32_t> _velocity;
+
+	/// The 8-bit led data of the last update
+	std::vector<ColorRgb> _outputValues;
+
+	/// Update counter, selects the dither pattern
+	unsigned _frameCounter;
+};
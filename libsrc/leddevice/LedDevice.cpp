@@ -5,21 +5,45 @@
 #include <QResource>
 #include <QStringList>
 #include <QDir>
-#include <QDateTime>
 
 #include "hyperion/Hyperion.h"
 #include <utils/JsonUtils.h>
+#include <utils/FrameScheduler.h>
+
+namespace {
+
+/// Interval of the write statistics in the log [us]
+const int64_t STATISTICS_INTERVAL = 10000000;
+
+/// Upper bound of the first write duration histogram bucket [us]
+const int64_t WRITE_HISTOGRAM_BASE = 1000;
+
+}
 
 LedDevice::LedDevice(const QJsonObject& config, QObject* parent)
 	: QObject(parent)
 	, _devConfig(config)
 	, _log(Logger::getInstance("LEDDEVICE"))
 	, _ledBuffer(0)
+	, _packer()
+	, _packedColorOrder(false)
 	, _deviceReady(true)
 	, _refresh_timer()
 	, _refresh_timer_interval(0)
-	, _last_write_time(QDateTime::currentMSecsSinceEpoch())
+	, _last_write_time(FrameScheduler::now())
 	, _latchTime_ms(0)
+	, _queueMutex()
+	, _queue(1)
+	, _queueHead(0)
+	, _queueCount(0)
+	, _queueScheduled(false)
+	, _queuedValues()
+	, _statisticsTime(FrameScheduler::now())
+	, _framesDropped(0)
+	, _framesWritten(0)
+	, _writeTimeSum_us(0)
+	, _writeTimeMax_us(0)
+	, _writeHistogram()
 	, _componentRegistered(false)
 	, _enabled(true)
 {
@@ -73,6 +97,13 @@ bool LedDevice::init(const QJsonObject &deviceConfig)
 	_activeDevice = deviceConfig["type"].toString("file").toLower();
 	setLedCount(deviceConfig["currentLedCount"].toInt(1)); // property injected to reflect real led count
 
+	{
+		// frames waiting for a slow device are dropped beyond this length
+		QMutexLocker lock(&_queueMutex);
+		_queue.assign(qMax(1, deviceConfig["outputQueueLength"].toInt(1)), std::vector<ColorRgb>());
+		_queueHead = _queueCount = 0;
+	}
+
 	_latchTime_ms = deviceConfig["latchTime"].toInt(_latchTime_ms);
 	_refresh_timer.setInterval( deviceConfig["rewriteTime"].toInt( _refresh_timer_interval) );
 	if (_refresh_timer.interval() <= (signed)_latchTime_ms )
@@ -97,17 +128,123 @@ int LedDevice::setLedValues(const std::vector<ColorRgb>& ledValues)
 		_refresh_timer.start();
 	}
 
-	if (_latchTime_ms == 0 || QDateTime::currentMSecsSinceEpoch()-_last_write_time >= _latchTime_ms)
+	if (_latchTime_ms == 0 || FrameScheduler::now() - _last_write_time >= qint64(_latchTime_ms) * 1000)
 	{
 		_ledValues = ledValues;
-		retval = write(ledValues);
-		_last_write_time = QDateTime::currentMSecsSinceEpoch();
+		retval = updateLeds(ledValues);
+		_last_write_time = FrameScheduler::now();
 	}
-	//else Debug(_log, "latch %d", QDateTime::currentMSecsSinceEpoch()-_last_write_time);
+	//else Debug(_log, "latch %lld us", FrameScheduler::now()-_last_write_time);
 
 	return retval;
 }
 
+void LedDevice::setColorOrders(const std::vector<ColorOrder>& orders)
+{
+	_packer.setColorOrders(orders);
+}
+
+int LedDevice::updateLeds(const std::vector<ColorRgb>& ledValues)
+{
+	if (_packedColorOrder || !_packer.isOrdered())
+	{
+		return write(ledValues);
+	}
+
+	_packer.reorder(ledValues, _orderedValues);
+	return write(_orderedValues);
+}
+
+void LedDevice::enqueue(const std::vector<ColorRgb>& ledValues)
+{
+	QMutexLocker lock(&_queueMutex);
+
+	if (_queueCount == _queue.size())
+	{
+		// latest frame wins, the oldest one is late already
+		_queueHead = (_queueHead + 1) % _queue.size();
+		--_queueCount;
+		++_framesDropped;
+	}
+
+	_queue[(_queueHead + _queueCount) % _queue.size()] = ledValues;
+	++_queueCount;
+
+	if (!_queueScheduled)
+	{
+		_queueScheduled = true;
+		QMetaObject::invokeMethod(this, "processQueue", Qt::QueuedConnection);
+	}
+}
+
+void LedDevice::processQueue()
+{
+	for (;;)
+	{
+		{
+			QMutexLocker lock(&_queueMutex);
+			if (_queueCount == 0)
+			{
+				_queueScheduled = false;
+				break;
+			}
+
+			// take the frame without copying, the slot gets the buffer of the previous one
+			_queuedValues.swap(_queue[_queueHead]);
+			_queueHead = (_queueHead + 1) % _queue.size();
+			--_queueCount;
+		}
+
+		const int64_t start = FrameScheduler::now();
+		updateLeds(_queuedValues);
+		const int64_t done = FrameScheduler::now();
+
+		const int64_t duration = done - start;
+		int bucket = 0;
+		while (bucket < WRITE_HISTOGRAM_SIZE - 1 && duration >= (WRITE_HISTOGRAM_BASE << bucket))
+		{
+			++bucket;
+		}
+		++_writeHistogram[bucket];
+		++_framesWritten;
+		_writeTimeSum_us += duration;
+		_writeTimeMax_us = qMax(_writeTimeMax_us, duration);
+
+		if (done - _statisticsTime >= STATISTICS_INTERVAL)
+		{
+			logWriteStatistics(done);
+		}
+	}
+}
+
+void LedDevice::logWriteStatistics(int64_t now)
+{
+	uint32_t dropped;
+	{
+		QMutexLocker lock(&_queueMutex);
+		dropped = _framesDropped;
+		_framesDropped = 0;
+	}
+
+	QString histogram;
+	for (int bucket = 0; bucket < WRITE_HISTOGRAM_SIZE; ++bucket)
+	{
+		if (bucket < WRITE_HISTOGRAM_SIZE - 1)
+			histogram += QString(" <%1ms:%2").arg((WRITE_HISTOGRAM_BASE << bucket) / 1000).arg(_writeHistogram[bucket]);
+		else
+			histogram += QString(" more:%1").arg(_writeHistogram[bucket]);
+		_writeHistogram[bucket] = 0;
+	}
+
+	Debug(_log, "%s: %u frames written, %u dropped, write avg %lld us max %lld us,%s", QSTRING_CSTR(_activeDevice),
+		  _framesWritten, dropped, (long long)(_framesWritten > 0 ? _writeTimeSum_us / _framesWritten : 0), (long long)_writeTimeMax_us, QSTRING_CSTR(histogram));
+
+	_statisticsTime = now;
+	_framesWritten = 0;
+	_writeTimeSum_us = 0;
+	_writeTimeMax_us = 0;
+}
+
 int LedDevice::switchOff()
 {
 	return _deviceReady ? write(std::vector<ColorRgb>(_ledCount, ColorRgb::BLACK )) : -1;
@@ -127,5 +264,5 @@ void LedDevice::setLedCount(int ledCount)
 
 int LedDevice::rewriteLeds()
 {
-	return _enabled ? write(_ledValues) : -1;
+	return _enabled ? updateLeds(_ledValues) : -1;
 }
@@ -21,6 +21,7 @@ LedDeviceWrapper::LedDeviceWrapper(Hyperion* hyperion)
 	, _hyperion(hyperion)
 	, _ledDevice(nullptr)
 	, _enabled(true)
+	, _colorOrders()
 {
 	// prepare the device constrcutor map
 	#define REGISTER(className) LedDeviceWrapper::addToDeviceMap(QString(#className).toLower(), LedDevice##className::construct);
@@ -48,6 +49,7 @@ void LedDeviceWrapper::createLedDevice(const QJsonObject& config)
 	// create thread and device
 	QThread* thread = new QThread(this);
 	_ledDevice = LedDeviceFactory::construct(config);
+	_ledDevice->setColorOrders(_colorOrders);
 	_ledDevice->moveToThread(thread);
 	// setup thread management
 	connect(thread, &QThread::started, _ledDevice, &LedDevice::start);
@@ -55,7 +57,7 @@ void LedDeviceWrapper::createLedDevice(const QJsonObject& config)
 	connect(thread, &QThread::finished, _ledDevice, &LedDevice::deleteLater);
 
 	// further signals
-	connect(this, &LedDeviceWrapper::write, _ledDevice, &LedDevice::write, Qt::QueuedConnection);
+	connect(this, &LedDeviceWrapper::colorOrdersChanged, _ledDevice, &LedDevice::setColorOrders, Qt::QueuedConnection);
 	connect(_hyperion->getMuxerInstance(), &PriorityMuxer::visiblePriorityChanged, _ledDevice, &LedDevice::visiblePriorityChanged, Qt::QueuedConnection);
 	connect(_ledDevice, &LedDevice::enableStateChanged, this, &LedDeviceWrapper::handleInternalEnableState, Qt::QueuedConnection);
 
@@ -125,6 +127,12 @@ const QString & LedDeviceWrapper::getColorOrder()
 	return _ledDevice->getColorOrder();
 }
 
+void LedDeviceWrapper::setColorOrders(const std::vector<ColorOrder>& orders)
+{
+	_colorOrders = orders;
+	emit colorOrdersChanged(_colorOrders);
+}
+
 void LedDeviceWrapper::handleComponentState(const hyperion::Components component, const bool state)
 {
 	if(component == hyperion::COMP_LEDDEVICE)
@@ -135,6 +143,11 @@ void LedDeviceWrapper::handleComponentState(const hyperion::Components component
 	}
 }
 
+void LedDeviceWrapper::write(const std::vector<ColorRgb>& ledValues)
+{
+	_ledDevice->enqueue(ledValues);
+}
+
 void LedDeviceWrapper::handleInternalEnableState(bool newState)
 {
 	_hyperion->setNewComponentState(hyperion::COMP_LEDDEVICE, newState);
@@ -0,0 +1,143 @@
+#include <leddevice/LedPacker.h>
+
+// STL includes
+#include <cstring>
+
+const uint8_t LedPacker::CHANNEL_ORDER[6][3] =
+{
+	{ 0, 1, 2 }, // ORDER_RGB
+	{ 0, 2, 1 }, // ORDER_RBG
+	{ 1, 0, 2 }, // ORDER_GRB
+	{ 2, 0, 1 }, // ORDER_BRG
+	{ 1, 2, 0 }, // ORDER_GBR
+	{ 2, 1, 0 }  // ORDER_BGR
+};
+
+LedPacker::LedPacker()
+	: _orders()
+	, _order(ORDER_RGB)
+	, _ordered(false)
+	, _whiteAlgorithm(RGBW::INVALID)
+	, _prefix(-1)
+	, _encoding()
+{
+}
+
+void LedPacker::setColorOrders(const std::vector<ColorOrder>& orders)
+{
+	_orders.clear();
+	_order = orders.empty() ? ORDER_RGB : orders.front();
+	_ordered = false;
+
+	bool uniform = true;
+	for (const ColorOrder order : orders)
+	{
+		uniform &= (order == _order);
+		_ordered |= (order != ORDER_RGB);
+	}
+
+	// a per led table is only needed for mixed color orders
+	if (!uniform)
+	{
+		_orders.assign(orders.begin(), orders.end());
+	}
+}
+
+void LedPacker::setWhiteAlgorithm(RGBW::WhiteAlgorithm algorithm)
+{
+	_whiteAlgorithm = algorithm;
+}
+
+void LedPacker::setLedPrefix(int prefix)
+{
+	_prefix = prefix;
+}
+
+void LedPacker::setBitPairEncoding(const uint8_t patterns[4])
+{
+	_encoding.resize(256 * 4);
+	for (int value = 0; value < 256; ++value)
+	{
+		for (int pair = 0; pair < 4; ++pair)
+		{
+			_encoding[value * 4 + pair] = patterns[(value >> (6 - 2 * pair)) & 0x3];
+		}
+	}
+}
+
+size_t LedPacker::ledSize() const
+{
+	const size_t channels = (_whiteAlgorithm == RGBW::INVALID) ? 3 : 4;
+	return (_prefix < 0 ? 0 : 1) + channels * (_encoding.empty() ? 1 : 4);
+}
+
+uint8_t* LedPacker::pack(const ColorRgb* colors, size_t count, uint8_t* dest) const
+{
+	const uint8_t* src = reinterpret_cast<const uint8_t*>(colors);
+
+	// plain RGB stream
+	if (!_ordered && _whiteAlgorithm == RGBW::INVALID && _prefix < 0 && _encoding.empty())
+	{
+		memcpy(dest, src, count * 3);
+		return dest + count * 3;
+	}
+
+	const bool rgbw = (_whiteAlgorithm != RGBW::INVALID);
+	const size_t channelCount = rgbw ? 4 : 3;
+	uint8_t channels[4];
+	ColorRgbw white;
+
+	for (size_t i = 0; i < count; ++i, src += 3)
+	{
+		const uint8_t* order = CHANNEL_ORDER[_orders.empty() ? _order : (i < _orders.size() ? _orders[i] : ORDER_RGB)];
+		channels[0] = src[order[0]];
+		channels[1] = src[order[1]];
+		channels[2] = src[order[2]];
+
+		if (rgbw)
+		{
+			RGBW::Rgb_to_Rgbw(ColorRgb{channels[0], channels[1], channels[2]}, &white, _whiteAlgorithm);
+			channels[0] = white.red;
+			channels[1] = white.green;
+			channels[2] = white.blue;
+			channels[3] = white.white;
+		}
+
+		if (_prefix >= 0)
+		{
+			*dest++ = uint8_t(_prefix);
+		}
+
+		if (_encoding.empty())
+		{
+			memcpy(dest, channels, channelCount);
+			dest += channelCount;
+		}
+		else
+		{
+			for (size_t c = 0; c < channelCount; ++c)
+			{
+				memcpy(dest, &_encoding[channels[c] * 4], 4);
+				dest += 4;
+			}
+		}
+	}
+
+	return dest;
+}
+
+void LedPacker::reorder(const std::vector<ColorRgb>& colors, std::vector<ColorRgb>& ordered) const
+{
+	ordered.resize(colors.size());
+
+	const uint8_t* src = reinterpret_cast<const uint8_t*>(colors.data());
+	uint8_t* dest = reinterpret_cast<uint8_t*>(ordered.data());
+
+	for (size_t i = 0; i < colors.size(); ++i, src += 3, dest += 3)
+	{
+		const uint8_t* order = CHANNEL_ORDER[_orders.empty() ? _order : (i < _orders.size() ? _orders[i] : ORDER_RGB)];
+		dest[0] = src[order[0]];
+		dest[1] = src[order[1]];
+		dest[2] = src[order[2]];
+	}
+}
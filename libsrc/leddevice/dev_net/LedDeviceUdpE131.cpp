@@ -27,6 +27,9 @@ bool LedDeviceUdpE131::init(const QJsonObject &deviceConfig)
 		Debug( _log, "e131  cid found, using %s", QSTRING_CSTR(_e131_cid.toString()));
 	}
 
+	_packedColorOrder = true;
+	_ledBuffer.resize(_ledCount * _packer.ledSize());
+
 	return true;
 }
 
@@ -73,42 +76,33 @@ void LedDeviceUdpE131::prepare(const unsigned this_universe, const unsigned this
 
 int LedDeviceUdpE131::write(const std::vector<ColorRgb> &ledValues)
 {
-	int retVal            = 0;
-	int thisChannelCount = 0;
-	int dmxChannelCount  = _ledRGBCount;
-	const uint8_t * rawdata = reinterpret_cast<const uint8_t *>(ledValues.data());
+	int retVal = 0;
+
+	// pack all universes in one pass, each packet takes a slice of the buffer
+	const size_t ledCount = qMin(ledValues.size(), size_t(_ledCount));
+	const int dmxChannelCount = int(_packer.pack(ledValues.data(), ledCount, _ledBuffer.data()) - _ledBuffer.data());
 
 	_e131_seq++;
 
-	for (int rawIdx = 0; rawIdx < dmxChannelCount; rawIdx++)
+	for (int rawIdx = 0; rawIdx < dmxChannelCount; rawIdx += DMX_MAX)
 	{
-		if (rawIdx % DMX_MAX == 0) // start of new packet
-		{
-			thisChannelCount = (dmxChannelCount - rawIdx < DMX_MAX) ? dmxChannelCount % DMX_MAX : DMX_MAX;
-//			                       is this the last packet?         ?       ^^ last packet      : ^^ earlier packets
+		const int thisChannelCount = qMin(dmxChannelCount - rawIdx, DMX_MAX);
 
-			prepare(_e131_universe + rawIdx / DMX_MAX, thisChannelCount);
-			e131_packet.sequence_number = _e131_seq;
-		}
+		prepare(_e131_universe + rawIdx / DMX_MAX, thisChannelCount);
+		e131_packet.sequence_number = _e131_seq;
+		memcpy(&e131_packet.property_values[1], _ledBuffer.data() + rawIdx, thisChannelCount);
 
-		e131_packet.property_values[1 + rawIdx%DMX_MAX] = rawdata[rawIdx];
-
-//     is this the      last byte of last packet    ||   last byte of other packets
-		if ( (rawIdx == dmxChannelCount-1) || (rawIdx %DMX_MAX == DMX_MAX-1) )
-		{
 #undef e131debug
 #if e131debug
-			Debug (_log, "send packet: rawidx %d dmxchannelcount %d universe: %d, packetsz %d"
-				, rawIdx
-				, dmxChannelCount
-				, _e131_universe + rawIdx / DMX_MAX
-				, E131_DMP_DATA + 1 + thisChannelCount
-				);
+		Debug (_log, "send packet: rawidx %d dmxchannelcount %d universe: %d, packetsz %d"
+			, rawIdx
+			, dmxChannelCount
+			, _e131_universe + rawIdx / DMX_MAX
+			, E131_DMP_DATA + 1 + thisChannelCount
+			);
 #endif
-			retVal &= writeBytes(E131_DMP_DATA + 1 + thisChannelCount, e131_packet.raw);
-		}
+		retVal &= writeBytes(E131_DMP_DATA + 1 + thisChannelCount, e131_packet.raw);
 	}
 
 	return retVal;
 }
-
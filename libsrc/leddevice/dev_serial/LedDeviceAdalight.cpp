@@ -22,18 +22,17 @@ bool LedDeviceAdalight::init(const QJsonObject &deviceConfig)
 	// create ledBuffer
 	unsigned int totalLedCount = _ledCount;
 
+	_packedColorOrder = true;
+
 	if (_ligthBerryAPA102Mode)
 	{
+		// full global brightness in front of each led
+		_packer.setLedPrefix(0xFF);
+
 		const unsigned int startFrameSize = 4;
-		const unsigned int bytesPerRGBLed = 4;
+		const unsigned int bytesPerRGBLed = _packer.ledSize();
 		const unsigned int endFrameSize = qMax<unsigned int>(((_ledCount + 15) / 16), bytesPerRGBLed);
 		_ledBuffer.resize(_headerSize + (_ledCount * bytesPerRGBLed) + startFrameSize + endFrameSize, 0x00);
-		
-		// init constant data values
-		for (signed iLed=1; iLed<=_ledCount; iLed++)
-		{
-			_ledBuffer[iLed*4+_headerSize] = 0xFF;
-		}
 		Debug( _log, "Adalight driver with activated LightBerry APA102 mode");
 	}
 	else
@@ -57,20 +56,9 @@ bool LedDeviceAdalight::init(const QJsonObject &deviceConfig)
 
 int LedDeviceAdalight::write(const std::vector<ColorRgb> & ledValues)
 {
-	if(_ligthBerryAPA102Mode)
-	{
-		for (signed iLed=1; iLed<=_ledCount; iLed++)
-		{
-			const ColorRgb& rgb = ledValues[iLed-1];
-			_ledBuffer[iLed*4+7] = rgb.red;
-			_ledBuffer[iLed*4+8] = rgb.green;
-			_ledBuffer[iLed*4+9] = rgb.blue;
-		}
-	}
-	else
-	{
-		memcpy(_headerSize + _ledBuffer.data(), ledValues.data(), ledValues.size() * 3);
-	}
+	// the APA102 start frame follows the header
+	const size_t offset = _headerSize + (_ligthBerryAPA102Mode ? 4 : 0);
+	_packer.pack(ledValues.data(), qMin(ledValues.size(), size_t(_ledCount)), _ledBuffer.data() + offset);
 	
 	return writeBytes(_ledBuffer.size(), _ledBuffer.data());
 }
@@ -15,9 +15,13 @@ bool LedDeviceAPA102::init(const QJsonObject &deviceConfig)
 {
 	ProviderSpi::init(deviceConfig);
 
+	// full global brightness in front of each led
+	_packer.setLedPrefix(0xFF);
+	_packedColorOrder = true;
+
 	const unsigned int startFrameSize = 4;
 	const unsigned int endFrameSize = qMax<unsigned int>(((_ledCount + 15) / 16), 4);
-	const unsigned int APAbufferSize = (_ledCount * 4) + startFrameSize + endFrameSize;
+	const unsigned int APAbufferSize = (_ledCount * _packer.ledSize()) + startFrameSize + endFrameSize;
 
 	_ledBuffer.resize(APAbufferSize, 0xFF);
 	_ledBuffer[0] = 0x00; 
@@ -30,13 +34,7 @@ bool LedDeviceAPA102::init(const QJsonObject &deviceConfig)
 
 int LedDeviceAPA102::write(const std::vector<ColorRgb> &ledValues)
 {
-	for (signed iLed=0; iLed < _ledCount; ++iLed) {
-		const ColorRgb& rgb = ledValues[iLed];
-		_ledBuffer[4+iLed*4]   = 0xFF;
-		_ledBuffer[4+iLed*4+1] = rgb.red;
-		_ledBuffer[4+iLed*4+2] = rgb.green;
-		_ledBuffer[4+iLed*4+3] = rgb.blue;
-	}
+	_packer.pack(ledValues.data(), qMin(ledValues.size(), size_t(_ledCount)), _ledBuffer.data() + 4);
 
 	return writeBytes(_ledBuffer.size(), _ledBuffer.data());
 }
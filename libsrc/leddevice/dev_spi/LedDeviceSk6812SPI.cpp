@@ -38,38 +38,20 @@ bool LedDeviceSk6812SPI::init(const QJsonObject &deviceConfig)
 	}
 	WarningIf(( _baudRate_Hz < 2050000 || _baudRate_Hz > 4000000 ), _log, "SPI rate %d outside recommended range (2050000 -> 4000000)", _baudRate_Hz);
 
+	_packer.setWhiteAlgorithm(_whiteAlgorithm);
+	_packer.setBitPairEncoding(bitpair_to_byte);
+	_packedColorOrder = true;
+
+	// the latch bytes at the end stay zero
 	const int SPI_FRAME_END_LATCH_BYTES = 3;
-	_ledBuffer.resize(_ledRGBWCount * SPI_BYTES_PER_COLOUR + SPI_FRAME_END_LATCH_BYTES, 0x00);
+	_ledBuffer.resize(_ledCount * _packer.ledSize() + SPI_FRAME_END_LATCH_BYTES, 0x00);
 	
 	return true;
 }
 
 int LedDeviceSk6812SPI::write(const std::vector<ColorRgb> &ledValues)
 {
-	unsigned spi_ptr = 0;
-	const int SPI_BYTES_PER_LED = sizeof(ColorRgbw) * SPI_BYTES_PER_COLOUR;
-
-
-	for (const ColorRgb& color : ledValues)
-	{
-		RGBW::Rgb_to_Rgbw(color, &_temp_rgbw, _whiteAlgorithm);
-		uint32_t colorBits = 
-			((uint32_t)_temp_rgbw.red << 24) +
-			((uint32_t)_temp_rgbw.green << 16) +
-			((uint32_t)_temp_rgbw.blue << 8) +
-			_temp_rgbw.white;
-
-		for (int j=SPI_BYTES_PER_LED - 1; j>=0; j--)
-		{
-			_ledBuffer[spi_ptr+j] = bitpair_to_byte[ colorBits & 0x3 ];
-			colorBits >>= 2;
-		}
-		spi_ptr += SPI_BYTES_PER_LED;
-	}
-
-	_ledBuffer[spi_ptr++] = 0;
-	_ledBuffer[spi_ptr++] = 0;
-	_ledBuffer[spi_ptr++] = 0;
+	_packer.pack(ledValues.data(), qMin(ledValues.size(), size_t(_ledCount)), _ledBuffer.data());
 
 	return writeBytes(_ledBuffer.size(), _ledBuffer.data());
 }
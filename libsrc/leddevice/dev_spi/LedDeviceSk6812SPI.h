@@ -40,6 +40,4 @@ private:
         const int SPI_BYTES_PER_COLOUR;
 
 	uint8_t bitpair_to_byte[4];
-	
-	ColorRgbw _temp_rgbw;
 };
@@ -62,34 +62,18 @@ bool LedDeviceWs2812SPI::init(const QJsonObject &deviceConfig)
 	}
 	WarningIf(( _baudRate_Hz < 2106000 || _baudRate_Hz > 3075000 ), _log, "SPI rate %d outside recommended range (2106000 -> 3075000)", _baudRate_Hz);
 
-	_ledBuffer.resize(_ledRGBCount * SPI_BYTES_PER_COLOUR + SPI_FRAME_END_LATCH_BYTES, 0x00);
+	_packer.setBitPairEncoding(bitpair_to_byte);
+	_packedColorOrder = true;
+
+	// the latch bytes at the end stay zero
+	_ledBuffer.resize(_ledCount * _packer.ledSize() + SPI_FRAME_END_LATCH_BYTES, 0x00);
 
 	return true;
 }
 
 int LedDeviceWs2812SPI::write(const std::vector<ColorRgb> &ledValues)
 {
-	unsigned spi_ptr = 0;
-	const int SPI_BYTES_PER_LED = sizeof(ColorRgb) * SPI_BYTES_PER_COLOUR;
-
-	for (const ColorRgb& color : ledValues)
-	{
-		uint32_t colorBits = ((unsigned int)color.red << 16)
-			| ((unsigned int)color.green << 8)
-			| color.blue;
-
-		for (int j=SPI_BYTES_PER_LED - 1; j>=0; j--)
-		{
-			_ledBuffer[spi_ptr+j] = bitpair_to_byte[ colorBits & 0x3 ];
-			colorBits >>= 2;
-		}
-		spi_ptr += SPI_BYTES_PER_LED;
-	}
-
-	for (int j=0; j < SPI_FRAME_END_LATCH_BYTES; j++)
-	{
-		_ledBuffer[spi_ptr++] = 0;
-	}
+	_packer.pack(ledValues.data(), qMin(ledValues.size(), size_t(_ledCount)), _ledBuffer.data());
 
 	return writeBytes(_ledBuffer.size(), _ledBuffer.data());
 }
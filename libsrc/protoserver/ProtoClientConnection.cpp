@@ -30,39 +30,32 @@ ProtoClientConnection::ProtoClientConnection(QTcpSocket* socket, const int &time
 
 void ProtoClientConnection::readyRead()
 {
-	_receiveBuffer += _socket->readAll();
+	_reader.readFrom(_socket);
 
-	// check if we can read a message size
-	if (_receiveBuffer.size() <= 4)
+	// the messages are parsed straight from the receive buffer
+	const uint8_t* messageData;
+	uint32_t messageSize;
+	FramedReader::Status status;
+	while ((status = _reader.next(messageData, messageSize)) == FramedReader::MESSAGE)
 	{
-		return;
-	}
-
-	// read the message size
-	uint32_t messageSize =
-			((_receiveBuffer[0]<<24) & 0xFF000000) |
-			((_receiveBuffer[1]<<16) & 0x00FF0000) |
-			((_receiveBuffer[2]<< 8) & 0x0000FF00) |
-			((_receiveBuffer[3]    ) & 0x000000FF);
+		proto::HyperionRequest message;
+		if (!message.ParseFromArray(messageData, int(messageSize)))
+		{
+			sendErrorReply("Unable to parse message");
+			continue;
+		}
 
-	// check if we can read a complete message
-	if ((uint32_t) _receiveBuffer.size() < messageSize + 4)
-	{
-		return;
+		// handle the message
+		handleMessage(message);
 	}
 
-	// read a message
-	proto::HyperionRequest message;
-	if (!message.ParseFromArray(_receiveBuffer.data() + 4, messageSize))
+	if (status == FramedReader::OVERSIZED)
 	{
-		sendErrorReply("Unable to parse message");
+		Error(_log, "Message of client %s exceeds the size limit, closing the connection", QSTRING_CSTR(_clientAddress));
+		sendErrorReply("Message exceeds the size limit");
+		_reader.clear();
+		forceClose();
 	}
-
-	// handle the message
-	handleMessage(message);
-
-	// remove message data from buffer
-	_receiveBuffer = _receiveBuffer.mid(messageSize + 4);
 }
 
 void ProtoClientConnection::forceClose()
@@ -177,9 +170,10 @@ void ProtoClientConnection::handleImageCommand(const proto::ImageRequest &messag
 		return;
 	}
 
-	// create ImageRgb
-	Image<ColorRgb> image(width, height);
-	memcpy(image.memptr(), imageData.c_str(), imageData.size());
+	// create ImageRgb, reduced to the resolution the led layouts of the instances need
+	Image<ColorRgb> image;
+	_downscaler.setTargetSize(ImageDownscaler::ingestSize());
+	_downscaler.scale(reinterpret_cast<const uint8_t*>(imageData.data()), width, height, size_t(width) * 3, image);
 
 	emit setGlobalInputImage(_priority, image, duration);
 
@@ -5,6 +5,8 @@
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/Components.h>
+#include <utils/FramedReader.h>
+#include <utils/ImageDownscaler.h>
 
 // protobuffer PROTO
 #include "message.pb.h"
@@ -32,6 +34,12 @@ public:
 	///
 	explicit ProtoClientConnection(QTcpSocket* socket, const int &timeout, QObject *parent);
 
+	///
+	/// @brief Set the largest accepted message, the client is disconnected on a larger one
+	/// @param maxMessageSize  The size in bytes
+	///
+	void setMaxMessageSize(uint32_t maxMessageSize) { _reader.setMaxMessageSize(maxMessageSize); }
+
 signals:
 	///
 	/// @brief forward register data to HyperionDaemon
@@ -156,6 +164,9 @@ private:
 	int _timeout;
 	int _priority;
 
-	/// The buffer used for reading data from the socket
-	QByteArray _receiveBuffer;
+	/// Reads the size prefixed messages of the socket
+	FramedReader _reader;
+
+	/// Reduces oversized images while copying them out of the message
+	ImageDownscaler _downscaler;
 };
@@ -15,6 +15,7 @@ ProtoServer::ProtoServer(const QJsonDocument& config, QObject* parent)
 	, _server(new QTcpServer(this))
 	, _log(Logger::getInstance("PROTOSERVER"))
 	, _timeout(5000)
+	, _maxMessageSize(FramedReader::DEFAULT_MAX_MESSAGE_SIZE)
 	, _config(config)
 {
 
@@ -52,6 +53,14 @@ void ProtoServer::handleSettingsUpdate(const settings::type& type, const QJsonDo
 
 		// new timeout just for new connections
 		_timeout = obj["timeout"].toInt(5000);
+
+		// the size limit applies to the open connections as well
+		_maxMessageSize = quint32(obj["maxMessageSize"].toInt(64)) * 1024 * 1024;
+		for(ProtoClientConnection* client : _openConnections)
+		{
+			client->setMaxMessageSize(_maxMessageSize);
+		}
+
 		// enable check
 		obj["enable"].toBool(true) ? startServer() : stopServer();
 	}
@@ -67,6 +76,7 @@ void ProtoServer::newConnection()
 			{
 				Debug(_log, "New connection from %s", QSTRING_CSTR(socket->peerAddress().toString()));
 				ProtoClientConnection * client = new ProtoClientConnection(socket, _timeout, this);
+				client->setMaxMessageSize(_maxMessageSize);
 				// internal
 				connect(client, &ProtoClientConnection::clientDisconnected, this, &ProtoServer::clientDisconnected);
 				connect(client, &ProtoClientConnection::registerGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::registerGlobalInput);
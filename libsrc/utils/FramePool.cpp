@@ -0,0 +1,76 @@
+#include <utils/FramePool.h>
+
+#include <QtGlobal>
+
+FramePool* FramePool::getInstance()
+{
+	// intentionally never destroyed, images with static storage may release their buffers at exit
+	static FramePool* instance = new FramePool();
+	return instance;
+}
+
+FramePool::FramePool()
+	: _mutex()
+	, _freeBuffers()
+	, _cachedBytes(0)
+{
+}
+
+void* FramePool::acquire(size_t bytes)
+{
+	{
+		QMutexLocker lock(&_mutex);
+		auto it = _freeBuffers.find(bytes);
+		if (it != _freeBuffers.end() && !it->isEmpty())
+		{
+			void* buffer = it->takeLast();
+			_cachedBytes -= bytes;
+			return buffer;
+		}
+	}
+
+	void* buffer = qMallocAligned(bytes, ALIGNMENT);
+	Q_CHECK_PTR(buffer);
+	return buffer;
+}
+
+void FramePool::release(void* buffer, size_t bytes)
+{
+	if (buffer == nullptr)
+	{
+		return;
+	}
+
+	{
+		QMutexLocker lock(&_mutex);
+		QVector<void*>& buffers = _freeBuffers[bytes];
+		if (buffers.size() < MAX_BUFFERS_PER_SIZE && _cachedBytes + bytes <= MAX_CACHED_BYTES)
+		{
+			buffers.append(buffer);
+			_cachedBytes += bytes;
+			return;
+		}
+	}
+
+	qFreeAligned(buffer);
+}
+
+void FramePool::clear()
+{
+	QMutexLocker lock(&_mutex);
+	for (const QVector<void*>& buffers : _freeBuffers)
+	{
+		for (void* buffer : buffers)
+		{
+			qFreeAligned(buffer);
+		}
+	}
+	_freeBuffers.clear();
+	_cachedBytes = 0;
+}
+
+size_t FramePool::cachedBytes()
+{
+	QMutexLocker lock(&_mutex);
+	return _cachedBytes;
+}
@@ -0,0 +1,70 @@
+#include <utils/FrameScheduler.h>
+
+// STL includes
+#include <chrono>
+#include <cstdlib>
+
+int64_t FrameScheduler::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameScheduler::FrameScheduler()
+	: _interval(0)
+	, _deadline(0)
+	, _frames(0)
+	, _skipped(0)
+	, _deviationSum(0)
+	, _deviationMax(0)
+{
+}
+
+void FrameScheduler::start(int64_t interval_us)
+{
+	_interval = interval_us > 0 ? interval_us : 1;
+	_deadline = now() + _interval;
+}
+
+void FrameScheduler::stop()
+{
+	_interval = 0;
+}
+
+void FrameScheduler::frameDone(int64_t now)
+{
+	if (_interval <= 0)
+	{
+		return;
+	}
+
+	const int64_t deviation = std::llabs(now - _deadline);
+	++_frames;
+	_deviationSum += deviation;
+	if (deviation > _deviationMax)
+	{
+		_deviationMax = deviation;
+	}
+
+	_deadline += _interval;
+	if (_deadline <= now)
+	{
+		// stay on the grid of the original deadlines instead of catching up with a burst of frames
+		const int64_t missed = (now - _deadline) / _interval + 1;
+		_deadline += missed * _interval;
+		_skipped += uint64_t(missed);
+	}
+}
+
+int FrameScheduler::timerDelay(int64_t now) const
+{
+	const int64_t remaining = _deadline - now;
+	return remaining > 0 ? int((remaining + 999) / 1000) : 0;
+}
+
+FrameScheduler::Jitter FrameScheduler::takeJitter()
+{
+	const Jitter jitter = { _frames, _skipped, _frames > 0 ? _deviationSum / int64_t(_frames) : 0, _deviationMax };
+	_frames = _skipped = 0;
+	_deviationSum = _deviationMax = 0;
+	return jitter;
+}
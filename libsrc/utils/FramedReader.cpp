@@ -0,0 +1,133 @@
+#include <utils/FramedReader.h>
+
+// STL includes
+#include <cstring>
+#include <algorithm>
+
+// Qt includes
+#include <QIODevice>
+
+namespace {
+
+/// Size of the message size prefix
+const size_t PREFIX_SIZE = 4;
+
+/// Initial buffer size, enough for all messages but images
+const size_t INITIAL_SIZE = 64 * 1024;
+
+}
+
+FramedReader::FramedReader(uint32_t maxMessageSize)
+	: _buffer()
+	, _head(0)
+	, _tail(0)
+	, _largestFrame(0)
+	, _maxMessageSize(maxMessageSize)
+{
+}
+
+void FramedReader::readFrom(QIODevice* device)
+{
+	for (;;)
+	{
+		const qint64 available = device->bytesAvailable();
+		if (available <= 0)
+		{
+			break;
+		}
+
+		// room for the received data only, the declared size of a message allocates nothing
+		reserve(size_t(available));
+
+		const qint64 count = device->read(reinterpret_cast<char*>(_buffer.data() + _tail), qint64(_buffer.size() - _tail));
+		if (count <= 0)
+		{
+			break;
+		}
+		_tail += size_t(count);
+	}
+}
+
+FramedReader::Status FramedReader::next(const uint8_t*& data, uint32_t& size)
+{
+	const size_t buffered = _tail - _head;
+	if (buffered == 0)
+	{
+		// nothing left to move on the next reserve()
+		_head = _tail = 0;
+
+		// release a grown buffer once only small messages arrived since the last drain
+		if (_largestFrame > 0)
+		{
+			if (_largestFrame <= INITIAL_SIZE && _buffer.size() > INITIAL_SIZE)
+			{
+				std::vector<uint8_t>(INITIAL_SIZE).swap(_buffer);
+			}
+			_largestFrame = 0;
+		}
+		return INCOMPLETE;
+	}
+
+	if (buffered < PREFIX_SIZE)
+	{
+		return INCOMPLETE;
+	}
+
+	const uint32_t messageSize = pendingMessageSize();
+	if (messageSize > _maxMessageSize)
+	{
+		return OVERSIZED;
+	}
+
+	if (buffered < PREFIX_SIZE + messageSize)
+	{
+		return INCOMPLETE;
+	}
+
+	data = _buffer.data() + _head + PREFIX_SIZE;
+	size = messageSize;
+	_head += PREFIX_SIZE + messageSize;
+	_largestFrame = std::max(_largestFrame, PREFIX_SIZE + messageSize);
+	return MESSAGE;
+}
+
+void FramedReader::clear()
+{
+	std::vector<uint8_t>().swap(_buffer);
+	_head = _tail = 0;
+	_largestFrame = 0;
+}
+
+void FramedReader::reserve(size_t bytes)
+{
+	if (_buffer.size() - _tail >= bytes)
+	{
+		return;
+	}
+
+	// move the unread data to the front, usually only the start of the next message
+	const size_t buffered = _tail - _head;
+	if (_head > 0)
+	{
+		memmove(_buffer.data(), _buffer.data() + _head, buffered);
+		_head = 0;
+		_tail = buffered;
+	}
+
+	// grown geometrically, a large message is received with a few reallocations
+	if (_buffer.size() - _tail < bytes)
+	{
+		_buffer.resize(std::max(std::max(INITIAL_SIZE, 2 * _buffer.size()), _tail + bytes));
+	}
+}
+
+uint32_t FramedReader::pendingMessageSize() const
+{
+	if (_tail - _head < PREFIX_SIZE)
+	{
+		return 0;
+	}
+
+	const uint8_t* prefix = _buffer.data() + _head;
+	return (uint32_t(prefix[0]) << 24) | (uint32_t(prefix[1]) << 16) | (uint32_t(prefix[2]) << 8) | uint32_t(prefix[3]);
+}
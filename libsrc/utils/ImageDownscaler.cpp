@@ -0,0 +1,124 @@
+#include <utils/ImageDownscaler.h>
+#include <utils/PixelKernels.h>
+
+// STL includes
+#include <cstring>
+#include <algorithm>
+
+// Qt includes
+#include <QMutex>
+#include <QMutexLocker>
+#include <QMap>
+
+namespace {
+
+/// Guards the target sizes, instances and network clients live in different threads
+QMutex targetSizeMutex;
+QMap<quint8, QSize> instanceTargetSizes;
+
+}
+
+QSize ImageDownscaler::targetSize(const QSize& ledGridSize)
+{
+	const int width = ledGridSize.width() * PIXELS_PER_GRID_CELL;
+	const int height = ledGridSize.height() * PIXELS_PER_GRID_CELL;
+	return QSize(width > MIN_WIDTH ? width : int(MIN_WIDTH), height > MIN_HEIGHT ? height : int(MIN_HEIGHT));
+}
+
+void ImageDownscaler::setInstanceTargetSize(quint8 instance, const QSize& targetSize)
+{
+	QMutexLocker lock(&targetSizeMutex);
+	instanceTargetSizes.insert(instance, targetSize);
+}
+
+void ImageDownscaler::removeInstance(quint8 instance)
+{
+	QMutexLocker lock(&targetSizeMutex);
+	instanceTargetSizes.remove(instance);
+}
+
+QSize ImageDownscaler::ingestSize()
+{
+	QMutexLocker lock(&targetSizeMutex);
+	QSize size;
+	for (const QSize& targetSize : instanceTargetSizes)
+	{
+		size = size.isValid() ? size.expandedTo(targetSize) : targetSize;
+	}
+	return size;
+}
+
+ImageDownscaler::ImageDownscaler(const QSize& targetSize)
+	: _targetSize(targetSize)
+	, _sums()
+{
+}
+
+int ImageDownscaler::factor(int size, int target)
+{
+	return target > 0 ? std::max(1, size / target) : 1;
+}
+
+bool ImageDownscaler::isOversized(int width, int height) const
+{
+	return _targetSize.isValid()
+		&& (factor(width, _targetSize.width()) > 1 || factor(height, _targetSize.height()) > 1);
+}
+
+void ImageDownscaler::scale(const uint8_t* data, int width, int height, size_t lineLength, Image<ColorRgb>& dest)
+{
+	if (!isOversized(width, height))
+	{
+		dest.resize(width, height);
+		uint8_t* target = reinterpret_cast<uint8_t*>(dest.memptr());
+		const size_t rowSize = size_t(width) * 3;
+		if (lineLength == rowSize)
+		{
+			memcpy(target, data, rowSize * height);
+			return;
+		}
+
+		for (int y = 0; y < height; ++y)
+		{
+			memcpy(target + y * rowSize, data + y * lineLength, rowSize);
+		}
+		return;
+	}
+
+	// the rest of the pixels that doesn't fill a box is dropped, at most factor-1 rows and columns
+	const int factorX = factor(width, _targetSize.width());
+	const int factorY = factor(height, _targetSize.height());
+	const int outWidth = width / factorX;
+	const int outHeight = height / factorY;
+	const uint32_t boxSize = uint32_t(factorX) * factorY;
+
+	dest.resize(outWidth, outHeight);
+	uint8_t* target = reinterpret_cast<uint8_t*>(dest.memptr());
+	_sums.resize(size_t(outWidth) * 3);
+
+	for (int y = 0; y < outHeight; ++y)
+	{
+		std::fill(_sums.begin(), _sums.end(), 0);
+		const uint8_t* row = data + size_t(y) * factorY * lineLength;
+		for (int i = 0; i < factorY; ++i, row += lineLength)
+		{
+			PixelKernels::sumBoxesRgb24(row, size_t(outWidth), unsigned(factorX), _sums.data());
+		}
+
+		for (const uint32_t sum : _sums)
+		{
+			*target++ = uint8_t((sum + boxSize / 2) / boxSize);
+		}
+	}
+}
+
+void ImageDownscaler::scale(const Image<ColorRgb>& image, Image<ColorRgb>& dest)
+{
+	if (!isOversized(image.width(), image.height()))
+	{
+		dest = image;
+		return;
+	}
+
+	scale(reinterpret_cast<const uint8_t*>(image.memptr()), image.width(), image.height(), size_t(image.width()) * 3, dest);
+}
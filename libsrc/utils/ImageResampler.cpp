@@ -1,5 +1,235 @@
 #include "utils/ImageResampler.h"
 #include <utils/Logger.h>
+#include <utils/PixelKernels.h>
+
+// Qt includes
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+namespace {
+
+///
+/// Reads the pixel at column x of a source row
+///
+template <PixelFormat FORMAT>
+inline void readPixel(const uint8_t* row, const int x, ColorRgb& rgb);
+
+template <>
+inline void readPixel<PIXELFORMAT_UYVY>(const uint8_t* row, const int x, ColorRgb& rgb)
+{
+	const int index = x << 1;
+	const uint8_t y = row[index+1];
+	const uint8_t u = ((x&1) == 0) ? row[index  ] : row[index-2];
+	const uint8_t v = ((x&1) == 0) ? row[index+2] : row[index  ];
+	PixelKernels::yuvToRgb(y, u, v, rgb.red, rgb.green, rgb.blue);
+}
+
+template <>
+inline void readPixel<PIXELFORMAT_YUYV>(const uint8_t* row, const int x, ColorRgb& rgb)
+{
+	const int index = x << 1;
+	const uint8_t y = row[index];
+	const uint8_t u = ((x&1) == 0) ? row[index+1] : row[index-1];
+	const uint8_t v = ((x&1) == 0) ? row[index+3] : row[index+1];
+	PixelKernels::yuvToRgb(y, u, v, rgb.red, rgb.green, rgb.blue);
+}
+
+template <>
+inline void readPixel<PIXELFORMAT_BGR16>(const uint8_t* row, const int x, ColorRgb& rgb)
+{
+	const int index = x << 1;
+	rgb.blue  = (row[index] & 0x1f) << 3;
+	rgb.green = (((row[index+1] & 0x7) << 3) | (row[index] & 0xE0) >> 5) << 2;
+	rgb.red   = (row[index+1] & 0xF8);
+}
+
+template <>
+inline void readPixel<PIXELFORMAT_BGR24>(const uint8_t* row, const int x, ColorRgb& rgb)
+{
+	const int index = (x << 1) + x;
+	rgb.blue  = row[index  ];
+	rgb.green = row[index+1];
+	rgb.red   = row[index+2];
+}
+
+template <>
+inline void readPixel<PIXELFORMAT_RGB32>(const uint8_t* row, const int x, ColorRgb& rgb)
+{
+	const int index = x << 2;
+	rgb.red   = row[index  ];
+	rgb.green = row[index+1];
+	rgb.blue  = row[index+2];
+}
+
+template <>
+inline void readPixel<PIXELFORMAT_BGR32>(const uint8_t* row, const int x, ColorRgb& rgb)
+{
+	const int index = x << 2;
+	rgb.blue  = row[index  ];
+	rgb.green = row[index+1];
+	rgb.red   = row[index+2];
+}
+
+///
+/// Converts a decimated source row with the per pixel reader of the given format
+///
+template <PixelFormat FORMAT>
+void convertRow(const uint8_t* row, int xSource, const int xStep, const int count, ColorRgb* dest)
+{
+	for (ColorRgb* destEnd = dest + count; dest != destEnd; ++dest, xSource += xStep)
+	{
+		readPixel<FORMAT>(row, xSource, *dest);
+	}
+}
+
+///
+/// Formats with a vectorized kernel take it for undecimated rows
+///
+template <>
+void convertRow<PIXELFORMAT_YUYV>(const uint8_t* row, int xSource, const int xStep, const int count, ColorRgb* dest)
+{
+	if (xStep == 1 && (xSource & 1) == 0)
+	{
+		PixelKernels::yuyvToRgb24(row + (xSource << 1), size_t(count), reinterpret_cast<uint8_t*>(dest));
+		return;
+	}
+
+	for (ColorRgb* destEnd = dest + count; dest != destEnd; ++dest, xSource += xStep)
+	{
+		readPixel<PIXELFORMAT_YUYV>(row, xSource, *dest);
+	}
+}
+
+template <>
+void convertRow<PIXELFORMAT_UYVY>(const uint8_t* row, int xSource, const int xStep, const int count, ColorRgb* dest)
+{
+	if (xStep == 1 && (xSource & 1) == 0)
+	{
+		PixelKernels::uyvyToRgb24(row + (xSource << 1), size_t(count), reinterpret_cast<uint8_t*>(dest));
+		return;
+	}
+
+	for (ColorRgb* destEnd = dest + count; dest != destEnd; ++dest, xSource += xStep)
+	{
+		readPixel<PIXELFORMAT_UYVY>(row, xSource, *dest);
+	}
+}
+
+template <>
+void convertRow<PIXELFORMAT_BGR32>(const uint8_t* row, int xSource, const int xStep, const int count, ColorRgb* dest)
+{
+	if (xStep == 1)
+	{
+		PixelKernels::bgr32ToRgb24(row + (xSource << 2), size_t(count), reinterpret_cast<uint8_t*>(dest));
+		return;
+	}
+
+	for (ColorRgb* destEnd = dest + count; dest != destEnd; ++dest, xSource += xStep)
+	{
+		readPixel<PIXELFORMAT_BGR32>(row, xSource, *dest);
+	}
+}
+
+template <>
+void convertRow<PIXELFORMAT_RGB32>(const uint8_t* row, int xSource, const int xStep, const int count, ColorRgb* dest)
+{
+	if (xStep == 1)
+	{
+		PixelKernels::rgb32ToRgb24(row + (xSource << 2), size_t(count), reinterpret_cast<uint8_t*>(dest));
+		return;
+	}
+
+	for (ColorRgb* destEnd = dest + count; dest != destEnd; ++dest, xSource += xStep)
+	{
+		readPixel<PIXELFORMAT_RGB32>(row, xSource, *dest);
+	}
+}
+
+typedef void (*RowConverter)(const uint8_t* row, int xSource, const int xStep, const int count, ColorRgb* dest);
+
+///
+/// @brief Get the row converter of a pixel format
+/// @return The converter or nullptr if the format can't be resampled
+///
+RowConverter rowConverter(const PixelFormat pixelFormat)
+{
+	switch (pixelFormat)
+	{
+		case PIXELFORMAT_UYVY:  return convertRow<PIXELFORMAT_UYVY>;
+		case PIXELFORMAT_YUYV:  return convertRow<PIXELFORMAT_YUYV>;
+		case PIXELFORMAT_BGR16: return convertRow<PIXELFORMAT_BGR16>;
+		case PIXELFORMAT_BGR24: return convertRow<PIXELFORMAT_BGR24>;
+		case PIXELFORMAT_RGB32: return convertRow<PIXELFORMAT_RGB32>;
+		case PIXELFORMAT_BGR32: return convertRow<PIXELFORMAT_BGR32>;
+		default:                return nullptr;
+	}
+}
+
+///
+/// All parameters of a single resample call, shared by the worker tasks
+///
+struct ResampleJob
+{
+	const uint8_t* data;
+	int lineLength;
+	RowConverter converter;
+	int xSource;
+	int xStep;
+	int ySource;
+	int yStep;
+	int outputWidth;
+	ColorRgb* output;
+};
+
+void resampleRows(const ResampleJob& job, const int firstRow, const int endRow)
+{
+	for (int yDest = firstRow; yDest < endRow; ++yDest)
+	{
+		const uint8_t* row = job.data + job.lineLength * (job.ySource + yDest * job.yStep);
+		job.converter(row, job.xSource, job.xStep, job.outputWidth, job.output + yDest * job.outputWidth);
+	}
+}
+
+///
+/// Resamples a band of rows on a worker thread
+///
+class ResampleTask : public QRunnable
+{
+public:
+	ResampleTask(const ResampleJob& job, const int firstRow, const int endRow, QSemaphore& done)
+		: _job(job)
+		, _firstRow(firstRow)
+		, _endRow(endRow)
+		, _done(done)
+	{
+		setAutoDelete(true);
+	}
+
+	void run() override
+	{
+		resampleRows(_job, _firstRow, _endRow);
+		_done.release();
+	}
+
+private:
+	const ResampleJob& _job;
+	const int _firstRow;
+	const int _endRow;
+	QSemaphore& _done;
+};
+
+/// Frames with less output pixels are converted on the calling thread
+const int MIN_PIXELS_PER_THREAD = 64 * 1024;
+
+QThreadPool* resamplerPool()
+{
+	static QThreadPool* pool = new QThreadPool();
+	return pool;
+}
+
+} // anonymous namespace
 
 ImageResampler::ImageResampler()
 	: _horizontalDecimation(1)
@@ -9,6 +239,7 @@ ImageResampler::ImageResampler()
 	, _cropTop(0)
 	, _cropBottom(0)
 	, _videoMode(VIDEO_2D)
+	, _maxThreads(QThread::idealThreadCount())
 {
 }
 
@@ -57,95 +288,53 @@ void ImageResampler::processImage(const uint8_t * data, int width, int height, i
 		break;
 	}
 
+	// select the row kernel once per frame
+	const RowConverter converter = rowConverter(pixelFormat);
+	if (converter == nullptr)
+	{
+		Error(Logger::getInstance("ImageResampler"), "Invalid pixel format given");
+		return;
+	}
+
 	// calculate the output size
 	int outputWidth = (width - _cropLeft - cropRight - (_horizontalDecimation >> 1) + _horizontalDecimation - 1) / _horizontalDecimation;
 	int outputHeight = (height - _cropTop - cropBottom - (_verticalDecimation >> 1) + _verticalDecimation - 1) / _verticalDecimation;
-	if ((outputImage.height() != unsigned(outputHeight)) && (outputImage.width() != unsigned(outputWidth)))
-		outputImage.resize(outputWidth, outputHeight);
-
-	for (int yDest = 0, ySource = _cropTop + (_verticalDecimation >> 1); yDest < outputHeight; ySource += _verticalDecimation, ++yDest)
-	{
-		for (int xDest = 0, xSource = _cropLeft + (_horizontalDecimation >> 1); xDest < outputWidth; xSource += _horizontalDecimation, ++xDest)
-		{
-			ColorRgb & rgb = outputImage(xDest, yDest);
-			
-			switch (pixelFormat)
-			{
-				case PIXELFORMAT_UYVY:
-				{
-					int index = lineLength * ySource + (xSource << 1);
-					uint8_t y = data[index+1];
-					uint8_t u = ((xSource&1) == 0) ? data[index  ] : data[index-2];
-					uint8_t v = ((xSource&1) == 0) ? data[index+2] : data[index  ];
-					yuv2rgb(y, u, v, rgb.red, rgb.green, rgb.blue);
-				}
-				break;
-				case PIXELFORMAT_YUYV:
-				{
-					int index = lineLength * ySource + (xSource << 1);
-					uint8_t y = data[index];
-					uint8_t u = ((xSource&1) == 0) ? data[index+1] : data[index-1];
-					uint8_t v = ((xSource&1) == 0) ? data[index+3] : data[index+1];
-					yuv2rgb(y, u, v, rgb.red, rgb.green, rgb.blue);
-				}
-				break;
-				case PIXELFORMAT_BGR16:
-				{
-					int index = lineLength * ySource + (xSource << 1);
-					rgb.blue  = (data[index] & 0x1f) << 3;
-					rgb.green = (((data[index+1] & 0x7) << 3) | (data[index] & 0xE0) >> 5) << 2;
-					rgb.red   = (data[index+1] & 0xF8);
-				}
-				break;
-				case PIXELFORMAT_BGR24:
-				{
-					int index = lineLength * ySource + (xSource << 1) + xSource;
-					rgb.blue  = data[index  ];
-					rgb.green = data[index+1];
-					rgb.red   = data[index+2];
-				}
-				break;
-				case PIXELFORMAT_RGB32:
-				{
-					int index = lineLength * ySource + (xSource << 2);
-					rgb.red   = data[index  ];
-					rgb.green = data[index+1];
-					rgb.blue  = data[index+2];
-				}
-				break;
-				case PIXELFORMAT_BGR32:
-				{
-					int index = lineLength * ySource + (xSource << 2);
-					rgb.blue  = data[index  ];
-					rgb.green = data[index+1];
-					rgb.red   = data[index+2];
-				}
-				break;
-#ifdef HAVE_JPEG
-				case PIXELFORMAT_MJPEG:
-					break;
-#endif
-				case PIXELFORMAT_NO_CHANGE:
-					Error(Logger::getInstance("ImageResampler"), "Invalid pixel format given");
-				break;
-			}
-		}
-	}
-}
-
-uint8_t ImageResampler::clamp(int x)
-{
-	return (x<0) ? 0 : ((x>255) ? 255 : uint8_t(x));
-}
-
-void ImageResampler::yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t &r, uint8_t &g, uint8_t &b)
-{
-	// see: http://en.wikipedia.org/wiki/YUV#Y.27UV444_to_RGB888_conversion
-	int c = y - 16;
-	int d = u - 128;
-	int e = v - 128;
-	
-	r = clamp((298 * c + 409 * e + 128) >> 8);
-	g = clamp((298 * c - 100 * d - 208 * e + 128) >> 8);
-	b = clamp((298 * c + 516 * d + 128) >> 8);
+	if (outputWidth <= 0 || outputHeight <= 0)
+	{
+		return;
+	}
+
+	outputImage.resize(outputWidth, outputHeight);
+
+	const ResampleJob job = {
+		data, lineLength, converter,
+		_cropLeft + (_horizontalDecimation >> 1), _horizontalDecimation,
+		_cropTop + (_verticalDecimation >> 1), _verticalDecimation,
+		outputWidth, outputImage.memptr()
+	};
+
+	// split the rows into bands, the calling thread converts the first band itself
+	const int bands = qBound(1, (outputWidth * outputHeight) / MIN_PIXELS_PER_THREAD, qMin(_maxThreads, outputHeight));
+	if (bands == 1)
+	{
+		resampleRows(job, 0, outputHeight);
+		return;
+	}
+
+	QThreadPool* pool = resamplerPool();
+	if (pool->maxThreadCount() < bands - 1)
+	{
+		pool->setMaxThreadCount(bands - 1);
+	}
+
+	QSemaphore done;
+	const int rowsPerBand = (outputHeight + bands - 1) / bands;
+	int workerBands = 0;
+	for (int firstRow = rowsPerBand; firstRow < outputHeight; firstRow += rowsPerBand, ++workerBands)
+	{
+		pool->start(new ResampleTask(job, firstRow, qMin(firstRow + rowsPerBand, outputHeight), done));
+	}
+
+	resampleRows(job, 0, rowsPerBand);
+	done.acquire(workerBands);
 }
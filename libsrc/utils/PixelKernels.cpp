@@ -0,0 +1,850 @@
+#include <utils/PixelKernels.h>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define PIXELKERNELS_X86
+	#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define PIXELKERNELS_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace PixelKernels {
+
+namespace {
+
+typedef void (*SumRgb24Fn)(const uint8_t* data, size_t count, uint32_t sums[3]);
+typedef void (*ConvertRowFn)(const uint8_t* source, size_t count, uint8_t* dest);
+typedef size_t (*CountNonBlackFn)(const uint8_t* data, size_t count, uint8_t threshold);
+typedef void (*AccumulateNonBlackFn)(const uint8_t* data, size_t count, uint8_t threshold, uint16_t* counts);
+typedef void (*Approach16Fn)(uint16_t* values, const uint16_t* targets, size_t count, uint16_t factor);
+typedef void (*Blend8Fn)(uint8_t* dest, const uint8_t* src, const uint8_t* weights, size_t count);
+
+///
+/// The set of kernels bound to the detected cpu features
+///
+struct KernelSet
+{
+	const char* name;
+	SumRgb24Fn sumRgb24;
+	ConvertRowFn yuyvToRgb24;
+	ConvertRowFn uyvyToRgb24;
+	ConvertRowFn bgr32ToRgb24;
+	ConvertRowFn rgb32ToRgb24;
+	CountNonBlackFn countNonBlackRgb24;
+	AccumulateNonBlackFn accumulateNonBlackRgb24;
+	Approach16Fn approach16;
+	Blend8Fn blend8;
+};
+
+void sumRgb24Scalar(const uint8_t* data, size_t count, uint32_t sums[3])
+{
+	uint32_t red = sums[0], green = sums[1], blue = sums[2];
+	for (const uint8_t* end = data + 3 * count; data != end; data += 3)
+	{
+		red   += data[0];
+		green += data[1];
+		blue  += data[2];
+	}
+	sums[0] = red;
+	sums[1] = green;
+	sums[2] = blue;
+}
+
+///
+/// Converts pixels [first, count) of a YUV 4:2:2 row, source points to an even pixel
+///
+inline void yuv422ToRgb24Scalar(const uint8_t* source, size_t first, size_t count, uint8_t* dest, const bool uyvy)
+{
+	for (size_t x = first; x < count; ++x)
+	{
+		const uint8_t* pair = source + 4 * (x >> 1);
+		const uint8_t y = uyvy ? pair[1 + 2 * (x & 1)] : pair[2 * (x & 1)];
+		const uint8_t u = uyvy ? pair[0] : pair[1];
+		const uint8_t v = uyvy ? pair[2] : pair[3];
+		yuvToRgb(y, u, v, dest[3*x], dest[3*x+1], dest[3*x+2]);
+	}
+}
+
+void yuyvToRgb24Scalar(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	yuv422ToRgb24Scalar(source, 0, count, dest, false);
+}
+
+void uyvyToRgb24Scalar(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	yuv422ToRgb24Scalar(source, 0, count, dest, true);
+}
+
+///
+/// Converts pixels [first, count) of a 32-bit row, redOffset/blueOffset locate the channels within a pixel
+///
+inline void rgbx32ToRgb24Scalar(const uint8_t* source, size_t first, size_t count, uint8_t* dest, const unsigned redOffset, const unsigned blueOffset)
+{
+	for (size_t x = first; x < count; ++x)
+	{
+		dest[3*x]   = source[4*x + redOffset];
+		dest[3*x+1] = source[4*x + 1];
+		dest[3*x+2] = source[4*x + blueOffset];
+	}
+}
+
+void bgr32ToRgb24Scalar(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	rgbx32ToRgb24Scalar(source, 0, count, dest, 2, 0);
+}
+
+void rgb32ToRgb24Scalar(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	rgbx32ToRgb24Scalar(source, 0, count, dest, 0, 2);
+}
+
+inline bool isNonBlack(const uint8_t* pixel, const uint8_t threshold)
+{
+	return pixel[0] >= threshold || pixel[1] >= threshold || pixel[2] >= threshold;
+}
+
+size_t countNonBlackRgb24Scalar(const uint8_t* data, size_t count, uint8_t threshold)
+{
+	size_t nonBlack = 0;
+	for (const uint8_t* end = data + 3 * count; data != end; data += 3)
+	{
+		nonBlack += isNonBlack(data, threshold) ? 1 : 0;
+	}
+	return nonBlack;
+}
+
+void accumulateNonBlackRgb24Scalar(const uint8_t* data, size_t count, uint8_t threshold, uint16_t* counts)
+{
+	for (size_t x = 0; x < count; ++x, data += 3)
+	{
+		counts[x] += isNonBlack(data, threshold) ? 1 : 0;
+	}
+}
+
+void approach16Scalar(uint16_t* values, const uint16_t* targets, size_t count, uint16_t factor)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint32_t value = values[i];
+		const uint32_t target = targets[i];
+		if (target > value)
+		{
+			values[i] = uint16_t(value + (((target - value) * factor + 0xFFFF) >> 16));
+		}
+		else
+		{
+			values[i] = uint16_t(value - (((value - target) * factor + 0xFFFF) >> 16));
+		}
+	}
+}
+
+void blend8Scalar(uint8_t* dest, const uint8_t* src, const uint8_t* weights, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		// exact rounded division by 255
+		const uint32_t mix = uint32_t(src[i]) * weights[i] + uint32_t(dest[i]) * (255 - weights[i]) + 128;
+		dest[i] = uint8_t((mix + (mix >> 8)) >> 8);
+	}
+}
+
+/// Number of 48 byte blocks (16 pixels) which fit into the 16-bit lane accumulators
+const size_t BLOCKS_PER_FLUSH = 256;
+
+///
+/// Distributes the per byte position sums of a 48 byte block to the three channels
+///
+inline void addLaneSums(const uint32_t laneSums[48], uint32_t sums[3])
+{
+	for (unsigned pos = 0; pos < 48; ++pos)
+	{
+		sums[pos % 3] += laneSums[pos];
+	}
+}
+
+#ifdef PIXELKERNELS_X86
+
+__attribute__((target("sse2")))
+void sumRgb24Sse2(const uint8_t* data, size_t count, uint32_t sums[3])
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t laneSums[48] = {0};
+	size_t blocks = count / 16;
+
+	while (blocks > 0)
+	{
+		const size_t batch = std::min(blocks, BLOCKS_PER_FLUSH);
+		// lane order follows the byte position within the block
+		__m128i acc[6] = { zero, zero, zero, zero, zero, zero };
+		for (size_t i = 0; i < batch; ++i, data += 48)
+		{
+			for (unsigned reg = 0; reg < 3; ++reg)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * reg));
+				acc[2*reg]   = _mm_add_epi16(acc[2*reg],   _mm_unpacklo_epi8(bytes, zero));
+				acc[2*reg+1] = _mm_add_epi16(acc[2*reg+1], _mm_unpackhi_epi8(bytes, zero));
+			}
+		}
+
+		uint16_t lanes[48];
+		for (unsigned reg = 0; reg < 6; ++reg)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 8 * reg), acc[reg]);
+		}
+		for (unsigned pos = 0; pos < 48; ++pos)
+		{
+			laneSums[pos] += lanes[pos];
+		}
+		blocks -= batch;
+	}
+
+	addLaneSums(laneSums, sums);
+	sumRgb24Scalar(data, count % 16, sums);
+}
+
+__attribute__((target("avx2")))
+void sumRgb24Avx2(const uint8_t* data, size_t count, uint32_t sums[3])
+{
+	uint32_t laneSums[48] = {0};
+	size_t blocks = count / 16;
+
+	while (blocks > 0)
+	{
+		const size_t batch = std::min(blocks, BLOCKS_PER_FLUSH);
+		__m256i acc[3] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+		for (size_t i = 0; i < batch; ++i, data += 48)
+		{
+			for (unsigned reg = 0; reg < 3; ++reg)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * reg));
+				acc[reg] = _mm256_add_epi16(acc[reg], _mm256_cvtepu8_epi16(bytes));
+			}
+		}
+
+		uint16_t lanes[48];
+		for (unsigned reg = 0; reg < 3; ++reg)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 16 * reg), acc[reg]);
+		}
+		for (unsigned pos = 0; pos < 48; ++pos)
+		{
+			laneSums[pos] += lanes[pos];
+		}
+		blocks -= batch;
+	}
+
+	addLaneSums(laneSums, sums);
+	sumRgb24Scalar(data, count % 16, sums);
+}
+
+///
+/// YUV 4:2:2 to RGB with 8 pixels per iteration. The products are formed with madd on
+/// (c, 1) and (d, e) lane pairs and clamped by the saturating packs, matching yuvToRgb() exactly.
+///
+__attribute__((target("sse2")))
+void yuv422ToRgb24Sse2(const uint8_t* source, size_t count, uint8_t* dest, const bool uyvy)
+{
+	const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+	const __m128i offsetY  = _mm_set1_epi16(16);
+	const __m128i offsetUV = _mm_set1_epi16(128);
+	const __m128i one      = _mm_set1_epi16(1);
+	const __m128i weightY  = _mm_setr_epi16(298, 128, 298, 128, 298, 128, 298, 128);
+	const __m128i weightR  = _mm_setr_epi16(0, 409, 0, 409, 0, 409, 0, 409);
+	const __m128i weightG  = _mm_setr_epi16(-100, -208, -100, -208, -100, -208, -100, -208);
+	const __m128i weightB  = _mm_setr_epi16(516, 0, 516, 0, 516, 0, 516, 0);
+
+	size_t x = 0;
+	for (; x + 8 <= count; x += 8)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 2 * x));
+		// luma lanes y0..y7, chroma lanes u0 v0 u1 v1 u2 v2 u3 v3
+		const __m128i luma   = _mm_sub_epi16(uyvy ? _mm_srli_epi16(pixels, 8) : _mm_and_si128(pixels, lowBytes), offsetY);
+		const __m128i chroma = _mm_sub_epi16(uyvy ? _mm_and_si128(pixels, lowBytes) : _mm_srli_epi16(pixels, 8), offsetUV);
+
+		__m128i red[2], green[2], blue[2];
+		for (unsigned half = 0; half < 2; ++half)
+		{
+			const __m128i lumaPairs = half ? _mm_unpackhi_epi16(luma, one) : _mm_unpacklo_epi16(luma, one);
+			const __m128i chromaPairs = half ? _mm_shuffle_epi32(chroma, _MM_SHUFFLE(3, 3, 2, 2)) : _mm_shuffle_epi32(chroma, _MM_SHUFFLE(1, 1, 0, 0));
+			const __m128i cy = _mm_madd_epi16(lumaPairs, weightY);
+			red[half]   = _mm_srai_epi32(_mm_add_epi32(cy, _mm_madd_epi16(chromaPairs, weightR)), 8);
+			green[half] = _mm_srai_epi32(_mm_add_epi32(cy, _mm_madd_epi16(chromaPairs, weightG)), 8);
+			blue[half]  = _mm_srai_epi32(_mm_add_epi32(cy, _mm_madd_epi16(chromaPairs, weightB)), 8);
+		}
+
+		const __m128i blue16 = _mm_packs_epi32(blue[0], blue[1]);
+		uint8_t channels[32];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(channels), _mm_packus_epi16(_mm_packs_epi32(red[0], red[1]), _mm_packs_epi32(green[0], green[1])));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(channels + 16), _mm_packus_epi16(blue16, blue16));
+
+		uint8_t* rgb = dest + 3 * x;
+		for (unsigned i = 0; i < 8; ++i)
+		{
+			rgb[3*i]   = channels[i];
+			rgb[3*i+1] = channels[8 + i];
+			rgb[3*i+2] = channels[16 + i];
+		}
+	}
+
+	yuv422ToRgb24Scalar(source, x, count, dest, uyvy);
+}
+
+__attribute__((target("sse2")))
+void yuyvToRgb24Sse2(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	yuv422ToRgb24Sse2(source, count, dest, false);
+}
+
+__attribute__((target("sse2")))
+void uyvyToRgb24Sse2(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	yuv422ToRgb24Sse2(source, count, dest, true);
+}
+
+///
+/// 32-bit to packed RGB with a byte shuffle, 4 pixels per iteration. Each store writes 4 bytes
+/// beyond the converted pixels, so the vector loop stops 6 pixels before the row end.
+///
+__attribute__((target("ssse3")))
+void rgbx32ToRgb24Ssse3(const uint8_t* source, size_t count, uint8_t* dest, const unsigned redOffset, const unsigned blueOffset)
+{
+	const char r = char(redOffset), b = char(blueOffset);
+	const __m128i shuffle = _mm_setr_epi8(r, 1, b, r+4, 5, b+4, r+8, 9, b+8, r+12, 13, b+12, -1, -1, -1, -1);
+
+	size_t x = 0;
+	for (; x + 6 <= count; x += 4)
+	{
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 4 * x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 3 * x), _mm_shuffle_epi8(pixels, shuffle));
+	}
+
+	rgbx32ToRgb24Scalar(source, x, count, dest, redOffset, blueOffset);
+}
+
+__attribute__((target("ssse3")))
+void bgr32ToRgb24Ssse3(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	rgbx32ToRgb24Ssse3(source, count, dest, 2, 0);
+}
+
+__attribute__((target("ssse3")))
+void rgb32ToRgb24Ssse3(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	rgbx32ToRgb24Ssse3(source, count, dest, 0, 2);
+}
+
+///
+/// Mask of the non-black pixels (0xFF per pixel lane) of 16 packed RGB pixels. The channel masks are
+/// or-ed into the first byte of each pixel, the pixels 5 and 10 span two registers, and then
+/// gathered into one lane per pixel.
+///
+__attribute__((target("ssse3")))
+inline __m128i nonBlackMaskSsse3(const uint8_t* data, const __m128i threshold)
+{
+	__m128i mask[3];
+	for (unsigned reg = 0; reg < 3; ++reg)
+	{
+		// unsigned byte >= threshold
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * reg));
+		mask[reg] = _mm_cmpeq_epi8(_mm_max_epu8(bytes, threshold), bytes);
+	}
+
+	const __m128i first  = _mm_or_si128(mask[0], _mm_or_si128(_mm_alignr_epi8(mask[1], mask[0], 1), _mm_alignr_epi8(mask[1], mask[0], 2)));
+	const __m128i second = _mm_or_si128(mask[1], _mm_or_si128(_mm_alignr_epi8(mask[2], mask[1], 1), _mm_alignr_epi8(mask[2], mask[1], 2)));
+	const __m128i third  = _mm_or_si128(mask[2], _mm_or_si128(_mm_srli_si128(mask[2], 1), _mm_srli_si128(mask[2], 2)));
+
+	const __m128i gatherFirst  = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i gatherSecond = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+	const __m128i gatherThird  = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+
+	return _mm_or_si128(_mm_shuffle_epi8(first, gatherFirst), _mm_or_si128(_mm_shuffle_epi8(second, gatherSecond), _mm_shuffle_epi8(third, gatherThird)));
+}
+
+__attribute__((target("ssse3,popcnt")))
+size_t countNonBlackRgb24Ssse3(const uint8_t* data, size_t count, uint8_t threshold)
+{
+	const __m128i thresholds = _mm_set1_epi8(char(threshold));
+	size_t nonBlack = 0;
+
+	size_t x = 0;
+	for (; x + 16 <= count; x += 16, data += 48)
+	{
+		nonBlack += size_t(__builtin_popcount(unsigned(_mm_movemask_epi8(nonBlackMaskSsse3(data, thresholds)))));
+	}
+
+	return nonBlack + countNonBlackRgb24Scalar(data, count - x, threshold);
+}
+
+__attribute__((target("ssse3")))
+void accumulateNonBlackRgb24Ssse3(const uint8_t* data, size_t count, uint8_t threshold, uint16_t* counts)
+{
+	const __m128i thresholds = _mm_set1_epi8(char(threshold));
+
+	size_t x = 0;
+	for (; x + 16 <= count; x += 16, data += 48)
+	{
+		// the widened mask is -1 per non-black pixel
+		const __m128i mask = nonBlackMaskSsse3(data, thresholds);
+		__m128i* lanes = reinterpret_cast<__m128i*>(counts + x);
+		_mm_storeu_si128(lanes,     _mm_sub_epi16(_mm_loadu_si128(lanes),     _mm_unpacklo_epi8(mask, mask)));
+		_mm_storeu_si128(lanes + 1, _mm_sub_epi16(_mm_loadu_si128(lanes + 1), _mm_unpackhi_epi8(mask, mask)));
+	}
+
+	accumulateNonBlackRgb24Scalar(data, count - x, threshold, counts + x);
+}
+
+///
+/// ceil(distance * factor / 65536) from the high and low half of the 16x16-bit product
+///
+__attribute__((target("sse2")))
+inline __m128i approachStepSse2(const __m128i distance, const __m128i factor)
+{
+	const __m128i high = _mm_mulhi_epu16(distance, factor);
+	const __m128i exact = _mm_cmpeq_epi16(_mm_mullo_epi16(distance, factor), _mm_setzero_si128());
+	return _mm_add_epi16(high, _mm_andnot_si128(exact, _mm_set1_epi16(1)));
+}
+
+__attribute__((target("sse2")))
+void approach16Sse2(uint16_t* values, const uint16_t* targets, size_t count, uint16_t factor)
+{
+	const __m128i factors = _mm_set1_epi16(short(factor));
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i value  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		const __m128i target = _mm_loadu_si128(reinterpret_cast<const __m128i*>(targets + i));
+		// one of the saturated differences is zero
+		const __m128i up   = approachStepSse2(_mm_subs_epu16(target, value), factors);
+		const __m128i down = approachStepSse2(_mm_subs_epu16(value, target), factors);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), _mm_sub_epi16(_mm_add_epi16(value, up), down));
+	}
+
+	approach16Scalar(values + i, targets + i, count - i, factor);
+}
+
+///
+/// Blend 8 bytes widened to 16-bit lanes, the sum stays below 65536
+///
+__attribute__((target("sse2")))
+inline __m128i blendHalfSse2(const __m128i dest, const __m128i src, const __m128i weights)
+{
+	const __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), weights);
+	__m128i mix = _mm_add_epi16(_mm_mullo_epi16(src, weights), _mm_mullo_epi16(dest, inverse));
+	mix = _mm_add_epi16(mix, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(mix, _mm_srli_epi16(mix, 8)), 8);
+}
+
+__attribute__((target("sse2")))
+void blend8Sse2(uint8_t* dest, const uint8_t* src, const uint8_t* weights, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+
+		const __m128i low  = blendHalfSse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(w, zero));
+		const __m128i high = blendHalfSse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(w, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(low, high));
+	}
+
+	blend8Scalar(dest + i, src + i, weights + i, count - i);
+}
+
+#endif // PIXELKERNELS_X86
+
+#ifdef PIXELKERNELS_NEON
+
+inline uint32_t horizontalSum(const uint32x4_t v)
+{
+	return vgetq_lane_u32(v, 0) + vgetq_lane_u32(v, 1) + vgetq_lane_u32(v, 2) + vgetq_lane_u32(v, 3);
+}
+
+void sumRgb24Neon(const uint8_t* data, size_t count, uint32_t sums[3])
+{
+	uint32x4_t totalRed = vdupq_n_u32(0), totalGreen = vdupq_n_u32(0), totalBlue = vdupq_n_u32(0);
+	size_t blocks = count / 16;
+
+	while (blocks > 0)
+	{
+		// each pairwise add contributes up to 510 per 16-bit lane
+		const size_t batch = std::min(blocks, BLOCKS_PER_FLUSH / 2);
+		uint16x8_t red = vdupq_n_u16(0), green = vdupq_n_u16(0), blue = vdupq_n_u16(0);
+		for (size_t i = 0; i < batch; ++i, data += 48)
+		{
+			const uint8x16x3_t pixels = vld3q_u8(data);
+			red   = vpadalq_u8(red,   pixels.val[0]);
+			green = vpadalq_u8(green, pixels.val[1]);
+			blue  = vpadalq_u8(blue,  pixels.val[2]);
+		}
+		totalRed   = vpadalq_u16(totalRed,   red);
+		totalGreen = vpadalq_u16(totalGreen, green);
+		totalBlue  = vpadalq_u16(totalBlue,  blue);
+		blocks -= batch;
+	}
+
+	sums[0] += horizontalSum(totalRed);
+	sums[1] += horizontalSum(totalGreen);
+	sums[2] += horizontalSum(totalBlue);
+	sumRgb24Scalar(data, count % 16, sums);
+}
+
+///
+/// (298 * c + weightA * a + weightB * b + 128) >> 8, saturated to 8 bit
+///
+inline uint8x8_t yuvChannelNeon(const int16x8_t c, const int16x8_t a, const int16_t weightA, const int16x8_t b, const int16_t weightB)
+{
+	int32x4_t low  = vmull_n_s16(vget_low_s16(c), 298);
+	int32x4_t high = vmull_n_s16(vget_high_s16(c), 298);
+	low  = vmlal_n_s16(low,  vget_low_s16(a),  weightA);
+	high = vmlal_n_s16(high, vget_high_s16(a), weightA);
+	low  = vmlal_n_s16(low,  vget_low_s16(b),  weightB);
+	high = vmlal_n_s16(high, vget_high_s16(b), weightB);
+	low  = vshrq_n_s32(vaddq_s32(low,  vdupq_n_s32(128)), 8);
+	high = vshrq_n_s32(vaddq_s32(high, vdupq_n_s32(128)), 8);
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+}
+
+void yuv422ToRgb24Neon(const uint8_t* source, size_t count, uint8_t* dest, const bool uyvy)
+{
+	size_t x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		// YUYV: y0 u y1 v, UYVY: u y0 v y1
+		const uint8x8x4_t pixels = vld4_u8(source + 2 * x);
+		const uint8x8_t yEven = uyvy ? pixels.val[1] : pixels.val[0];
+		const uint8x8_t yOdd  = uyvy ? pixels.val[3] : pixels.val[2];
+		const uint8x8_t u     = uyvy ? pixels.val[0] : pixels.val[1];
+		const uint8x8_t v     = uyvy ? pixels.val[2] : pixels.val[3];
+
+		const int16x8_t cEven = vreinterpretq_s16_u16(vsubl_u8(yEven, vdup_n_u8(16)));
+		const int16x8_t cOdd  = vreinterpretq_s16_u16(vsubl_u8(yOdd,  vdup_n_u8(16)));
+		const int16x8_t d     = vreinterpretq_s16_u16(vsubl_u8(u, vdup_n_u8(128)));
+		const int16x8_t e     = vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(128)));
+
+		const uint8x8x2_t red   = vzip_u8(yuvChannelNeon(cEven, e, 409, d, 0),    yuvChannelNeon(cOdd, e, 409, d, 0));
+		const uint8x8x2_t green = vzip_u8(yuvChannelNeon(cEven, d, -100, e, -208), yuvChannelNeon(cOdd, d, -100, e, -208));
+		const uint8x8x2_t blue  = vzip_u8(yuvChannelNeon(cEven, d, 516, e, 0),    yuvChannelNeon(cOdd, d, 516, e, 0));
+
+		for (unsigned half = 0; half < 2; ++half)
+		{
+			uint8x8x3_t rgb;
+			rgb.val[0] = red.val[half];
+			rgb.val[1] = green.val[half];
+			rgb.val[2] = blue.val[half];
+			vst3_u8(dest + 3 * x + 24 * half, rgb);
+		}
+	}
+
+	yuv422ToRgb24Scalar(source, x, count, dest, uyvy);
+}
+
+void yuyvToRgb24Neon(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	yuv422ToRgb24Neon(source, count, dest, false);
+}
+
+void uyvyToRgb24Neon(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	yuv422ToRgb24Neon(source, count, dest, true);
+}
+
+void rgbx32ToRgb24Neon(const uint8_t* source, size_t count, uint8_t* dest, const unsigned redOffset, const unsigned blueOffset)
+{
+	size_t x = 0;
+	for (; x + 16 <= count; x += 16)
+	{
+		const uint8x16x4_t pixels = vld4q_u8(source + 4 * x);
+		uint8x16x3_t rgb;
+		rgb.val[0] = pixels.val[redOffset];
+		rgb.val[1] = pixels.val[1];
+		rgb.val[2] = pixels.val[blueOffset];
+		vst3q_u8(dest + 3 * x, rgb);
+	}
+
+	rgbx32ToRgb24Scalar(source, x, count, dest, redOffset, blueOffset);
+}
+
+void bgr32ToRgb24Neon(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	rgbx32ToRgb24Neon(source, count, dest, 2, 0);
+}
+
+void rgb32ToRgb24Neon(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	rgbx32ToRgb24Neon(source, count, dest, 0, 2);
+}
+
+inline uint8x16_t nonBlackMaskNeon(const uint8_t* data, const uint8x16_t threshold)
+{
+	const uint8x16x3_t pixels = vld3q_u8(data);
+	return vorrq_u8(vcgeq_u8(pixels.val[0], threshold), vorrq_u8(vcgeq_u8(pixels.val[1], threshold), vcgeq_u8(pixels.val[2], threshold)));
+}
+
+size_t countNonBlackRgb24Neon(const uint8_t* data, size_t count, uint8_t threshold)
+{
+	const uint8x16_t thresholds = vdupq_n_u8(threshold);
+	uint32x4_t total = vdupq_n_u32(0);
+
+	size_t x = 0;
+	for (; x + 16 <= count; x += 16, data += 48)
+	{
+		const uint8x16_t ones = vshrq_n_u8(nonBlackMaskNeon(data, thresholds), 7);
+		total = vpadalq_u16(total, vpaddlq_u8(ones));
+	}
+
+	return horizontalSum(total) + countNonBlackRgb24Scalar(data, count - x, threshold);
+}
+
+void accumulateNonBlackRgb24Neon(const uint8_t* data, size_t count, uint8_t threshold, uint16_t* counts)
+{
+	const uint8x16_t thresholds = vdupq_n_u8(threshold);
+
+	size_t x = 0;
+	for (; x + 16 <= count; x += 16, data += 48)
+	{
+		// the sign extended mask is -1 per non-black pixel
+		const int8x16_t mask = vreinterpretq_s8_u8(nonBlackMaskNeon(data, thresholds));
+		const uint16x8_t low  = vreinterpretq_u16_s16(vmovl_s8(vget_low_s8(mask)));
+		const uint16x8_t high = vreinterpretq_u16_s16(vmovl_s8(vget_high_s8(mask)));
+		vst1q_u16(counts + x,     vsubq_u16(vld1q_u16(counts + x),     low));
+		vst1q_u16(counts + x + 8, vsubq_u16(vld1q_u16(counts + x + 8), high));
+	}
+
+	accumulateNonBlackRgb24Scalar(data, count - x, threshold, counts + x);
+}
+
+///
+/// ceil(distance * factor / 65536) with a 32-bit product
+///
+inline uint16x8_t approachStepNeon(const uint16x8_t distance, const uint16x4_t factor)
+{
+	const uint32x4_t roundUp = vdupq_n_u32(0xFFFF);
+	const uint32x4_t low  = vaddq_u32(vmull_u16(vget_low_u16(distance),  factor), roundUp);
+	const uint32x4_t high = vaddq_u32(vmull_u16(vget_high_u16(distance), factor), roundUp);
+	return vcombine_u16(vshrn_n_u32(low, 16), vshrn_n_u32(high, 16));
+}
+
+void approach16Neon(uint16_t* values, const uint16_t* targets, size_t count, uint16_t factor)
+{
+	const uint16x4_t factors = vdup_n_u16(factor);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const uint16x8_t value  = vld1q_u16(values + i);
+		const uint16x8_t target = vld1q_u16(targets + i);
+		// one of the saturated differences is zero
+		const uint16x8_t up   = approachStepNeon(vqsubq_u16(target, value), factors);
+		const uint16x8_t down = approachStepNeon(vqsubq_u16(value, target), factors);
+		vst1q_u16(values + i, vsubq_u16(vaddq_u16(value, up), down));
+	}
+
+	approach16Scalar(values + i, targets + i, count - i, factor);
+}
+
+void blend8Neon(uint8_t* dest, const uint8_t* src, const uint8_t* weights, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const uint8x16_t d = vld1q_u8(dest + i);
+		const uint8x16_t s = vld1q_u8(src + i);
+		const uint8x16_t w = vld1q_u8(weights + i);
+		const uint8x16_t inverse = vmvnq_u8(w);
+
+		const uint16x8_t low  = vmlal_u8(vmull_u8(vget_low_u8(s),  vget_low_u8(w)),  vget_low_u8(d),  vget_low_u8(inverse));
+		const uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(s), vget_high_u8(w)), vget_high_u8(d), vget_high_u8(inverse));
+
+		// (x + ((x + 128) >> 8) + 128) >> 8, the rounded division by 255 of the scalar version
+		vst1q_u8(dest + i, vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8))));
+	}
+
+	blend8Scalar(dest + i, src + i, weights + i, count - i);
+}
+
+#endif // PIXELKERNELS_NEON
+
+KernelSet detectKernels()
+{
+	KernelSet kernelSet = { "scalar", sumRgb24Scalar, yuyvToRgb24Scalar, uyvyToRgb24Scalar, bgr32ToRgb24Scalar, rgb32ToRgb24Scalar,
+	                        countNonBlackRgb24Scalar, accumulateNonBlackRgb24Scalar, approach16Scalar, blend8Scalar };
+
+#if defined(PIXELKERNELS_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+	{
+		kernelSet.name         = "sse2";
+		kernelSet.sumRgb24     = sumRgb24Sse2;
+		kernelSet.yuyvToRgb24  = yuyvToRgb24Sse2;
+		kernelSet.uyvyToRgb24  = uyvyToRgb24Sse2;
+		kernelSet.approach16   = approach16Sse2;
+		kernelSet.blend8       = blend8Sse2;
+	}
+	if (__builtin_cpu_supports("ssse3"))
+	{
+		kernelSet.bgr32ToRgb24 = bgr32ToRgb24Ssse3;
+		kernelSet.rgb32ToRgb24 = rgb32ToRgb24Ssse3;
+		kernelSet.accumulateNonBlackRgb24 = accumulateNonBlackRgb24Ssse3;
+	}
+	if (__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("popcnt"))
+	{
+		kernelSet.countNonBlackRgb24 = countNonBlackRgb24Ssse3;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		kernelSet.name         = "avx2";
+		kernelSet.sumRgb24     = sumRgb24Avx2;
+	}
+#elif defined(PIXELKERNELS_NEON)
+	// NEON is part of the compile target (always true for aarch64)
+	kernelSet = { "neon", sumRgb24Neon, yuyvToRgb24Neon, uyvyToRgb24Neon, bgr32ToRgb24Neon, rgb32ToRgb24Neon,
+	              countNonBlackRgb24Neon, accumulateNonBlackRgb24Neon, approach16Neon, blend8Neon };
+#endif
+
+	return kernelSet;
+}
+
+const KernelSet& kernels()
+{
+	static const KernelSet kernelSet = detectKernels();
+	return kernelSet;
+}
+
+} // anonymous namespace
+
+void sumRgb24(const uint8_t* data, size_t count, uint32_t sums[3])
+{
+	kernels().sumRgb24(data, count, sums);
+}
+
+void yuyvToRgb24(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	kernels().yuyvToRgb24(source, count, dest);
+}
+
+void uyvyToRgb24(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	kernels().uyvyToRgb24(source, count, dest);
+}
+
+void bgr32ToRgb24(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	kernels().bgr32ToRgb24(source, count, dest);
+}
+
+void rgb32ToRgb24(const uint8_t* source, size_t count, uint8_t* dest)
+{
+	kernels().rgb32ToRgb24(source, count, dest);
+}
+
+size_t countNonBlackRgb24(const uint8_t* data, size_t count, uint8_t threshold)
+{
+	return kernels().countNonBlackRgb24(data, count, threshold);
+}
+
+void accumulateNonBlackRgb24(const uint8_t* data, size_t count, uint8_t threshold, uint16_t* counts)
+{
+	kernels().accumulateNonBlackRgb24(data, count, threshold, counts);
+}
+
+void approach16(uint16_t* values, const uint16_t* targets, size_t count, uint16_t factor)
+{
+	kernels().approach16(values, targets, count, factor);
+}
+
+void blend8(uint8_t* dest, const uint8_t* src, const uint8_t* weights, size_t count)
+{
+	kernels().blend8(dest, src, weights, count);
+}
+
+void sumBoxesRgb24(const uint8_t* data, size_t boxes, unsigned boxWidth, uint32_t* sums)
+{
+	// only used on the few rows of oversized network images, the loop is bound by memory bandwidth
+	for (size_t box = 0; box < boxes; ++box, sums += 3)
+	{
+		uint32_t red = 0, green = 0, blue = 0;
+		for (const uint8_t* end = data + 3 * boxWidth; data != end; data += 3)
+		{
+			red   += data[0];
+			green += data[1];
+			blue  += data[2];
+		}
+		sums[0] += red;
+		sums[1] += green;
+		sums[2] += blue;
+	}
+}
+
+namespace {
+
+const uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+inline uint64_t rotl64(const uint64_t value, const int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t hashRound(const uint64_t hash, const uint64_t word)
+{
+	return rotl64(hash + word * HASH_PRIME2, 31) * HASH_PRIME1;
+}
+
+inline uint64_t loadWord(const uint8_t* data)
+{
+	uint64_t word;
+	memcpy(&word, data, sizeof(word));
+	return word;
+}
+
+} // anonymous namespace
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed)
+{
+	// four independent lanes keep the multipliers busy, the loop is bound by memory bandwidth
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const uint8_t* end = bytes + size;
+	uint64_t lanes[4] = { seed + HASH_PRIME1 + HASH_PRIME2, seed + HASH_PRIME2, seed, seed - HASH_PRIME1 };
+
+	for (; end - bytes >= 32; bytes += 32)
+	{
+		lanes[0] = hashRound(lanes[0], loadWord(bytes));
+		lanes[1] = hashRound(lanes[1], loadWord(bytes + 8));
+		lanes[2] = hashRound(lanes[2], loadWord(bytes + 16));
+		lanes[3] = hashRound(lanes[3], loadWord(bytes + 24));
+	}
+
+	uint64_t hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18) + size;
+
+	for (; end - bytes >= 8; bytes += 8)
+	{
+		hash = hashRound(hash, loadWord(bytes));
+	}
+
+	for (; bytes != end; ++bytes)
+	{
+		hash = rotl64(hash ^ (*bytes * HASH_PRIME1), 11) * HASH_PRIME2;
+	}
+
+	// final avalanche
+	hash ^= hash >> 33;
+	hash *= HASH_PRIME2;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+const char* kernelName()
+{
+	return kernels().name;
+}
+
+}
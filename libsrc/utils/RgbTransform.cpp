@@ -69,6 +69,15 @@ void RgbTransform::setBacklightThreshold(int backlightThreshold)
 {
 	_backlightThreshold = backlightThreshold;
 	_sumBrightnessLow   = 765.0 * ((qPow(2.0,(_backlightThreshold/100)*2)-1) / 3.0);
+
+	// precalculated for transform(), rgbSum < _sumBrightnessLow equals rgbSum < ceil(_sumBrightnessLow)
+	_backlightSum  = (_sumBrightnessLow > 0) ? (int)std::ceil(_sumBrightnessLow) : 0;
+	_backlightGray = qMin((int)(_sumBrightnessLow/3.0), 255);
+	_backlightFactor[0] = 0;
+	for (int rgbSum = 1; rgbSum < 766; ++rgbSum)
+	{
+		_backlightFactor[rgbSum] = qMin((int)(_sumBrightnessLow / rgbSum), 255);
+	}
 }
 
 bool RgbTransform::getBacklightColored() const
@@ -150,7 +159,7 @@ void RgbTransform::transform(uint8_t & red, uint8_t & green, uint8_t & blue)
 	// apply brightnesss
 	int rgbSum = red+green+blue;
 
-	if ( _backLightEnabled && _sumBrightnessLow>0 && rgbSum < _sumBrightnessLow)
+	if ( _backLightEnabled && rgbSum < _backlightSum)
 	{
 		if (_backlightColored)
 		{
@@ -161,15 +170,15 @@ void RgbTransform::transform(uint8_t & red, uint8_t & green, uint8_t & blue)
 				if (blue ==0) blue  = 1;
 				rgbSum = red+green+blue;
 			}
-			double cL =qMin((int)(_sumBrightnessLow /rgbSum), 255);
+			const int cL = _backlightFactor[rgbSum];
 
-			red   *= cL;
-			green *= cL;
-			blue  *= cL;
+			red   = uint8_t(red   * cL);
+			green = uint8_t(green * cL);
+			blue  = uint8_t(blue  * cL);
 		}
 		else
 		{
-			red   = qMin((int)(_sumBrightnessLow/3.0), 255);
+			red   = _backlightGray;
 			green = red;
 			blue  = red;
 		}
@@ -17,6 +17,7 @@
 
 #include <utils/Components.h>
 #include <utils/JsonUtils.h>
+#include <hyperion/LedString.h>
 
 // bonjour browser
 #include <bonjour/bonjourbrowserwrapper.h>
@@ -85,6 +86,7 @@ HyperionDaemon::HyperionDaemon(const QString rootPath, QObject *parent, const bo
 	qRegisterMetaType<VideoMode>("VideoMode");
 	qRegisterMetaType<QMap<quint8,QJsonObject>>("QMap<quint8,QJsonObject>");
 	qRegisterMetaType<std::vector<ColorRgb>>("std::vector<ColorRgb>");
+	qRegisterMetaType<std::vector<ColorOrder>>("std::vector<ColorOrder>");
 
 	// init settings
 	_settingsManager = new SettingsManager(0,this);
@@ -137,6 +137,84 @@ int TC_UNKNOWN_BORDER()
 	return result;
 }
 
+Image<ColorRgb> createLetterboxImage(unsigned width, unsigned height, unsigned horizontalBorder, unsigned verticalBorder)
+{
+	Image<ColorRgb> image(width, height);
+	for (unsigned x=0; x<image.width(); ++x)
+	{
+		for (unsigned y=0; y<image.height(); ++y)
+		{
+			if (y < horizontalBorder || y >= height - horizontalBorder || x < verticalBorder || x >= width - verticalBorder)
+			{
+				image(x,y) = ColorRgb::BLACK;
+			}
+			else
+			{
+				image(x,y) = {uint8_t(128 + rand() % 128), uint8_t(rand() % 256), uint8_t(rand() % 256)};
+			}
+		}
+	}
+	return image;
+}
+
+int TC_STATISTIC_BORDER()
+{
+	int result = 0;
+
+	BlackBorderDetector detector(0.05);
+
+	{
+		Image<ColorRgb> image = createLetterboxImage(640, 360, 44, 0);
+		BlackBorder border = detector.process_statistic(image);
+		if (border.unknown || border.horizontalSize != 44 || border.verticalSize != 0 || border.confidence < 0.9)
+		{
+			std::cerr << "Failed to correctly detect letterbox with statistic mode" << std::endl;
+			result = -1;
+		}
+		else std::cout << "Correctly detected letterbox with statistic mode" << std::endl;
+	}
+
+	{
+		Image<ColorRgb> image = createLetterboxImage(640, 360, 0, 80);
+		BlackBorder border = detector.process_statistic(image);
+		if (border.unknown || border.horizontalSize != 0 || border.verticalSize != 80 || border.confidence < 0.9)
+		{
+			std::cerr << "Failed to correctly detect pillarbox with statistic mode" << std::endl;
+			result = -1;
+		}
+		else std::cout << "Correctly detected pillarbox with statistic mode" << std::endl;
+	}
+
+	{
+		Image<ColorRgb> image = createLetterboxImage(640, 360, 44, 0);
+		// a bright line within the border is skipped, but lowers the confidence
+		for (unsigned x=0; x<image.width(); ++x)
+		{
+			image(x,0) = {255, 255, 255};
+		}
+		BlackBorder border = detector.process_statistic(image);
+		if (border.unknown || border.horizontalSize != 44 || border.confidence > 0.5)
+		{
+			std::cerr << "Failed to correctly detect letterbox with noise with statistic mode" << std::endl;
+			result = -1;
+		}
+		else std::cout << "Correctly detected letterbox with noise with statistic mode" << std::endl;
+	}
+
+	{
+		Image<ColorRgb> image = createLetterboxImage(640, 360, 180, 0);
+		BlackBorder border = detector.process_statistic(image);
+		if (!border.unknown)
+		{
+			std::cerr << "Failed to correctly detect unknown border with statistic mode" << std::endl;
+			result = -1;
+		}
+		else std::cout << "Correctly detected unknown border with statistic mode" << std::endl;
+	}
+
+	return result;
+}
+
 int main()
 {
 	TC_NO_BORDER();
@@ -144,6 +222,7 @@ int main()
 	TC_LEFT_BORDER();
 	TC_DUAL_BORDER();
 	TC_UNKNOWN_BORDER();
+	TC_STATISTIC_BORDER();
 
 	return 0;
 }
@@ -0,0 +1,277 @@
+// STL includes
+#include <iostream>
+#include <vector>
+#include <random>
+
+// Utils includes
+#include <utils/PixelKernels.h>
+
+/// The exactly rounded blend of a single byte
+uint8_t blendReference(uint8_t dest, uint8_t src, uint8_t weight)
+{
+	const unsigned mix = unsigned(src) * weight + unsigned(dest) * (255 - weight);
+	return uint8_t((mix + 127) / 255);
+}
+
+///
+/// Blends all destination/source combinations with every weight. Blocks of 16 bytes use the vector
+/// kernel of the cpu, single bytes (count < 16) the scalar version.
+///
+int TC_BLEND8_EXHAUSTIVE(bool scalar)
+{
+	std::vector<uint8_t> dest(65536), src(65536), weights(65536);
+	for (unsigned weight = 0; weight < 256; ++weight)
+	{
+		for (unsigned i = 0; i < 65536; ++i)
+		{
+			dest[i] = uint8_t(i);
+			src[i] = uint8_t(i >> 8);
+			weights[i] = uint8_t(weight);
+		}
+
+		if (scalar)
+		{
+			for (unsigned i = 0; i < 65536; ++i)
+			{
+				PixelKernels::blend8(&dest[i], &src[i], &weights[i], 1);
+			}
+		}
+		else
+		{
+			PixelKernels::blend8(dest.data(), src.data(), weights.data(), dest.size());
+		}
+
+		for (unsigned i = 0; i < 65536; ++i)
+		{
+			if (dest[i] != blendReference(uint8_t(i), uint8_t(i >> 8), uint8_t(weight)))
+			{
+				std::cerr << "blend8 (" << (scalar ? "scalar" : PixelKernels::kernelName()) << ") failed for dest " << (i & 255)
+						  << " src " << (i >> 8) << " weight " << weight << ": " << int(dest[i]) << std::endl;
+				return -1;
+			}
+		}
+	}
+
+	std::cout << "blend8 (" << (scalar ? "scalar" : PixelKernels::kernelName()) << ") is exact for all values" << std::endl;
+	return 0;
+}
+
+///
+/// Weight 0 keeps the destination and weight 255 takes the source, for lengths with and without a
+/// scalar tail
+///
+int TC_BLEND8_LIMITS()
+{
+	std::mt19937 rng(1);
+	for (size_t count = 0; count < 100; ++count)
+	{
+		std::vector<uint8_t> lower(count), upper(count), weights(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			lower[i] = uint8_t(rng());
+			upper[i] = uint8_t(rng());
+		}
+
+		std::vector<uint8_t> dest = lower;
+		weights.assign(count, 0);
+		PixelKernels::blend8(dest.data(), upper.data(), weights.data(), count);
+		if (dest != lower)
+		{
+			std::cerr << "blend8 with weight 0 changed the destination, count " << count << std::endl;
+			return -1;
+		}
+
+		weights.assign(count, 255);
+		PixelKernels::blend8(dest.data(), upper.data(), weights.data(), count);
+		if (dest != upper)
+		{
+			std::cerr << "blend8 with weight 255 didn't take the source, count " << count << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << "blend8 keeps the destination with weight 0 and takes the source with weight 255" << std::endl;
+	return 0;
+}
+
+///
+/// Sums random rows of every length up to several vector blocks at every start alignment and
+/// compares the result with a per pixel sum. Short rows and the remainders of longer rows run the
+/// scalar tail of the kernel
+///
+int TC_SUMRGB24_TAILS()
+{
+	std::mt19937 rng(2);
+	std::vector<uint8_t> data(3 * 200 + 16);
+	for (uint8_t& byte : data)
+	{
+		byte = uint8_t(rng());
+	}
+
+	for (size_t offset = 0; offset < 16; ++offset)
+	{
+		const uint8_t* row = data.data() + offset;
+		for (size_t count = 0; count <= 200; ++count)
+		{
+			uint32_t expected[3] = { 1, 2, 3 };
+			for (size_t i = 0; i < count; ++i)
+			{
+				expected[0] += row[3*i];
+				expected[1] += row[3*i+1];
+				expected[2] += row[3*i+2];
+			}
+
+			uint32_t sums[3] = { 1, 2, 3 };
+			PixelKernels::sumRgb24(row, count, sums);
+			if (sums[0] != expected[0] || sums[1] != expected[1] || sums[2] != expected[2])
+			{
+				std::cerr << "sumRgb24 (" << PixelKernels::kernelName() << ") failed for count " << count << " offset " << offset << std::endl;
+				return -1;
+			}
+		}
+	}
+
+	std::cout << "sumRgb24 (" << PixelKernels::kernelName() << ") matches the scalar sum for all lengths and offsets" << std::endl;
+	return 0;
+}
+
+///
+/// White rows of odd lengths up to the documented maximum of a single call must not overflow the
+/// lane sums of the vector kernels
+///
+int TC_SUMRGB24_SATURATED()
+{
+	const size_t counts[] = { 65537, 1000003, 16843009 };
+	std::vector<uint8_t> data(3 * counts[2], 255);
+
+	for (size_t count : counts)
+	{
+		uint32_t sums[3] = { 0, 0, 0 };
+		PixelKernels::sumRgb24(data.data(), count, sums);
+		const uint32_t expected = uint32_t(255 * count);
+		if (sums[0] != expected || sums[1] != expected || sums[2] != expected)
+		{
+			std::cerr << "sumRgb24 (" << PixelKernels::kernelName() << ") overflowed for " << count << " white pixels" << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << "sumRgb24 (" << PixelKernels::kernelName() << ") is exact up to the maximum pixel count" << std::endl;
+	return 0;
+}
+
+///
+/// Converts every combination of y, u and v in both YUV 4:2:2 layouts and compares each pixel
+/// with yuvToRgb()
+///
+int TC_YUV422_EXHAUSTIVE(bool uyvy)
+{
+	const char* name = uyvy ? "uyvyToRgb24" : "yuyvToRgb24";
+	std::vector<uint8_t> source(2 * 256), dest(3 * 256);
+
+	for (unsigned u = 0; u < 256; ++u)
+	{
+		for (unsigned v = 0; v < 256; ++v)
+		{
+			// the luma of pixel x is x, all pairs share u and v
+			for (unsigned x = 0; x < 256; ++x)
+			{
+				const uint8_t chroma = uint8_t((x & 1) ? v : u);
+				source[2*x]     = uyvy ? chroma : uint8_t(x);
+				source[2*x + 1] = uyvy ? uint8_t(x) : chroma;
+			}
+
+			if (uyvy)
+			{
+				PixelKernels::uyvyToRgb24(source.data(), 256, dest.data());
+			}
+			else
+			{
+				PixelKernels::yuyvToRgb24(source.data(), 256, dest.data());
+			}
+
+			for (unsigned y = 0; y < 256; ++y)
+			{
+				uint8_t rgb[3];
+				PixelKernels::yuvToRgb(uint8_t(y), uint8_t(u), uint8_t(v), rgb[0], rgb[1], rgb[2]);
+				if (dest[3*y] != rgb[0] || dest[3*y+1] != rgb[1] || dest[3*y+2] != rgb[2])
+				{
+					std::cerr << name << " (" << PixelKernels::kernelName() << ") failed for y " << y << " u " << u << " v " << v << std::endl;
+					return -1;
+				}
+			}
+		}
+	}
+
+	std::cout << name << " (" << PixelKernels::kernelName() << ") matches yuvToRgb for all values" << std::endl;
+	return 0;
+}
+
+///
+/// Converts random rows of every length up to several vector blocks with all row converters and
+/// compares them with a per pixel conversion. The byte after the last output pixel must stay untouched
+///
+int TC_CONVERT_TAILS()
+{
+	std::mt19937 rng(3);
+	std::vector<uint8_t> source(4 * 100 + 4);
+	for (uint8_t& byte : source)
+	{
+		byte = uint8_t(rng());
+	}
+
+	const char* names[] = { "yuyvToRgb24", "uyvyToRgb24", "bgr32ToRgb24", "rgb32ToRgb24" };
+	void (*converters[])(const uint8_t*, size_t, uint8_t*) = {
+		PixelKernels::yuyvToRgb24, PixelKernels::uyvyToRgb24, PixelKernels::bgr32ToRgb24, PixelKernels::rgb32ToRgb24 };
+
+	for (unsigned kernel = 0; kernel < 4; ++kernel)
+	{
+		for (size_t count = 0; count <= 100; ++count)
+		{
+			std::vector<uint8_t> expected(3 * count + 1, 0xA5);
+			for (size_t x = 0; x < count; ++x)
+			{
+				uint8_t* rgb = &expected[3*x];
+				if (kernel < 2)
+				{
+					const uint8_t* pair = &source[4 * (x >> 1)];
+					const bool uyvy = (kernel == 1);
+					PixelKernels::yuvToRgb(uyvy ? pair[1 + 2 * (x & 1)] : pair[2 * (x & 1)], pair[uyvy ? 0 : 1], pair[uyvy ? 2 : 3], rgb[0], rgb[1], rgb[2]);
+				}
+				else
+				{
+					const uint8_t* pixel = &source[4*x];
+					rgb[0] = kernel == 2 ? pixel[2] : pixel[0];
+					rgb[1] = pixel[1];
+					rgb[2] = kernel == 2 ? pixel[0] : pixel[2];
+				}
+			}
+
+			std::vector<uint8_t> dest(3 * count + 1, 0xA5);
+			converters[kernel](source.data(), count, dest.data());
+			if (dest != expected)
+			{
+				std::cerr << names[kernel] << " (" << PixelKernels::kernelName() << ") failed for count " << count << std::endl;
+				return -1;
+			}
+		}
+	}
+
+	std::cout << "row converters (" << PixelKernels::kernelName() << ") match the per pixel conversion for all lengths" << std::endl;
+	return 0;
+}
+
+int main()
+{
+	int result = 0;
+	result |= TC_BLEND8_EXHAUSTIVE(false);
+	result |= TC_BLEND8_EXHAUSTIVE(true);
+	result |= TC_BLEND8_LIMITS();
+	result |= TC_SUMRGB24_TAILS();
+	result |= TC_SUMRGB24_SATURATED();
+	result |= TC_YUV422_EXHAUSTIVE(false);
+	result |= TC_YUV422_EXHAUSTIVE(true);
+	result |= TC_CONVERT_TAILS();
+
+	return result;
+}
@@ -36,9 +36,37 @@ int main()
 			std::cout << "RGB error idx " << i << " " << rgb << std::endl;
 	}
 
-	
-	
-	
+	// copies share the pixels until one of them is written
+	std::cout << "Testing implicit sharing" << std::endl;
+	Image<ColorRgb> image_copy = image_rgb;
+	if (!image_copy.isShared())
+		std::cout << "Copy does not share the pixel buffer" << std::endl;
+
+	image_copy(0, 0) = ColorRgb::BLACK;
+	if (image_copy.isShared() || image_rgb(0, 0).red != 255)
+		std::cout << "Write to copy modified the source image" << std::endl;
+
+	// moving takes over the buffer without sharing it
+	Image<ColorRgb> image_moved(std::move(image_copy));
+	if (image_moved.isShared())
+		std::cout << "Moved image shares the pixel buffer" << std::endl;
+
+	// resizing a shared image takes a new buffer and leaves the other copy alone
+	Image<ColorRgb> image_resized = image_rgb;
+	const Image<ColorRgb>& source = image_rgb;
+	const Image<ColorRgb>& resized = image_resized;
+	const ColorRgb* shared_pixels = source.memptr();
+	image_resized.resize(width / 2, height / 2);
+	if (image_resized.isShared() || source.isShared() || source.width() != unsigned(width) || source(1, 1).red != 255)
+		std::cout << "Resize of a shared image modified the source image" << std::endl;
+	if (resized.memptr() == shared_pixels || source.memptr() != shared_pixels)
+		std::cout << "Resize of a shared image didn't take a new buffer" << std::endl;
+
+	// an unshared buffer is kept when the new size fits
+	const ColorRgb* own_pixels = resized.memptr();
+	image_resized.resize(width / 4, height / 4);
+	if (resized.memptr() != own_pixels)
+		std::cout << "Resize of an unshared image replaced the buffer" << std::endl;
 
 	std::cout << "Finished (destruction will be performed)" << std::endl;
 
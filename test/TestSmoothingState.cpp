@@ -0,0 +1,85 @@
+// STL includes
+#include <iostream>
+#include <vector>
+
+// Hyperion includes
+#include <utils/ColorRgb.h>
+
+// Smoothing includes
+#include <hyperion/SmoothingState.h>
+
+std::vector<ColorRgb> createLeds(size_t count, uint8_t value)
+{
+	return std::vector<ColorRgb>(count, ColorRgb{value, uint8_t(255 - value), uint8_t(value / 2)});
+}
+
+bool isOutput(const SmoothingState& smoothing, const std::vector<ColorRgb>& expected)
+{
+	const std::vector<ColorRgb>& output = smoothing.outputValues();
+	if (output.size() != expected.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < output.size(); ++i)
+	{
+		if (output[i] != expected[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int TC_RESIZE(bool damped)
+{
+	int result = 0;
+	SmoothingState smoothing;
+
+	const size_t counts[] = { 10, 4, 25, 25, 1, 10 };
+	uint8_t value = 0;
+	bool first = true;
+	for (const size_t count : counts)
+	{
+		// a new led count restarts at the target, the same count moves towards it
+		const std::vector<ColorRgb> leds = createLeds(count, value);
+		const bool resize = first || count != smoothing.outputValues().size();
+		if (smoothing.setTarget(leds) != resize)
+		{
+			std::cerr << "Unexpected reset for " << count << " leds" << std::endl;
+			result = -1;
+		}
+		first = false;
+
+		for (int step = 0; step < 100; ++step)
+		{
+			const bool settled = damped ? smoothing.damp(0.5) : smoothing.approach(0.5);
+			smoothing.updateOutput(step % 2 == 0);
+			if (settled)
+			{
+				break;
+			}
+		}
+
+		smoothing.updateOutput(false);
+		if (!isOutput(smoothing, leds))
+		{
+			std::cerr << "Failed to reach the target of " << count << " leds" << std::endl;
+			result = -1;
+		}
+		else std::cout << "Reached the target of " << count << " leds" << std::endl;
+
+		value = uint8_t(value + 97);
+	}
+
+	return result;
+}
+
+int main()
+{
+	int result = 0;
+	result |= TC_RESIZE(false);
+	result |= TC_RESIZE(true);
+
+	return result;
+}